@@ -0,0 +1,151 @@
+/**
+ * \file
+ * Benchmark of bulk body building. Compares former per-item strings streamed through
+ * std::ostringstream with SameIndexBulkData contiguous buffer. Reports time and heap
+ * allocations per document.
+ */
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdlib>
+#include <iostream>
+#include <elasticlient/bulk.h>
+#include "bench-server.h"
+
+
+namespace {
+
+
+std::atomic<std::size_t> allocations(0);
+
+
+}  // anonymous namespace
+
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+
+namespace {
+
+
+const std::size_t bulkSize = 1000;
+const std::size_t rounds = 200;
+
+
+/// Bulk data kept as per-item strings, as SameIndexBulkData used to do.
+class ItemsBulkData {
+    struct Item {
+        std::string control;
+        std::string source;
+        Item(const std::string &control, const std::string &source)
+          : control(control), source(source)
+        {}
+    };
+    std::vector<Item> data;
+
+  public:
+    ItemsBulkData(): data() {
+        data.reserve(bulkSize);
+    }
+
+    void indexDocument(const std::string &docType, const std::string &id,
+                       const std::string &doc)
+    {
+        std::ostringstream control;
+        control << "{\"index\": {\"_type\": \"" << docType << "\", \"_id\": \"" << id << "\"}}";
+        data.emplace_back(control.str(), doc);
+    }
+
+    std::string body() const {
+        std::ostringstream body;
+        for (const Item &item: data) {
+            body << item.control << "\n" << item.source << "\n";
+        }
+        return body.str();
+    }
+
+    void clear() {
+        data.clear();
+    }
+};
+
+
+/// Run \p fill and \p serialize for rounds of bulks and report per document results.
+template <typename Fill, typename Serialize>
+void run(const std::string &name, Fill fill, Serialize serialize) {
+    std::size_t bytes = 0;
+    const std::size_t allocationsBefore = allocations;
+    const double seconds = bench::measure([&]() {
+        for (std::size_t round = 0; round < rounds; ++round) {
+            fill();
+            bytes += serialize();
+        }
+    });
+    const double documents = rounds * bulkSize;
+    std::cout << name << ": " << seconds * 1e9 / documents << " ns/doc, "
+              << (allocations - allocationsBefore) / documents << " allocations/doc, "
+              << bytes / seconds / (1024 * 1024) << " MB/s" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    const std::string doc = "{\"title\": \"" + std::string(150, 'x') + "\", \"count\": 42}";
+    std::vector<std::string> ids;
+    for (std::size_t i = 0; i < bulkSize; ++i) {
+        ids.push_back("document-" + std::to_string(i));
+    }
+
+    ItemsBulkData items;
+    run("per-item strings + ostringstream",
+        [&]() {
+            items.clear();
+            for (const std::string &id: ids) {
+                items.indexDocument("doc", id, doc);
+            }
+        },
+        [&]() { return items.body().size(); });
+
+    elasticlient::SameIndexBulkData bulk("bench", bulkSize);
+    run("contiguous buffer, body()",
+        [&]() {
+            bulk.clear();
+            for (const std::string &id: ids) {
+                bulk.indexDocument("doc", id, doc);
+            }
+        },
+        [&]() { return bulk.body().size(); });
+
+    run("contiguous buffer, bodyBuffer()",
+        [&]() {
+            bulk.clear();
+            for (const std::string &id: ids) {
+                bulk.indexDocument("doc", id, doc);
+            }
+        },
+        [&]() { return bulk.bodyBuffer().size(); });
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * \file
+ * Benchmark of loading NDJSON file. Compares reading lines into std::string and
+ * indexing them one by one by SameIndexBulkData with memory-mapped BulkFileLoader
+ * on growing number of workers. Node answers bulks without latency, so the client
+ * side cost dominates.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <elasticlient/client.h>
+#include <elasticlient/bulk.h>
+#include <elasticlient/bulk-loader.h>
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t documents = 200000;
+const std::size_t bulkSize = 1000;
+
+
+bench::Response handleBulk(const bench::Request &) {
+    return bench::Response{200, "{\"took\": 1, \"errors\": false, \"items\": []}"};
+}
+
+
+void report(const std::string &name, std::size_t count, double seconds) {
+    std::cout << name << ": " << count / seconds << " docs/s" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    char path[] = "/tmp/bench-bulk-loader-XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        std::cerr << "Cannot create input file." << std::endl;
+        return 1;
+    }
+    close(fd);
+    {
+        std::ofstream file(path);
+        for (std::size_t i = 0; i < documents; ++i) {
+            file << "{\"title\": \"" << std::string(150, 'x') << "\", \"count\": " << i << "}\n";
+        }
+    }
+
+    bench::BenchServer node(handleBulk);
+    std::shared_ptr<elasticlient::Client> client = std::make_shared<elasticlient::Client>(
+            std::vector<std::string>({node.url()}));
+
+    {
+        elasticlient::Bulk indexer(client);
+        elasticlient::SameIndexBulkData bulk("bench", bulkSize);
+        std::size_t count = 0;
+        const double seconds = bench::measure([&]() {
+            std::ifstream file(path);
+            std::string line;
+            while (std::getline(file, line)) {
+                if (bulk.indexDocument("_doc", "", line)) {
+                    indexer.perform(bulk);
+                    bulk.clear();
+                }
+                ++count;
+            }
+            indexer.perform(bulk);
+        });
+        report("getline + indexDocument + perform", count, seconds);
+    }
+
+    for (std::size_t workers: {1, 2, 4}) {
+        elasticlient::BulkFileLoader::Settings settings;
+        settings.maxDocuments = bulkSize;
+        settings.workers = workers;
+        elasticlient::BulkFileLoader loader(client, "bench", settings);
+        elasticlient::BulkFileLoader::Progress progress;
+        const double seconds = bench::measure([&]() {
+            progress = loader.load(path);
+        });
+        report("BulkFileLoader, " + std::to_string(workers) + " workers",
+               progress.documents, seconds);
+    }
+
+    std::remove(path);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/**
+ * \file
+ * Benchmark of parallel bulk sending. Three nodes with injected latency (fixed per
+ * request plus per item) are indexed into by Bulk::perform() of sub-bulks one after
+ * another and by Bulk::performParallel() with growing parallelism. Reports throughput
+ * and distribution of requests over the nodes.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <elasticlient/client.h>
+#include <elasticlient/bulk.h>
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t documents = 20000;
+const std::size_t subBulkSize = 500;
+const std::chrono::milliseconds requestLatency(10);
+const std::chrono::microseconds itemLatency(20);
+
+
+/// Return simulated node answering bulk after latency given by number of its items.
+bench::Response handleBulk(const bench::Request &request) {
+    const std::size_t items = std::count(request.body.begin(), request.body.end(), '\n') / 2;
+    std::this_thread::sleep_for(requestLatency + itemLatency * items);
+    return bench::Response{200, "{\"took\": 1, \"errors\": false, \"items\": []}"};
+}
+
+
+void report(const std::string &name, double seconds,
+            const std::vector<std::unique_ptr<bench::BenchServer>> &nodes)
+{
+    std::cout << name << ": " << documents / seconds << " docs/s, requests per node";
+    for (const std::unique_ptr<bench::BenchServer> &node: nodes) {
+        std::cout << " " << node->requestCount();
+    }
+    std::cout << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    elasticlient::SameIndexBulkData bulk("bench", documents);
+    const std::string doc = "{\"title\": \"" + std::string(150, 'x') + "\", \"count\": 42}";
+    for (std::size_t i = 0; i < documents; ++i) {
+        bulk.indexDocument("doc", "document-" + std::to_string(i), doc);
+    }
+    std::vector<std::unique_ptr<elasticlient::SameIndexBulkData>> subBulks;
+    for (std::size_t i = 0; i < documents; i += subBulkSize) {
+        subBulks.emplace_back(new elasticlient::SameIndexBulkData("bench", subBulkSize));
+        for (std::size_t j = i; j < i + subBulkSize && j < documents; ++j) {
+            subBulks.back()->indexDocument("doc", "document-" + std::to_string(j), doc);
+        }
+    }
+
+    const auto startNodes = [](std::vector<std::string> &hosts) {
+        std::vector<std::unique_ptr<bench::BenchServer>> nodes;
+        hosts.clear();
+        for (int i = 0; i < 3; ++i) {
+            nodes.emplace_back(new bench::BenchServer(handleBulk));
+            hosts.push_back(nodes.back()->url());
+        }
+        return nodes;
+    };
+
+    {
+        std::vector<std::string> hosts;
+        const std::vector<std::unique_ptr<bench::BenchServer>> nodes = startNodes(hosts);
+        elasticlient::Bulk indexer(std::make_shared<elasticlient::Client>(hosts));
+        const double seconds = bench::measure([&]() {
+            for (const std::unique_ptr<elasticlient::SameIndexBulkData> &subBulk: subBulks) {
+                indexer.perform(*subBulk);
+            }
+        });
+        report("perform() of sub-bulks", seconds, nodes);
+    }
+
+    for (std::size_t parallelism: {1, 2, 4, 8, 16}) {
+        std::vector<std::string> hosts;
+        const std::vector<std::unique_ptr<bench::BenchServer>> nodes = startNodes(hosts);
+        elasticlient::Bulk indexer(std::make_shared<elasticlient::Client>(
+                hosts, elasticlient::Client::LoadBalancingOption()));
+        indexer.setParallelism(parallelism);
+        const double seconds = bench::measure([&]() {
+            indexer.performParallel(bulk, subBulkSize);
+        });
+        report("performParallel(), parallelism " + std::to_string(parallelism), seconds, nodes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * \file
+ * Benchmark of single producer thread filling bulks for node with injected latency.
+ * Bulks filled and sent by Bulk::perform() one after another are compared with
+ * BulkPipeline of two and three buffers, where filling overlaps with sending, and
+ * with filling alone as the upper bound.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <elasticlient/client.h>
+#include <elasticlient/bulk.h>
+#include <elasticlient/bulk-pipeline.h>
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t documents = 200000;
+const std::size_t bulkSize = 2000;
+const std::chrono::milliseconds requestLatency(5);
+const std::chrono::nanoseconds itemLatency(500);
+
+
+/// Return simulated node answering bulk after latency given by number of its items.
+bench::Response handleBulk(const bench::Request &request) {
+    const std::size_t items = std::count(request.body.begin(), request.body.end(), '\n') / 2;
+    std::this_thread::sleep_for(requestLatency + itemLatency * items);
+    return bench::Response{200, "{\"took\": 1, \"errors\": false, \"items\": []}"};
+}
+
+
+/// Return document \p i, built as producer would do.
+std::string makeDocument(std::size_t i) {
+    std::string doc = "{\"title\": \"document " + std::to_string(i) + "\", \"tags\": [";
+    for (std::size_t tag = 0; tag < 8; ++tag) {
+        doc += (tag ? ", \"tag" : "\"tag") + std::to_string((i + tag) % 100) + "\"";
+    }
+    return doc + "], \"count\": " + std::to_string(i * 7) + "}";
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    bench::BenchServer node(handleBulk);
+    std::shared_ptr<elasticlient::Client> client = std::make_shared<elasticlient::Client>(
+            std::vector<std::string>({node.url()}));
+
+    {
+        elasticlient::SameIndexBulkData bulk("bench", bulkSize);
+        const double seconds = bench::measure([&]() {
+            for (std::size_t i = 0; i < documents; ++i) {
+                if (bulk.indexDocument("doc", std::to_string(i), makeDocument(i))) {
+                    bulk.clear();
+                }
+            }
+        });
+        std::cout << "filling only: " << documents / seconds << " docs/s" << std::endl;
+    }
+
+    {
+        elasticlient::Bulk indexer(client);
+        elasticlient::SameIndexBulkData bulk("bench", bulkSize);
+        const double seconds = bench::measure([&]() {
+            for (std::size_t i = 0; i < documents; ++i) {
+                if (bulk.indexDocument("doc", std::to_string(i), makeDocument(i))) {
+                    indexer.perform(bulk);
+                    bulk.clear();
+                }
+            }
+            indexer.perform(bulk);
+        });
+        std::cout << "perform(): " << documents / seconds << " docs/s" << std::endl;
+    }
+
+    for (std::size_t buffers: {2, 3}) {
+        elasticlient::BulkPipeline::Settings settings;
+        settings.buffers = buffers;
+        settings.maxDocuments = bulkSize;
+        elasticlient::BulkPipeline pipeline(client, "bench", settings);
+        const double seconds = bench::measure([&]() {
+            for (std::size_t i = 0; i < documents; ++i) {
+                if (pipeline.current().indexDocument("doc", std::to_string(i), makeDocument(i))) {
+                    pipeline.send();
+                }
+            }
+            pipeline.flush();
+        });
+        std::cout << "BulkPipeline, " << buffers << " buffers: " << documents / seconds
+                  << " docs/s, producer waited "
+                  << pipeline.getWaitTime().count() / 1000 << " ms" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/**
+ * \file
+ * Benchmark of bulk response checking. Compares former JsonCpp document tree with
+ * incremental BulkResponseScanner on responses without errors and with 1% of failed
+ * items. Reports time per response and throughput.
+ */
+
+#include <string>
+#include <iostream>
+#include <json/json.h>
+#include "bulk-response-impl.h"
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t bulkSize = 10000;
+const std::size_t rounds = 50;
+
+
+/// Build bulk response of bulkSize items, each \p failEvery-th item failed (0 for none).
+std::string buildResponse(std::size_t failEvery) {
+    std::string response = "{\"took\":30,\"errors\":";
+    response += failEvery ? "true" : "false";
+    response += ",\"items\":[";
+    for (std::size_t i = 0; i < bulkSize; ++i) {
+        if (i) {
+            response += ',';
+        }
+        const std::string id = "document-" + std::to_string(i);
+        response += "{\"index\":{\"_index\":\"bench\",\"_type\":\"doc\",\"_id\":\"" + id + "\",";
+        if (failEvery && i % failEvery == 0) {
+            response += "\"status\":400,\"error\":{\"type\":\"mapper_parsing_exception\","
+                        "\"reason\":\"failed to parse [count]\",\"caused_by\":{"
+                        "\"type\":\"number_format_exception\","
+                        "\"reason\":\"For input string: \\\"x\\\"\"}}}}";
+        } else {
+            response += "\"_version\":1,\"result\":\"created\",\"_shards\":{\"total\":2,"
+                        "\"successful\":1,\"failed\":0},\"_seq_no\":" + std::to_string(i)
+                      + ",\"_primary_term\":1,\"status\":201}}";
+        }
+    }
+    response += "]}";
+    return response;
+}
+
+
+/// Count failed items as Bulk used to do, by JsonCpp document tree.
+std::size_t countByJsonCpp(const std::string &response) {
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(response, root, false)) {
+        return bulkSize;
+    }
+    if (root["errors"].isBool() && !root["errors"].asBool()) {
+        return 0;
+    }
+    std::size_t failed = 0;
+    const Json::Value &items = root["items"];
+    for (Json::ArrayIndex position = 0; position < items.size(); ++position) {
+        const Json::Value &res = *items[position].begin();
+        const int status = res.get("status", Json::Int(500)).asInt();
+        if (status / 100 != 2) {
+            const Json::Value &error = res["error"];
+            failed += !error.get("type", "").asString().empty();
+        }
+    }
+    return failed;
+}
+
+
+/// Count failed items by BulkResponseScanner, as Bulk does.
+std::size_t countByScanner(const std::string &response, bool stopOnNoErrors) {
+    elasticlient::BulkResponseScanner scanner(response);
+    const elasticlient::BulkResponseScanner::Start start = scanner.start(stopOnNoErrors);
+    if (start != elasticlient::BulkResponseScanner::Start::ITEMS) {
+        return start == elasticlient::BulkResponseScanner::Start::INVALID ? bulkSize : 0;
+    }
+    std::size_t failed = 0;
+    elasticlient::BulkItemResponse item;
+    while (scanner.nextItem(item)) {
+        if (item.status / 100 != 2) {
+            failed += !item.errorType.empty();
+        }
+    }
+    return failed;
+}
+
+
+/// Run \p count on \p response for rounds and report per response results.
+template <typename Count>
+void run(const std::string &name, const std::string &response, Count count) {
+    std::size_t failed = 0;
+    const double seconds = bench::measure([&]() {
+        for (std::size_t round = 0; round < rounds; ++round) {
+            failed += count(response);
+        }
+    });
+    std::cout << name << ": " << seconds * 1e3 / rounds << " ms/response, "
+              << response.size() * rounds / seconds / (1024 * 1024) << " MB/s, "
+              << failed / rounds << " failed items" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    const std::string noErrors = buildResponse(0);
+    const std::string someErrors = buildResponse(100);
+    std::cout << bulkSize << " items, " << noErrors.size() << " / "
+              << someErrors.size() << " bytes" << std::endl;
+
+    run("errors=false, JsonCpp", noErrors, countByJsonCpp);
+    run("errors=false, scanner", noErrors,
+        [](const std::string &response) { return countByScanner(response, true); });
+    run("errors=false, scanner reading all items", noErrors,
+        [](const std::string &response) { return countByScanner(response, false); });
+    run("1% errors, JsonCpp", someErrors, countByJsonCpp);
+    run("1% errors, scanner", someErrors,
+        [](const std::string &response) { return countByScanner(response, true); });
+
+    return 0;
+}
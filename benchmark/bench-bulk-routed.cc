@@ -0,0 +1,178 @@
+/**
+ * \file
+ * Benchmark of shard-routed bulks on simulated cluster. Three nodes hold twelve primary
+ * shards; bulk request waits for the slowest shard it touches, shard operation takes
+ * fixed time plus time per item, sometimes much longer (merge, GC), and forwarding
+ * to shard on other node adds a hop. Mixed sub-bulks sent by performParallel() are
+ * compared with bulks per shard and per node sent by performRouted(). Reports
+ * throughput and latency percentiles of whole bulks.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <elasticlient/client.h>
+#include <elasticlient/bulk.h>
+#include <elasticlient/bulk-router.h>
+#include "bulk-router-impl.h"
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t nodeCount = 3;
+const std::size_t shardCount = 12;
+const std::size_t bulks = 60;
+const std::size_t bulkSize = 3000;
+const std::chrono::microseconds shardLatency(1000);
+const std::chrono::microseconds itemLatency(10);
+const std::chrono::microseconds hopLatency(2000);
+const std::chrono::microseconds slowShardLatency(30000);
+const double slowShardProbability = 0.02;
+
+
+/// Simulated cluster, shard s has its primary on node s % nodeCount.
+class Cluster {
+  public:
+    Cluster(): nodes(), hosts(), routing(), random(42), randomMutex() {
+        routing.numberOfShards = shardCount;
+        routing.routingNumShards = shardCount;
+        for (std::size_t node = 0; node < nodeCount; ++node) {
+            nodes.emplace_back(new bench::BenchServer([this, node](const bench::Request &r) {
+                return handle(node, r);
+            }));
+            hosts.push_back(nodes.back()->url());
+        }
+    }
+
+    const std::vector<std::string> &getHosts() const {
+        return hosts;
+    }
+
+  private:
+    bench::Response handle(std::size_t node, const bench::Request &request) {
+        if (request.url.find("/_cluster/state/") == 0) {
+            std::string shards;
+            for (std::size_t shard = 0; shard < shardCount; ++shard) {
+                shards += (shard ? ", \"" : "\"") + std::to_string(shard)
+                        + "\": [{\"state\": \"STARTED\", \"primary\": true, \"node\": \"node"
+                        + std::to_string(shard % nodeCount) + "\"}]";
+            }
+            return bench::Response{200,
+                "{\"metadata\": {\"indices\": {\"bench\": {\"routing_num_shards\": "
+                + std::to_string(shardCount) + ", \"settings\": {\"index\": "
+                "{\"number_of_shards\": \"" + std::to_string(shardCount) + "\"}}}}}, "
+                "\"routing_table\": {\"indices\": {\"bench\": {\"shards\": {" + shards + "}}}}}"};
+        }
+        if (request.url == "/_nodes/http") {
+            std::string nodesBody;
+            for (std::size_t i = 0; i < nodeCount; ++i) {
+                // "http://127.0.0.1:port/" -> "127.0.0.1:port"
+                const std::string address = hosts[i].substr(7, hosts[i].size() - 8);
+                nodesBody += (i ? ", \"node" : "\"node") + std::to_string(i)
+                           + "\": {\"http\": {\"publish_address\": \"" + address + "\"}}";
+            }
+            return bench::Response{200, "{\"nodes\": {" + nodesBody + "}}"};
+        }
+
+        // items per shard touched by the request
+        std::vector<std::size_t> items(shardCount);
+        std::size_t pos = 0;
+        while ((pos = request.body.find("\"_id\": \"", pos)) != std::string::npos) {
+            pos += 8;
+            const std::string id = request.body.substr(pos, request.body.find('"', pos) - pos);
+            ++items[routing.shardOf(id, std::string())];
+        }
+        std::chrono::microseconds latency(0);
+        for (std::size_t shard = 0; shard < shardCount; ++shard) {
+            if (!items[shard]) {
+                continue;
+            }
+            std::chrono::microseconds shardTime = shardLatency + itemLatency * items[shard];
+            if (shard % nodeCount != node) {
+                shardTime += hopLatency;
+            }
+            if (isSlow()) {
+                shardTime += slowShardLatency;
+            }
+            latency = std::max(latency, shardTime);
+        }
+        std::this_thread::sleep_for(latency);
+        return bench::Response{200, "{\"took\": 1, \"errors\": false, \"items\": []}"};
+    }
+
+    bool isSlow() {
+        std::lock_guard<std::mutex> lock(randomMutex);
+        return std::bernoulli_distribution(slowShardProbability)(random);
+    }
+
+    std::vector<std::unique_ptr<bench::BenchServer>> nodes;
+    std::vector<std::string> hosts;
+    elasticlient::IndexRouting routing;
+    std::mt19937 random;
+    std::mutex randomMutex;
+};
+
+
+/// Run \p perform for each bulk, report throughput and latency percentiles.
+template <typename Fn>
+void run(const std::string &name, Fn &&perform) {
+    std::vector<double> latencies;
+    const double seconds = bench::measure([&]() {
+        for (std::size_t i = 0; i < bulks; ++i) {
+            latencies.push_back(bench::measure(perform) * 1000);
+        }
+    });
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << ": " << bulks * bulkSize / seconds << " docs/s, bulk latency p50 "
+              << bench::percentile(latencies, 50) << " ms, p99 "
+              << bench::percentile(latencies, 99) << " ms" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    elasticlient::SameIndexBulkData bulk("bench", bulkSize);
+    const std::string doc = "{\"title\": \"" + std::string(150, 'x') + "\", \"count\": 42}";
+    for (std::size_t i = 0; i < bulkSize; ++i) {
+        bulk.indexDocument("doc", "document-" + std::to_string(i), doc);
+    }
+
+    for (std::size_t parallelism: {1, 3, 12}) {
+        Cluster cluster;
+        elasticlient::Bulk indexer(std::make_shared<elasticlient::Client>(
+                cluster.getHosts(), elasticlient::Client::LoadBalancingOption()));
+        indexer.setParallelism(parallelism);
+        run("performParallel(), " + std::to_string(parallelism) + " mixed sub-bulks", [&]() {
+            indexer.performParallel(bulk, (bulkSize + parallelism - 1) / parallelism);
+        });
+    }
+
+    for (elasticlient::BulkShardRouter::Grouping grouping:
+         {elasticlient::BulkShardRouter::Grouping::SHARD,
+          elasticlient::BulkShardRouter::Grouping::NODE})
+    {
+        Cluster cluster;
+        std::shared_ptr<elasticlient::Client> client = std::make_shared<elasticlient::Client>(
+                cluster.getHosts(), elasticlient::Client::LoadBalancingOption());
+        elasticlient::BulkShardRouter::Settings settings;
+        settings.grouping = grouping;
+        elasticlient::BulkShardRouter router(client, settings);
+        elasticlient::Bulk indexer(client);
+        indexer.setParallelism(shardCount);
+        const bool shard = grouping == elasticlient::BulkShardRouter::Grouping::SHARD;
+        run(std::string("performRouted(), bulk per ") + (shard ? "shard" : "node"), [&]() {
+            indexer.performRouted(bulk, router);
+        });
+    }
+
+    return 0;
+}
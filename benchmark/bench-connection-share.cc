@@ -0,0 +1,74 @@
+/**
+ * \file
+ * Benchmark of short-lived Clients with and without ConnectionShare. Reports time per
+ * request and number of connections (handshakes) the server had to accept.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cpr/response.h>
+#include <elasticlient/client.h>
+#include <elasticlient/bulk.h>
+#include "bench-server.h"
+
+
+namespace {
+
+
+const int iterations = 2000;
+
+
+/// Run \p iterations of short-lived Bulk objects, each performing one bulk.
+void runBulks(const std::vector<std::string> &hosts,
+              const std::shared_ptr<elasticlient::ConnectionShare> &share)
+{
+    elasticlient::SameIndexBulkData bulk("bench");
+    bulk.indexDocument("doc", "1", "{\"field\": 1}");
+    for (int i = 0; i < iterations; ++i) {
+        if (share) {
+            elasticlient::Bulk(hosts, 6000, share).perform(bulk);
+        } else {
+            elasticlient::Bulk(hosts, 6000).perform(bulk);
+        }
+    }
+}
+
+
+void report(const std::string &name, double seconds, const bench::BenchServer &server) {
+    std::cout << name << ": " << seconds * 1e6 / iterations << " us/request, "
+              << server.connectionCount() << " connections for "
+              << server.requestCount() << " requests" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    const std::string bulkResponse = "{\"took\": 1, \"errors\": false, \"items\": []}";
+    const auto handler = [&bulkResponse](const bench::Request &) {
+        return bench::Response{200, bulkResponse};
+    };
+
+    {
+        bench::BenchServer server(handler);
+        const double seconds = bench::measure([&server]() {
+            runBulks({server.url()}, nullptr);
+        });
+        report("separate sessions", seconds, server);
+    }
+
+    {
+        bench::BenchServer server(handler);
+        const std::shared_ptr<elasticlient::ConnectionShare> share =
+                std::make_shared<elasticlient::ConnectionShare>(true);
+        const double seconds = bench::measure([&server, &share]() {
+            runBulks({server.url()}, share);
+        });
+        report("connection share", seconds, server);
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * \file
+ * Microbenchmark of bulk control line generation. Compares control line built by
+ * std::ostringstream (without escaping, as createControl() used to) with escaping
+ * appendControl() and ControlLineWriter with cached prefixes. Reports ns per document.
+ */
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <elasticlient/bulk.h>
+#include "bulk-impl.h"
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t documents = 1000;
+const std::size_t rounds = 2000;
+
+
+/// Control line built as former createControl() did.
+std::string streamControl(const std::string &action, const std::string &docType,
+                          const std::string &docId, const std::string &routing)
+{
+    std::ostringstream control;
+    control << "{\"" << action << "\": {\"_type\": \"" << docType << "\", \"_id\": \""
+            << docId << "\", \"routing\": \"" << routing << "\"}}";
+    return control.str();
+}
+
+
+/// Run \p append for all documents in rounds, report time per document.
+template <typename Append>
+void run(const std::string &name, const std::vector<std::string> &ids, Append append) {
+    std::string buffer;
+    std::size_t bytes = 0;
+    const double seconds = bench::measure([&]() {
+        for (std::size_t round = 0; round < rounds; ++round) {
+            buffer.clear();
+            for (const std::string &id: ids) {
+                append(buffer, id);
+            }
+            bytes += buffer.size();
+        }
+    });
+    std::cout << name << ": " << seconds * 1e9 / (rounds * ids.size()) << " ns/doc ("
+              << bytes / rounds / ids.size() << " B/line)" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    for (bool quoted: {false, true}) {
+        std::vector<std::string> ids;
+        for (std::size_t i = 0; i < documents; ++i) {
+            ids.push_back("user-document-" + std::to_string(i) + (quoted ? "-\"x\"" : ""));
+        }
+        elasticlient::BulkItemMetadata metadata;
+        metadata.routing = "tenant-12345";
+        std::cout << (quoted ? "IDs with quotes" : "plain IDs") << std::endl;
+
+        run("  ostringstream, not escaped", ids,
+            [&](std::string &out, const std::string &id) {
+                out += streamControl("index", "_doc", id, metadata.routing);
+            });
+        run("  appendControl()", ids,
+            [&](std::string &out, const std::string &id) {
+                elasticlient::appendControl(out, "index", "", "_doc", id, &metadata);
+            });
+        elasticlient::ControlLineWriter writer;
+        run("  ControlLineWriter", ids,
+            [&](std::string &out, const std::string &id) {
+                writer.append(out, "index", "", "_doc", id, &metadata);
+            });
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * \file
+ * Benchmark of document validation. Compares former newline search with full
+ * document check scanning byte by byte and by vector instructions. Reports
+ * throughput on plain ASCII and on text heavy UTF-8 documents.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "bulk-validate-impl.h"
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t documents = 1000;
+const std::size_t rounds = 500;
+
+
+/// Run \p check on all documents in rounds, report throughput.
+template <typename Check>
+void run(const std::string &name, const std::vector<std::string> &docs, Check check) {
+    std::size_t bytes = 0;
+    std::size_t valid = 0;
+    const double seconds = bench::measure([&]() {
+        for (std::size_t round = 0; round < rounds; ++round) {
+            for (const std::string &doc: docs) {
+                valid += check(doc);
+                bytes += doc.size();
+            }
+        }
+    });
+    std::cout << "  " << name << ": " << bytes / seconds / (1024 * 1024) << " MB/s, "
+              << seconds * 1e9 / (rounds * docs.size()) << " ns/doc"
+              << (valid == rounds * docs.size() ? "" : " (some invalid)") << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    const std::string ascii = std::string(60, 'x') + " lorem ipsum dolor sit amet ";
+    const std::string utf8 = "P\xc5\x99\xc3\xad\xc5\xa1" "ern\xc4\x9b \xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd "
+                             "k\xc5\xaf\xc5\x88 \xc3\xbap\xc4\x9bl \xc4\x8f\xc3\xa1" "belsk\xc3\xa9 \xc3\xb3" "dy ";
+    for (const std::string *text: {&ascii, &utf8}) {
+        std::vector<std::string> docs;
+        for (std::size_t i = 0; i < documents; ++i) {
+            std::string doc = "{\"id\": " + std::to_string(i) + ", \"tags\": [\"a\", \"b\"], "
+                              "\"nested\": {\"count\": 42, \"text\": \"";
+            for (int j = 0; j < 10; ++j) {
+                doc += *text;
+            }
+            doc += "\"}}";
+            docs.push_back(doc);
+        }
+        std::cout << (text == &ascii ? "ASCII" : "UTF-8") << " documents of "
+                  << docs.front().size() << " B" << std::endl;
+
+        run("find_first_of(\"\\n\")", docs, [](const std::string &doc) {
+            return doc.find_first_of("\n") == std::string::npos;
+        });
+        run("checkDocumentScalar()", docs, [](const std::string &doc) {
+            return elasticlient::checkDocumentScalar(doc.data(), doc.size())
+                == elasticlient::DocumentCheck::VALID;
+        });
+        run("checkDocument()", docs, [](const std::string &doc) {
+            return elasticlient::checkDocument(doc.data(), doc.size())
+                == elasticlient::DocumentCheck::VALID;
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * \file
+ * Benchmark of adding parsed documents to bulk. Documents serialized by Json::FastWriter
+ * and added as strings (without validation) are compared with Json::Value written
+ * straight into the bulk buffer. Documents of typical log record are mostly numbers,
+ * second one is mostly text. Reports throughput of documents and bytes.
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <json/json.h>
+#include <elasticlient/bulk.h>
+#include "bench-server.h"
+
+
+namespace {
+
+
+const std::size_t documents = 20000;
+const std::size_t rounds = 10;
+const std::size_t bulkSize = 1000;
+
+
+/// Return log record \p i, mostly integers and doubles.
+Json::Value makeRecord(std::size_t i) {
+    Json::Value record;
+    record["timestamp"] = Json::Value::UInt64(1700000000000ULL + i * 37);
+    record["host"] = "node-" + std::to_string(i % 16);
+    record["status"] = 200 + static_cast<int>(i % 5) * 100;
+    record["bytes"] = Json::Value::UInt64(i * 7919 % 1000000);
+    record["duration"] = (i % 1000) / 7.0;
+    record["cpu"] = static_cast<double>(i % 100);
+    for (std::size_t j = 0; j < 8; ++j) {
+        record["latencies"].append((i + j) * 0.25);
+    }
+    record["geo"]["lat"] = 50.0755 + i * 1e-6;
+    record["geo"]["lon"] = 14.4378 - i * 1e-6;
+    return record;
+}
+
+
+/// Return article \p i, mostly text.
+Json::Value makeArticle(std::size_t i) {
+    Json::Value article;
+    article["title"] = "Article number " + std::to_string(i);
+    article["body"] = std::string(400, 'x') + " \"quoted\" " + std::to_string(i);
+    for (std::size_t tag = 0; tag < 5; ++tag) {
+        article["tags"].append("tag" + std::to_string((i + tag) % 100));
+    }
+    article["published"] = true;
+    return article;
+}
+
+
+/// Add all \p docs to bulk \p rounds times with \p add, report throughput.
+template <typename Fn>
+void run(const std::string &name, const std::vector<Json::Value> &docs, Fn &&add) {
+    elasticlient::SameIndexBulkData bulk("bench", bulkSize);
+    std::size_t bytes = 0;
+    const double seconds = bench::measure([&]() {
+        for (std::size_t round = 0; round < rounds; ++round) {
+            for (std::size_t i = 0; i < docs.size(); ++i) {
+                if (add(bulk, std::to_string(i), docs[i])) {
+                    bytes += bulk.byteSize();
+                    bulk.clear();
+                }
+            }
+        }
+    });
+    bytes += bulk.byteSize();
+    std::cout << name << ": " << rounds * docs.size() / seconds << " docs/s, "
+              << bytes / seconds / 1024 / 1024 << " MB/s" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    std::vector<Json::Value> records;
+    std::vector<Json::Value> articles;
+    for (std::size_t i = 0; i < documents; ++i) {
+        records.push_back(makeRecord(i));
+        articles.push_back(makeArticle(i));
+    }
+
+    for (const std::vector<Json::Value> *docs: {&records, &articles}) {
+        const std::string kind = docs == &records ? "records" : "articles";
+        Json::FastWriter writer;
+        writer.omitEndingLineFeed();
+        run("FastWriter + indexDocument(string), " + kind, *docs,
+            [&](elasticlient::SameIndexBulkData &bulk, const std::string &id,
+                const Json::Value &doc)
+        {
+            return bulk.indexDocument("doc", id, writer.write(doc), false);
+        });
+        run("indexDocument(JsonDocument), " + kind, *docs,
+            [](elasticlient::SameIndexBulkData &bulk, const std::string &id,
+               const Json::Value &doc)
+        {
+            return bulk.indexDocument("doc", id, doc);
+        });
+    }
+
+    return 0;
+}
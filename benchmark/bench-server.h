@@ -0,0 +1,306 @@
+/**
+ * \file
+ * Minimal HTTP/1.1 keep-alive server for elasticlient benchmarks. It stands in for
+ * Elasticsearch node, counts accepted connections and answers requests by handler.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <functional>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+
+namespace bench {
+
+
+/// Request received by the BenchServer.
+struct Request {
+    std::string method;
+    std::string url;
+    std::string body;
+};
+
+
+/// Response sent by the BenchServer.
+struct Response {
+    int status;
+    std::string body;
+};
+
+
+class BenchServer {
+  public:
+    using Handler = std::function<Response(const Request &)>;
+
+    /// Start server listening on ephemeral loopback port.
+    explicit BenchServer(Handler handler)
+      : handler(std::move(handler)), listenFd(-1), port(0), unixSocketPath(), running(false),
+        connections(0), requests(0), acceptor(), workersMutex(), workers()
+    {
+        listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            throw std::runtime_error("Cannot create socket.");
+        }
+        int one = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+            throw std::runtime_error("Cannot bind socket.");
+        }
+        socklen_t len = sizeof(addr);
+        ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len);
+        port = ntohs(addr.sin_port);
+        start();
+    }
+
+    /// Start server listening on Unix domain socket \p path.
+    BenchServer(Handler handler, const std::string &path)
+      : handler(std::move(handler)), listenFd(-1), port(0), unixSocketPath(path),
+        running(false), connections(0), requests(0), acceptor(), workersMutex(), workers()
+    {
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            throw std::runtime_error("Cannot create socket.");
+        }
+        ::unlink(path.c_str());
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+            throw std::runtime_error("Cannot bind socket.");
+        }
+        start();
+    }
+
+    ~BenchServer() {
+        running = false;
+        ::shutdown(listenFd, SHUT_RDWR);
+        ::close(listenFd);
+        acceptor.join();
+        {
+            std::lock_guard<std::mutex> lock(workersMutex);
+            for (const Worker &worker: workers) {
+                if (worker.fd >= 0) {
+                    ::shutdown(worker.fd, SHUT_RDWR);
+                }
+            }
+        }
+        for (Worker &worker: workers) {
+            worker.thread.join();
+        }
+        if (!unixSocketPath.empty()) {
+            ::unlink(unixSocketPath.c_str());
+        }
+    }
+
+    /// Return URL of the server usable in Client hostUrlList.
+    std::string url() const {
+        if (!unixSocketPath.empty()) {
+            return "unix://" + unixSocketPath;
+        }
+        return "http://127.0.0.1:" + std::to_string(port) + "/";
+    }
+
+    /// Return number of connections accepted so far.
+    std::size_t connectionCount() const {
+        return connections;
+    }
+
+    /// Return number of requests served so far.
+    std::size_t requestCount() const {
+        return requests;
+    }
+
+  private:
+    struct Worker {
+        int fd;
+        std::thread thread;
+    };
+
+    void start() {
+        if (::listen(listenFd, 1024) != 0) {
+            throw std::runtime_error("Cannot listen on socket.");
+        }
+        running = true;
+        acceptor = std::thread([this]() {
+            while (running) {
+                const int fd = ::accept(listenFd, nullptr, nullptr);
+                if (fd < 0) {
+                    continue;
+                }
+                if (unixSocketPath.empty()) {
+                    int one = 1;
+                    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                }
+                ++connections;
+                std::lock_guard<std::mutex> lock(workersMutex);
+                workers.push_back(Worker{fd, std::thread(&BenchServer::serve, this,
+                                                         fd, workers.size())});
+            }
+        });
+    }
+
+    /// Read more data from \p fd into \p buffer, return false on EOF.
+    static bool fill(int fd, std::string &buffer) {
+        char chunk[65536];
+        const ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, n);
+        return true;
+    }
+
+    /// Read single CRLF terminated line.
+    static bool readLine(int fd, std::string &buffer, std::string &line) {
+        std::size_t pos;
+        while ((pos = buffer.find("\r\n")) == std::string::npos) {
+            if (!fill(fd, buffer)) {
+                return false;
+            }
+        }
+        line.assign(buffer, 0, pos);
+        buffer.erase(0, pos + 2);
+        return true;
+    }
+
+    /// Read exactly \p size bytes and append them to \p out.
+    static bool readBytes(int fd, std::string &buffer, std::size_t size, std::string &out) {
+        while (buffer.size() < size) {
+            if (!fill(fd, buffer)) {
+                return false;
+            }
+        }
+        out.append(buffer, 0, size);
+        buffer.erase(0, size);
+        return true;
+    }
+
+    /// Read request (including chunked body) from the connection.
+    static bool readRequest(int fd, std::string &buffer, Request &request) {
+        std::string line;
+        if (!readLine(fd, buffer, line)) {
+            return false;
+        }
+        std::istringstream requestLine(line);
+        requestLine >> request.method >> request.url;
+        request.body.clear();
+
+        std::size_t contentLength = 0;
+        bool chunked = false;
+        while (readLine(fd, buffer, line) && !line.empty()) {
+            const std::size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            const std::string key = line.substr(0, colon);
+            const std::string value = line.substr(colon + 1);
+            if (::strcasecmp(key.c_str(), "Content-Length") == 0) {
+                contentLength = std::strtoul(value.c_str(), nullptr, 10);
+            } else if (::strcasecmp(key.c_str(), "Transfer-Encoding") == 0
+                       && value.find("chunked") != std::string::npos)
+            {
+                chunked = true;
+            }
+        }
+
+        if (!chunked) {
+            return readBytes(fd, buffer, contentLength, request.body);
+        }
+        while (true) {
+            if (!readLine(fd, buffer, line)) {
+                return false;
+            }
+            const std::size_t size = std::strtoul(line.c_str(), nullptr, 16);
+            if (!readBytes(fd, buffer, size, request.body) || !readLine(fd, buffer, line)) {
+                return false;
+            }
+            if (size == 0) {
+                return true;
+            }
+        }
+    }
+
+    /// Serve requests on one keep-alive connection.
+    void serve(int fd, std::size_t workerIndex) {
+        std::string buffer;
+        Request request;
+        while (readRequest(fd, buffer, request)) {
+            const Response response = handler(request);
+            ++requests;
+            std::ostringstream out;
+            out << "HTTP/1.1 " << response.status << " Bench\r\n"
+                   "Content-Type: application/json; charset=UTF-8\r\n"
+                   "Content-Length: " << response.body.size() << "\r\n\r\n"
+                << response.body;
+            const std::string data = out.str();
+            std::size_t sent = 0;
+            while (sent < data.size()) {
+                const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent,
+                                         MSG_NOSIGNAL);
+                if (n <= 0) {
+                    break;
+                }
+                sent += n;
+            }
+        }
+        std::lock_guard<std::mutex> lock(workersMutex);
+        ::close(fd);
+        workers[workerIndex].fd = -1;
+    }
+
+    Handler handler;
+    int listenFd;
+    unsigned port;
+    std::string unixSocketPath;
+    std::atomic<bool> running;
+    std::atomic<std::size_t> connections;
+    std::atomic<std::size_t> requests;
+    std::thread acceptor;
+    std::mutex workersMutex;
+    std::vector<Worker> workers;
+};
+
+
+/// Return \p percentile (0-100) of sorted \p samples.
+inline double percentile(const std::vector<double> &samples, double percentile) {
+    if (samples.empty()) {
+        return 0;
+    }
+    const std::size_t index = static_cast<std::size_t>(percentile / 100 * (samples.size() - 1));
+    return samples[index];
+}
+
+
+/// Return number of seconds \p fn took to run.
+template <typename Fn>
+double measure(Fn &&fn) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+}  // namespace bench
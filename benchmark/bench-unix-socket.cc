@@ -0,0 +1,67 @@
+/**
+ * \file
+ * Benchmark of request latency to local node over loopback TCP and Unix domain socket.
+ */
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <cpr/response.h>
+#include <elasticlient/client.h>
+#include "bench-server.h"
+
+
+namespace {
+
+
+const int warmup = 1000;
+const int iterations = 20000;
+
+
+/// Perform requests over single client and report latency percentiles.
+void run(const std::string &name, const std::string &hostUrl) {
+    elasticlient::Client client({hostUrl});
+    const std::string body = "{\"query\": {\"match_all\": {}}}";
+    for (int i = 0; i < warmup; ++i) {
+        client.search("bench", "doc", body);
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        samples.push_back(bench::measure([&client, &body]() {
+            client.search("bench", "doc", body);
+        }));
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (double sample: samples) {
+        total += sample;
+    }
+    std::cout << name << ": mean " << total * 1e6 / iterations << " us, p50 "
+              << bench::percentile(samples, 50) * 1e6 << " us, p99 "
+              << bench::percentile(samples, 99) * 1e6 << " us" << std::endl;
+}
+
+
+}  // anonymous namespace
+
+
+int main() {
+    const auto handler = [](const bench::Request &) {
+        return bench::Response{200, "{\"took\": 1, \"timed_out\": false, \"hits\": {\"hits\": []}}"};
+    };
+
+    {
+        bench::BenchServer server(handler);
+        run("loopback TCP", server.url());
+    }
+    {
+        const std::string path = "/tmp/elasticlient-bench-" + std::to_string(getpid()) + ".sock";
+        bench::BenchServer server(handler, path);
+        run("unix socket", server.url());
+    }
+    return 0;
+}
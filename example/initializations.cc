@@ -30,6 +30,8 @@ int main() {
             {"http://elastic1.host:9200/"},
             elasticlient::Client::TimeoutOption{30000},
             elasticlient::Client::ConnectTimeoutOption{1000},
+            elasticlient::Client::HTTP2Option{true},
+            elasticlient::Client::MaxConnectionsOption{4},
             sslOptions,
             elasticlient::Client::ProxiesOption(
                     {{"http", "http://proxy.host:8080"},
@@ -0,0 +1,119 @@
+/**
+ * \file
+ * Bulk loader of NDJSON files.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <chrono>
+#include <functional>
+#include "elasticlient/bulk.h"
+
+
+/// The elasticlient namespace
+namespace elasticlient {
+
+
+/**
+ * Loader of large NDJSON files into Elasticsearch. The file is memory-mapped and
+ * split into bulks of maxDocuments documents or maxBytes bytes, which are sent by
+ * parallel workers through Bulk. Documents are not validated nor copied one by one,
+ * each bulk body is built by copying whole lines out of the mapping.
+ */
+class BulkFileLoader {
+    class Implementation;
+    std::unique_ptr<Implementation> impl;
+
+  public:
+    /// Format of the input file.
+    enum class Format {
+        /// Each non-empty line is a document indexed with auto-generated ID.
+        DOCUMENTS,
+        /// File is bulk body - control lines, each one followed by source line
+        /// (except "delete" action).
+        BULK
+    };
+
+    /// Progress of the load.
+    struct Progress {
+        /// Number of documents sent so far.
+        std::size_t documents;
+        /// Number of documents failed to index so far.
+        std::size_t errors;
+        /// Number of bulk requests performed so far.
+        std::size_t bulks;
+        /// Number of bytes of the file sent so far.
+        std::size_t bytes;
+        /// Size of the file.
+        std::size_t totalBytes;
+        /// Time since start of the load.
+        std::chrono::milliseconds elapsed;
+
+        Progress()
+          : documents(0), errors(0), bulks(0), bytes(0), totalBytes(0), elapsed(0)
+        {}
+
+        /// Return throughput of the load in documents per second.
+        double documentsPerSecond() const {
+            return elapsed.count() ? documents * 1000.0 / elapsed.count() : 0;
+        }
+    };
+
+    /// Function called with progress of running load.
+    using ProgressCallback = std::function<void(const Progress &)>;
+
+    /// Batching and concurrency settings of the loader.
+    struct Settings {
+        /// Format of the input file.
+        Format format;
+        /// Document type of DOCUMENTS format.
+        std::string docType;
+        /// Maximal number of documents in one bulk.
+        std::size_t maxDocuments;
+        /// Maximal size of bulk body in bytes (at least one document is sent), 0 for no limit.
+        std::size_t maxBytes;
+        /// Number of workers, i.e. maximal number of concurrently running bulks.
+        std::size_t workers;
+        /// Retrying of failed items, applied by workers.
+        Bulk::RetryPolicy retryPolicy;
+        /// Called by workers at most once per progressInterval and after the load.
+        ProgressCallback progressCallback;
+        /// Minimal interval between progressCallback calls.
+        std::chrono::milliseconds progressInterval;
+
+        Settings()
+          : format(Format::DOCUMENTS), docType("_doc"), maxDocuments(1000),
+            maxBytes(5 * 1024 * 1024), workers(4), retryPolicy(), progressCallback(),
+            progressInterval(1000)
+        {}
+    };
+
+    /**
+     * Create loader sending bulks to \p indexName.
+     * \param client initialized Client object shared by all workers.
+     * \param indexName name of the index, may be empty for BULK format with index
+     *        in control lines.
+     * \param settings batching and concurrency settings.
+     * \throw std::runtime_error if index name is missing or settings are not valid.
+     */
+    BulkFileLoader(const std::shared_ptr<Client> &client,
+                   const std::string &indexName,
+                   const Settings &settings = Settings());
+
+    ~BulkFileLoader();
+
+    /**
+     * Send all documents of file at \p path and wait for the workers.
+     * \return final progress of the load.
+     * \throw std::runtime_error if the file can not be read.
+     */
+    Progress load(const std::string &path);
+
+    /// Return progress of running (or last) load, may be called from any thread.
+    Progress getProgress() const;
+};
+
+
+}  // namespace elasticlient
@@ -0,0 +1,100 @@
+/**
+ * \file
+ * Multi-buffered bulk sending for single producer thread.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include "elasticlient/bulk.h"
+
+
+/// The elasticlient namespace
+namespace elasticlient {
+
+
+/**
+ * Bulk sending which lets the producer fill next bulk while previous ones are on
+ * the wire. Documents are added to current() buffer directly (no locking per document),
+ * send() hands the buffer over to background sender and continues with free one,
+ * waiting only if all other buffers are still being sent. Sent buffers are cleared
+ * and reused with their allocated memory, so memory is bounded by number of buffers.
+ *
+ * Typical use:
+ * \code
+ * if (pipeline.current().indexDocument(docType, id, doc)) {
+ *     pipeline.send();
+ * }
+ * \endcode
+ * Producer methods (current(), send(), flush()) must be called from one thread.
+ */
+class BulkPipeline {
+    class Implementation;
+    std::unique_ptr<Implementation> impl;
+
+  public:
+    /// Buffering settings of the pipeline.
+    struct Settings {
+        /// Number of buffers (at least 2), one is filled while the others are sent.
+        std::size_t buffers;
+        /// Number of buffers sent concurrently, less than buffers.
+        std::size_t concurrentBulks;
+        /// Buffer capacity in documents, see SameIndexBulkData.
+        std::size_t maxDocuments;
+        /// Buffer capacity in bytes, 0 for no limit, see SameIndexBulkData.
+        std::size_t maxBytes;
+        /// Retrying of failed items, applied by sender threads.
+        Bulk::RetryPolicy retryPolicy;
+
+        Settings()
+          : buffers(2), concurrentBulks(1), maxDocuments(1000), maxBytes(5 * 1024 * 1024),
+            retryPolicy()
+        {}
+    };
+
+    /**
+     * Create pipeline sending bulks to \p indexName and start sender threads.
+     * \param client initialized Client object shared by all sender threads.
+     * \param indexName name of the index all documents will be send to.
+     * \param settings buffering settings.
+     */
+    BulkPipeline(const std::shared_ptr<Client> &client,
+                 const std::string &indexName,
+                 const Settings &settings = Settings());
+
+    /// Send all documents added so far and stop sender threads.
+    ~BulkPipeline();
+
+    /**
+     * Return buffer documents are added to. Its add methods return true when
+     * it is full, send() should be called then.
+     */
+    SameIndexBulkData &current();
+
+    /**
+     * Hand current buffer (unless empty) over to sender threads and continue with
+     * free buffer, wait for one if all are being sent.
+     */
+    void send();
+
+    /// Send current buffer and wait until all documents added so far are sent.
+    void flush();
+
+    /// Return number of documents sent (successfully or not) so far.
+    std::size_t getSentCount() const;
+
+    /// Return number of documents failed to index so far.
+    std::size_t getErrorCount() const;
+
+    /// Return number of bulks sent so far.
+    std::size_t getBulkCount() const;
+
+    /// Return time the producer waited for free buffer in send() so far.
+    std::chrono::microseconds getWaitTime() const;
+};
+
+
+}  // namespace elasticlient
@@ -0,0 +1,145 @@
+/**
+ * \file
+ * Background bulk indexer for Elasticsearch.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include "elasticlient/bulk.h"
+
+
+/// The elasticlient namespace
+namespace elasticlient {
+
+
+/**
+ * Bulk indexer collecting documents from many threads and sending them
+ * on background by Bulk API.
+ *
+ * Documents are collected into internal bulk which is handed over to sender
+ * threads when it reaches maxDocuments documents, maxBytes bytes or when its first
+ * document waits longer than linger interval. Full bulks wait for sender threads
+ * in queue of at most maxPendingBulks bulks; when the queue is full, add() blocks
+ * and tryAdd() refuses the document.
+ *
+ * Adaptive processor starts with bulks of minBytes sent one at a time. While bulks are
+ * processed within targetLatency, their size grows step by step up to maxBytes and then
+ * more of them are sent concurrently. Size is reduced when processing takes longer,
+ * both size and concurrency are halved when Elasticsearch rejects items (status 429).
+ */
+class BulkProcessor {
+    class Implementation;
+    std::unique_ptr<Implementation> impl;
+
+  public:
+    /// Bulk action to be performed with the document.
+    enum class Action {
+        INDEX,
+        CREATE,
+        UPDATE,
+        /// Delete document by its ID, doc is ignored.
+        DELETE
+    };
+
+    /// Flushing and concurrency settings of the BulkProcessor.
+    struct Settings {
+        /// Flush bulk when it contains this number of documents.
+        std::size_t maxDocuments;
+        /// Flush bulk when its body reaches this number of bytes, 0 for no limit.
+        std::size_t maxBytes;
+        /// Flush bulk when its first document waits this long, zero for no limit.
+        std::chrono::milliseconds linger;
+        /// Number of sender threads, i.e. maximal number of concurrently running bulks.
+        std::size_t concurrentBulks;
+        /// Maximal number of full bulks waiting for sender thread.
+        std::size_t maxPendingBulks;
+        /// Retrying of failed items, applied by sender threads.
+        Bulk::RetryPolicy retryPolicy;
+        /**
+         * Adapt bulk size (from minBytes up to maxBytes) and number of concurrently
+         * sent bulks (up to concurrentBulks) to load of the cluster, see getTargetBytes().
+         */
+        bool adaptive;
+        /// Lower limit of adaptive bulk size in bytes.
+        std::size_t minBytes;
+        /// Processing time of one bulk ("took") above which adaptive bulk size shrinks.
+        std::chrono::milliseconds targetLatency;
+
+        Settings()
+          : maxDocuments(1000), maxBytes(5 * 1024 * 1024), linger(1000),
+            concurrentBulks(1), maxPendingBulks(1), retryPolicy(), adaptive(false),
+            minBytes(256 * 1024), targetLatency(500)
+        {}
+    };
+
+    /**
+     * Create processor sending bulks to \p indexName and start sender threads.
+     * \param client initialized Client object shared by all sender threads.
+     * \param indexName name of the index all documents will be send to.
+     * \param settings flushing and concurrency settings.
+     */
+    BulkProcessor(const std::shared_ptr<Client> &client,
+                  const std::string &indexName,
+                  const Settings &settings = Settings());
+
+    /// Send all documents added so far and stop sender threads, \see close().
+    ~BulkProcessor();
+
+    /**
+     * Add document to the bulk, wait while queue of full bulks is full.
+     * \param docType document type (as specified in mapping).
+     * \param id document ID, for auto-generated ID use empty string.
+     * \param doc Json document. Must not contain newline char. Ignored for delete action.
+     * \param action bulk action to be performed with the document.
+     * \throw std::runtime_error if processor is closed or document is not valid.
+     */
+    void add(const std::string &docType,
+             const std::string &id,
+             const std::string &doc,
+             Action action = Action::INDEX);
+
+    /**
+     * Add document to the bulk if it can be done without waiting.
+     * \see add()
+     * \return true if document has been added.
+     * \return false if queue of full bulks is full.
+     */
+    bool tryAdd(const std::string &docType,
+                const std::string &id,
+                const std::string &doc,
+                Action action = Action::INDEX);
+
+    /**
+     * Hand current bulk over to sender threads and wait until all documents
+     * added so far are sent.
+     */
+    void flush();
+
+    /**
+     * Flush and stop sender threads. Documents can not be added after close.
+     * Calling close() more times is allowed.
+     */
+    void close();
+
+    /// Return number of documents sent (successfully or not) so far.
+    std::size_t getSentCount() const;
+
+    /// Return number of documents failed to index so far.
+    std::size_t getErrorCount() const;
+
+    /// Return number of bulk requests performed so far.
+    std::size_t getBulkCount() const;
+
+    /// Return current bulk size limit in bytes (maxBytes unless adaptive).
+    std::size_t getTargetBytes() const;
+
+    /// Return current number of concurrently sent bulks (concurrentBulks unless adaptive).
+    std::size_t getTargetConcurrency() const;
+};
+
+
+}  // namespace elasticlient
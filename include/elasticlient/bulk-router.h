@@ -0,0 +1,98 @@
+/**
+ * \file
+ * Client-side shard routing of bulk items.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+
+/// The elasticlient namespace
+namespace elasticlient {
+
+
+// Forward Client class existence.
+class Client;
+
+
+/**
+ * Router computing target shard of bulk items the same way as Elasticsearch does
+ * (murmur3 hash of routing value or document ID). Mixed bulk touches every primary
+ * shard, so it waits for the slowest one; Bulk::performRouted() splits it into
+ * bulks of single shard or single node by the router instead.
+ *
+ * Shard counts and primary shard locations of indices are read from cluster state
+ * on first use and cached for refreshInterval. Items of indices whose routing can
+ * not be read (e.g. index does not exist yet) and items with auto-generated ID are
+ * sent as usual. The router is thread safe and can be shared by more Bulk objects.
+ */
+class BulkShardRouter {
+    class Implementation;
+    std::unique_ptr<Implementation> impl;
+
+    friend class Bulk;
+
+  public:
+    /// How items are grouped into bulks.
+    enum class Grouping {
+        /// Bulk per primary shard, sent by Client of the Bulk.
+        SHARD,
+        /**
+         * Bulk per node holding primary shards, sent directly to the node by Client
+         * created by Settings::nodeClientFactory.
+         */
+        NODE
+    };
+
+    /// Settings of the router.
+    struct Settings {
+        /// Grouping of items into bulks (SHARD by default).
+        Grouping grouping;
+        /// Cached routing of index (and node addresses) are read again after this time.
+        std::chrono::seconds refreshInterval;
+        /**
+         * Create Client sending requests to node at \p nodeUrl (NODE grouping only).
+         * By default Client with default options is created, so set the factory
+         * to pass the authentication, TLS and timeout options of the cluster.
+         * Items of node which does not respond are sent by Client of the Bulk.
+         */
+        std::function<std::shared_ptr<Client>(const std::string &nodeUrl)> nodeClientFactory;
+        /// Scheme of node URLs built from addresses published by nodes.
+        std::string nodeScheme;
+
+        Settings()
+          : grouping(Grouping::SHARD), refreshInterval(300), nodeClientFactory(),
+            nodeScheme("http")
+        {}
+    };
+
+    /**
+     * Create router reading cluster state by \p client.
+     * \param client initialized Client object.
+     * \param settings grouping and caching settings.
+     */
+    explicit BulkShardRouter(const std::shared_ptr<Client> &client,
+                             const Settings &settings = Settings());
+
+    ~BulkShardRouter();
+
+    /**
+     * Return shard of index \p indexName document \p id is stored in.
+     * \param routing routing value of the document, empty if ID is used for routing.
+     * \throw std::runtime_error if routing of the index can not be read.
+     */
+    std::uint32_t shardOf(const std::string &indexName,
+                          const std::string &id,
+                          const std::string &routing = std::string());
+
+    /// Drop cached routing of all indices and node addresses.
+    void invalidate();
+};
+
+
+}  // namespace elasticlient
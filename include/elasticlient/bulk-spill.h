@@ -0,0 +1,87 @@
+/**
+ * \file
+ * Disk-backed queue of bulks which could not be sent to Elasticsearch.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "elasticlient/bulk.h"
+
+
+/// The elasticlient namespace
+namespace elasticlient {
+
+
+/**
+ * Write-ahead spill of bulks for the time the cluster is unavailable. Bulk with
+ * attached queue (see Bulk::setSpillQueue()) appends items it could not send because
+ * all hosts failed to the queue instead of counting them as errors. Bulks are stored
+ * in segment files in given directory by sequential appends, synced to disk after
+ * each syncBytes. Spilled bulks are sent again in order by replay().
+ *
+ * Segments left by previous process are replayed as well. Replay is at least once -
+ * bulks of segment which was replayed partially before crash are sent again.
+ * The queue is thread safe.
+ */
+class BulkSpillQueue {
+    class Implementation;
+    std::unique_ptr<Implementation> impl;
+
+  public:
+    /// Settings of the queue.
+    struct Settings {
+        /// Start new segment file when current one reaches this size.
+        std::size_t segmentBytes;
+        /// Sync segment to disk after this number of appended bytes, 0 syncs each bulk.
+        std::size_t syncBytes;
+        /// Maximal size of all segments, bulks above it are refused, 0 for no limit.
+        std::size_t maxBytes;
+
+        Settings()
+          : segmentBytes(64 * 1024 * 1024), syncBytes(1024 * 1024), maxBytes(0)
+        {}
+    };
+
+    /**
+     * Open queue in \p directory (must exist), existing segments are kept for replay.
+     * \throw std::runtime_error if directory can not be read.
+     */
+    explicit BulkSpillQueue(const std::string &directory, const Settings &settings = Settings());
+
+    /// Sync and close current segment.
+    ~BulkSpillQueue();
+
+    /**
+     * Append serialized bulk \p body of \p size items to be sent to \p urlPath.
+     * \return false if the bulk does not fit into maxBytes or can not be written.
+     */
+    bool append(const std::string &urlPath, const std::string &body, std::size_t size);
+
+    /// Sync all appended bulks to disk.
+    void sync();
+
+    /// Return true if there is no bulk to replay.
+    bool empty() const;
+
+    /// Return number of bulks waiting for replay.
+    std::size_t size() const;
+
+    /// Return size of all segments in bytes.
+    std::size_t byteSize() const;
+
+    /**
+     * Send spilled bulks in order by \p bulk (retried by its RetryPolicy, errors
+     * counted to its getErrorCount()), at most \p maxBulksPerSecond of them (0 for no
+     * limit). Replay stops at first bulk which can not be sent, because the cluster
+     * is still unavailable; the bulk is kept for next replay. Fully replayed
+     * segments are removed.
+     * \return number of replayed bulks.
+     */
+    std::size_t replay(Bulk &bulk, double maxBulksPerSecond = 0);
+};
+
+
+}  // namespace elasticlient
@@ -9,14 +9,31 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <chrono>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+
+// Forward Json::Value
+namespace Json {
+    class Value;
+}
 
 
 /// The elasticlient namespace
 namespace elasticlient {
 
 
-// Forward Client class existence.
+// Forward Client, ConnectionShare classes and RequestPriority enum existence.
 class Client;
+class ConnectionShare;
+enum class RequestPriority: int;
+
+
+class BulkSpillQueue;
+class BulkFileLoader;
+class BulkShardRouter;
 
 
 /// Interface for Bulk data collector classes.
@@ -41,10 +58,91 @@ class IBulkData {
 };
 
 
+/**
+ * Interface for producers of bulk data serialized item by item while the bulk
+ * is being sent, see Bulk::perform(IBulkDataProducer &).
+ */
+class IBulkDataProducer {
+  public:
+    virtual ~IBulkDataProducer();
+
+    /**
+     * Return index name bulk data belongs to.
+     * Empty string if data could have different index names.
+     */
+    virtual std::string indexName() const = 0;
+
+    /**
+     * Append next bulk item - control line and optional source line, both terminated
+     * by newline - to \p out.
+     * \return false if there are no more items (nothing is appended then).
+     */
+    virtual bool next(std::string &out) = 0;
+};
+
+
+/**
+ * Optional metadata of one bulk item, written into its control line. Empty strings
+ * and negative numbers are omitted.
+ */
+struct BulkItemMetadata {
+    /// Routing value, the item is sent only to the shard the value routes to.
+    std::string routing;
+    /// Document version.
+    std::int64_t version;
+    /// Version type ("external", "external_gte"), empty for internal versioning.
+    std::string versionType;
+    /// Perform the action only if last modification has this sequence number.
+    std::int64_t ifSeqNo;
+    /// Perform the action only if last modification has this primary term.
+    std::int64_t ifPrimaryTerm;
+    /// Ingest pipeline to preprocess the document with.
+    std::string pipeline;
+
+    BulkItemMetadata()
+      : routing(), version(-1), versionType(), ifSeqNo(-1), ifPrimaryTerm(-1), pipeline()
+    {}
+};
+
+
+/**
+ * Document text passed to bulk data collectors without copying it into std::string.
+ * The text is serialized into the bulk buffer during the call, so it needs to be
+ * valid only until the call returns. With C++17 it is created from std::string_view.
+ */
+struct DocumentView {
+    /// First byte of the document.
+    const char *data;
+    /// Length of the document in bytes.
+    std::size_t length;
+
+    DocumentView(const char *data, std::size_t length): data(data), length(length) {}
+
+#if __cplusplus >= 201703L
+    DocumentView(std::string_view doc): data(doc.data()), length(doc.size()) {}
+#endif
+};
+
+
+/**
+ * Parsed document passed to bulk data collectors. It is serialized compactly
+ * straight into the bulk buffer, the same way as Json::FastWriter would do,
+ * without building intermediate std::string. Wraps the Json::Value so that
+ * string literals keep selecting the std::string overloads.
+ */
+struct JsonDocument {
+    /// The document, needs to be valid only until the call returns.
+    const Json::Value &value;
+
+    JsonDocument(const Json::Value &value): value(value) {}
+};
+
+
 /**
  * Data collector for the bulk operation. All bulk data must be
  * determined to be send to same index.
- * Class produces document body for elasticsearch /_bulk request.
+ * Class produces document body for elasticsearch /_bulk request. Documents
+ * are serialized as they are added into one buffer reused after clear().
  */
 class SameIndexBulkData: public IBulkData {
     class Implementation;
@@ -58,6 +156,17 @@ class SameIndexBulkData: public IBulkData {
      * \param indexName  Name of the index all data will be send to.
      */
     explicit SameIndexBulkData(const std::string &indexName, std::size_t size = 100);
+
+    /**
+     * Create Bulk data collector with desired size and desired body size.
+     * Bulk reaches its capacity when it contains \p size documents or when
+     * its body() is at least \p maxBytes long. Neither is limiting the client
+     * to insert more elements into bulk.
+     * \param indexName  Name of the index all data will be send to.
+     * \param size desired number of documents.
+     * \param maxBytes desired size of body() in bytes, 0 for no limit.
+     */
+    SameIndexBulkData(const std::string &indexName, std::size_t size, std::size_t maxBytes);
     ~SameIndexBulkData();
 
     /// Return index name set during contruction.
@@ -79,7 +188,8 @@ class SameIndexBulkData: public IBulkData {
      * \param docType document type (as specified in mapping).
      * \param id document ID, for auto-generated ID use empty string.
      * \param doc Json document to index. Must not contain newline char.
-     * \param validate checks whether string contains a newline.
+     * \param validate checks whether string contains a newline, invalid UTF-8
+     *        or unbalanced JSON.
      * \return true if bulk has reached its desired capacity.
      * \todo Merge with indexDocument() above with validate=true when ABI breaks.
      */
@@ -104,7 +214,8 @@ class SameIndexBulkData: public IBulkData {
      * \param docType document type (as specified in mapping).
      * \param id document ID, for auto-generated ID use empty string.
      * \param doc Json document to index. Must not contain newline char.
-     * \param validate checks whether string contains a newline.
+     * \param validate checks whether string contains a newline, invalid UTF-8
+     *        or unbalanced JSON.
      * \return true if bulk has reached its desired capacity.
      * \todo Merge with createDocument() above with validate=true when ABI breaks.
      */
@@ -130,7 +241,8 @@ class SameIndexBulkData: public IBulkData {
      * \param docType document type (as specified in mapping).
      * \param id document ID, for auto-generated ID use empty string.
      * \param doc Json document to index. Must not contain newline char.
-     * \param validate checks whether string contains a newline.
+     * \param validate checks whether string contains a newline, invalid UTF-8
+     *        or unbalanced JSON.
      * \return true if bulk has reached its desired capacity.
      * \todo Merge with updateDocument() above with validate=true when ABI breaks.
      */
@@ -140,6 +252,180 @@ class SameIndexBulkData: public IBulkData {
             const std::string &doc,
             bool validate);
 
+    /**
+     * Add delete document request to the bulk. Deleting of missing document
+     * (status 404) is not counted as failure.
+     * \param docType document type (as specified in mapping).
+     * \param id ID of the document to delete, must not be empty.
+     * \return true if bulk has reached its desired capacity.
+     */
+    bool deleteDocument(const std::string &docType, const std::string &id);
+
+    /**
+     * Add index document request with item \p metadata to the bulk.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &docType,
+                       const std::string &id,
+                       const std::string &doc,
+                       const BulkItemMetadata &metadata,
+                       bool validate = true);
+
+    /**
+     * Add create document request with item \p metadata to the bulk.
+     * \see createDocument()
+     */
+    bool createDocument(const std::string &docType,
+                        const std::string &id,
+                        const std::string &doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add update document request with item \p metadata to the bulk.
+     * \see updateDocument()
+     */
+    bool updateDocument(const std::string &docType,
+                        const std::string &id,
+                        const std::string &doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add delete document request with item \p metadata to the bulk.
+     * \see deleteDocument()
+     */
+    bool deleteDocument(const std::string &docType,
+                        const std::string &id,
+                        const BulkItemMetadata &metadata);
+
+    /**
+     * Add index document request to the bulk, serializing \p doc without copying
+     * it into std::string first.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &docType,
+                       const std::string &id,
+                       DocumentView doc,
+                       bool validate = true);
+
+    /**
+     * Add create document request to the bulk without copying \p doc.
+     * \see createDocument()
+     */
+    bool createDocument(const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        bool validate = true);
+
+    /**
+     * Add update document request to the bulk without copying \p doc.
+     * \see updateDocument()
+     */
+    bool updateDocument(const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        bool validate = true);
+
+    /**
+     * Add index document request with item \p metadata to the bulk without copying \p doc.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &docType,
+                       const std::string &id,
+                       DocumentView doc,
+                       const BulkItemMetadata &metadata,
+                       bool validate = true);
+
+    /**
+     * Add create document request with item \p metadata to the bulk without copying \p doc.
+     * \see createDocument()
+     */
+    bool createDocument(const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add update document request with item \p metadata to the bulk without copying \p doc.
+     * \see updateDocument()
+     */
+    bool updateDocument(const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add index document request to the bulk, serializing parsed \p doc straight
+     * into the bulk buffer. Serialized document is always valid, no validation is done.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &docType,
+                       const std::string &id,
+                       JsonDocument doc);
+
+    /**
+     * Add create document request to the bulk, serializing parsed \p doc.
+     * \see createDocument()
+     */
+    bool createDocument(const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc);
+
+    /**
+     * Add update document request to the bulk, serializing parsed \p doc.
+     * \see updateDocument()
+     */
+    bool updateDocument(const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc);
+
+    /**
+     * Add index document request with item \p metadata to the bulk, serializing parsed \p doc.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &docType,
+                       const std::string &id,
+                       JsonDocument doc,
+                       const BulkItemMetadata &metadata);
+
+    /**
+     * Add create document request with item \p metadata to the bulk, serializing parsed \p doc.
+     * \see createDocument()
+     */
+    bool createDocument(const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc,
+                        const BulkItemMetadata &metadata);
+
+    /**
+     * Add update document request with item \p metadata to the bulk, serializing parsed \p doc.
+     * \see updateDocument()
+     */
+    bool updateDocument(const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc,
+                        const BulkItemMetadata &metadata);
+
+    /**
+     * Enable coalescing of items of the same document (index, type and ID) added
+     * from now on. Index action drops previous index or update of the document,
+     * update by partial document ({"doc": {...}}) is merged into previous partial
+     * update or index of the document. Create and delete actions and items with
+     * metadata are never coalesced. Disabled by default. Items of the sent bulk are
+     * the size() items left after coalescing, positions in BulkResult refer to them
+     * rather than to the order of add calls.
+     */
+    void setCoalescing(bool enabled);
+
+    /// Return number of items dropped by coalescing since creation of the bulk.
+    std::size_t getDroppedCount() const;
+
+    /// Return number of items merged by coalescing since creation of the bulk.
+    std::size_t getMergedCount() const;
+
     /// Clear bulk (size() == 0 after this).
     void clear();
 
@@ -149,8 +435,351 @@ class SameIndexBulkData: public IBulkData {
     /// Return number of documents inside the bulk.
     virtual std::size_t size() const override;
 
+    /// Return exact size of body() in bytes, including control lines and newlines.
+    std::size_t byteSize() const;
+
     /// Return elasticsearch bulk request data.
     virtual std::string body() const override;
+
+    /**
+     * Return elasticsearch bulk request data without copying it.
+     * Reference is valid until next modification of the bulk. The bulk may be
+     * read (and sent) by more threads at once.
+     */
+    const std::string &bodyBuffer() const;
+};
+
+
+/**
+ * Data collector for the bulk operation with documents of more indices.
+ * Index of each document is written into its control line and the bulk is sent
+ * to /_bulk endpoint, so one request can carry documents for many indices.
+ * Documents are serialized as they are added into one buffer reused after clear().
+ */
+class MultiIndexBulkData: public IBulkData {
+    class Implementation;
+    std::unique_ptr<Implementation> impl;
+
+  public:
+    /**
+     * Create Bulk data collector with desired size and desired body size.
+     * Bulk reaches its capacity when it contains \p size documents or when
+     * its body() is at least \p maxBytes long. Neither is limiting the client
+     * to insert more elements into bulk.
+     * \param size desired number of documents.
+     * \param maxBytes desired size of body() in bytes, 0 for no limit.
+     */
+    explicit MultiIndexBulkData(std::size_t size = 100, std::size_t maxBytes = 0);
+    ~MultiIndexBulkData();
+
+    /// Return empty string, documents may belong to different indices.
+    virtual std::string indexName() const override;
+
+    /**
+     * Add index document request to the bulk.
+     * \param indexName name of the index the document belongs to.
+     * \param docType document type (as specified in mapping).
+     * \param id document ID, for auto-generated ID use empty string.
+     * \param doc Json document to index. Must not contain newline char.
+     * \param validate checks whether string contains a newline, invalid UTF-8
+     *        or unbalanced JSON.
+     * \return true if bulk has reached its desired capacity.
+     */
+    bool indexDocument(const std::string &indexName,
+                       const std::string &docType,
+                       const std::string &id,
+                       const std::string &doc,
+                       bool validate = true);
+
+    /**
+     * Add create document request to the bulk.
+     * \see indexDocument()
+     */
+    bool createDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        const std::string &doc,
+                        bool validate = true);
+
+    /**
+     * Add update document request to the bulk.
+     * \see indexDocument()
+     */
+    bool updateDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        const std::string &doc,
+                        bool validate = true);
+
+    /**
+     * Add delete document request to the bulk. Deleting of missing document
+     * (status 404) is not counted as failure.
+     * \param indexName name of the index the document belongs to.
+     * \param docType document type (as specified in mapping).
+     * \param id ID of the document to delete, must not be empty.
+     * \return true if bulk has reached its desired capacity.
+     */
+    bool deleteDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id);
+
+    /**
+     * Add index document request with item \p metadata to the bulk.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &indexName,
+                       const std::string &docType,
+                       const std::string &id,
+                       const std::string &doc,
+                       const BulkItemMetadata &metadata,
+                       bool validate = true);
+
+    /**
+     * Add create document request with item \p metadata to the bulk.
+     * \see indexDocument()
+     */
+    bool createDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        const std::string &doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add update document request with item \p metadata to the bulk.
+     * \see indexDocument()
+     */
+    bool updateDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        const std::string &doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add delete document request with item \p metadata to the bulk.
+     * \see deleteDocument()
+     */
+    bool deleteDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        const BulkItemMetadata &metadata);
+
+    /**
+     * Add index document request to the bulk, serializing \p doc without copying
+     * it into std::string first.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &indexName,
+                       const std::string &docType,
+                       const std::string &id,
+                       DocumentView doc,
+                       bool validate = true);
+
+    /**
+     * Add create document request to the bulk without copying \p doc.
+     * \see indexDocument()
+     */
+    bool createDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        bool validate = true);
+
+    /**
+     * Add update document request to the bulk without copying \p doc.
+     * \see indexDocument()
+     */
+    bool updateDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        bool validate = true);
+
+    /**
+     * Add index document request with item \p metadata to the bulk without copying \p doc.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &indexName,
+                       const std::string &docType,
+                       const std::string &id,
+                       DocumentView doc,
+                       const BulkItemMetadata &metadata,
+                       bool validate = true);
+
+    /**
+     * Add create document request with item \p metadata to the bulk without copying \p doc.
+     * \see indexDocument()
+     */
+    bool createDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add update document request with item \p metadata to the bulk without copying \p doc.
+     * \see indexDocument()
+     */
+    bool updateDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        DocumentView doc,
+                        const BulkItemMetadata &metadata,
+                        bool validate = true);
+
+    /**
+     * Add index document request to the bulk, serializing parsed \p doc straight
+     * into the bulk buffer. Serialized document is always valid, no validation is done.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &indexName,
+                       const std::string &docType,
+                       const std::string &id,
+                       JsonDocument doc);
+
+    /**
+     * Add create document request to the bulk, serializing parsed \p doc.
+     * \see indexDocument()
+     */
+    bool createDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc);
+
+    /**
+     * Add update document request to the bulk, serializing parsed \p doc.
+     * \see indexDocument()
+     */
+    bool updateDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc);
+
+    /**
+     * Add index document request with item \p metadata to the bulk, serializing parsed \p doc.
+     * \see indexDocument()
+     */
+    bool indexDocument(const std::string &indexName,
+                       const std::string &docType,
+                       const std::string &id,
+                       JsonDocument doc,
+                       const BulkItemMetadata &metadata);
+
+    /**
+     * Add create document request with item \p metadata to the bulk, serializing parsed \p doc.
+     * \see indexDocument()
+     */
+    bool createDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc,
+                        const BulkItemMetadata &metadata);
+
+    /**
+     * Add update document request with item \p metadata to the bulk, serializing parsed \p doc.
+     * \see indexDocument()
+     */
+    bool updateDocument(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        JsonDocument doc,
+                        const BulkItemMetadata &metadata);
+
+    /**
+     * Enable coalescing of items of the same document (index, type and ID) added
+     * from now on. Index action drops previous index or update of the document,
+     * update by partial document ({"doc": {...}}) is merged into previous partial
+     * update or index of the document. Create and delete actions and items with
+     * metadata are never coalesced. Disabled by default. Items of the sent bulk are
+     * the size() items left after coalescing, positions in BulkResult refer to them
+     * rather than to the order of add calls.
+     */
+    void setCoalescing(bool enabled);
+
+    /// Return number of items dropped by coalescing since creation of the bulk.
+    std::size_t getDroppedCount() const;
+
+    /// Return number of items merged by coalescing since creation of the bulk.
+    std::size_t getMergedCount() const;
+
+    /// Clear bulk (size() == 0 after this).
+    void clear();
+
+    /// Return true if bulk has no data inside.
+    virtual bool empty() const override;
+
+    /// Return number of documents inside the bulk.
+    virtual std::size_t size() const override;
+
+    /// Return exact size of body() in bytes, including control lines and newlines.
+    std::size_t byteSize() const;
+
+    /// Return elasticsearch bulk request data.
+    virtual std::string body() const override;
+
+    /**
+     * Return elasticsearch bulk request data without copying it.
+     * Reference is valid until next modification of the bulk. The bulk may be
+     * read (and sent) by more threads at once.
+     */
+    const std::string &bodyBuffer() const;
+};
+
+
+/**
+ * Results of items of one bulk, in the same order as the items were added
+ * (items left after coalescing, see SameIndexBulkData::setCoalescing()).
+ * Strings of all items are kept in one buffer and error types are interned,
+ * so the result takes a fraction of the memory of parsed Elasticsearch response.
+ */
+class BulkResult {
+    class Implementation;
+    std::unique_ptr<Implementation> impl;
+
+    friend class Bulk;
+
+  public:
+    /// Bulk action of the item.
+    enum class Action {
+        UNKNOWN,
+        INDEX,
+        CREATE,
+        UPDATE,
+        DELETE
+    };
+
+    BulkResult();
+    BulkResult(const BulkResult &other);
+    BulkResult(BulkResult &&other);
+    BulkResult &operator=(const BulkResult &other);
+    BulkResult &operator=(BulkResult &&other);
+    ~BulkResult();
+
+    /// Return number of items.
+    std::size_t size() const;
+
+    /// Return number of failed items.
+    std::size_t errorCount() const;
+
+    /// Return action of \p item, UNKNOWN if item has no response.
+    Action action(std::size_t item) const;
+
+    /// Return document ID of \p item.
+    std::string id(std::size_t item) const;
+
+    /// Return HTTP status of \p item, 0 if item has no response.
+    int status(std::size_t item) const;
+
+    /// Return true if \p item has not succeeded (status is not 2xx, nor 404 of delete).
+    bool failed(std::size_t item) const;
+
+    /// Return Elasticsearch error type of \p item, empty string for no error.
+    const std::string &errorType(std::size_t item) const;
+
+    /// Return Elasticsearch error reason of \p item, empty string for no error.
+    std::string errorReason(std::size_t item) const;
 };
 
 
@@ -159,7 +788,55 @@ class Bulk {
     class Implementation;
     std::unique_ptr<Implementation> impl;
 
+    friend class BulkSpillQueue;
+    friend class BulkFileLoader;
+
   public:
+    /**
+     * Retrying of failed bulk items. Items rejected by Elasticsearch with status 429
+     * (too many requests) or 503 (unavailable), optionally also 409 (version conflict),
+     * are sent again in smaller follow-up bulk after jittered exponential backoff.
+     * Whole bulk is sent again if request itself was rejected with such status.
+     */
+    struct RetryPolicy {
+        /// Maximal number of attempts to send an item, 1 for no retries.
+        std::size_t maxAttempts;
+        /// Backoff before first retry, doubled for each next one.
+        std::chrono::milliseconds initialBackoff;
+        /// Maximal backoff between retries.
+        std::chrono::milliseconds maxBackoff;
+        /// Retry also items failed on version conflict.
+        bool retryConflicts;
+
+        RetryPolicy()
+          : maxAttempts(1), initialBackoff(100), maxBackoff(10000), retryConflicts(false)
+        {}
+    };
+
+    /// Bulk item which failed permanently.
+    struct FailedItem {
+        /// Serialized item (control and source line), empty for streamed bulks.
+        std::string item;
+        /// HTTP status of the item or of the failed request, 0 if no host has responded.
+        int status;
+        /// Elasticsearch error type (e.g. "mapper_parsing_exception"), may be empty.
+        std::string errorType;
+    };
+
+    /// Statistics of requests of last bulk being ran.
+    struct Statistics {
+        /// Number of bulk requests sent, including retries.
+        std::size_t requests;
+        /// Sum of processing time reported by Elasticsearch ("took").
+        std::chrono::milliseconds took;
+        /// Number of items rejected with status 429, including whole rejected requests.
+        std::size_t rejectedItems;
+        /// Number of items appended to spill queue, see setSpillQueue().
+        std::size_t spilledItems;
+
+        Statistics(): requests(0), took(0), rejectedItems(0), spilledItems(0) {}
+    };
+
     /**
      * Initialize bulk indexer, using already configured Client class.
      * \param client initialized Client object.
@@ -174,6 +851,17 @@ class Bulk {
      */
     Bulk(const std::vector<std::string> &hostUrlList,
          std::int32_t connectionTimeout);
+
+    /**
+     * Initialize bulk indexer and creates Client instance for specified
+     * hostUrlList and connectionTimeout attached to the \p connectionShare.
+     * \param hostUrlList list of URLs of Elastic nodes in one cluster.
+     * \param connectionTimeout Elasticsearch node connection timeout.
+     * \param connectionShare shared DNS, TLS session and connection caches.
+     */
+    Bulk(const std::vector<std::string> &hostUrlList,
+         std::int32_t connectionTimeout,
+         const std::shared_ptr<ConnectionShare> &connectionShare);
     /**
      * Destroy bulk indexer, writing documents not yet indexed, discarding
      * possible errors. If you are interested in errors, call flush() and
@@ -184,14 +872,86 @@ class Bulk {
     Bulk(Bulk &&other);
 
     /**
-     * Run the bulk.
+     * Run the bulk, retrying failed items according to RetryPolicy.
      * \return Number of errors occured.
      */
     std::size_t perform(const IBulkData &bulk);
 
+    /**
+     * Run the bulk with items pulled from \p producer as they are being sent
+     * (chunked transfer encoding), so the whole bulk body is never in memory.
+     * Items of streamed bulk are not retried. When the request fails, items not sent
+     * yet are pulled from \p producer as well and all of them are counted as failed.
+     * \return Number of errors occured.
+     */
+    std::size_t perform(IBulkDataProducer &producer);
+
+    /**
+     * Split \p bulk into sub-bulks of at most \p subBulkSize items and send them
+     * concurrently, see setParallelism(). Each sub-bulk is retried independently
+     * and errors of all of them are counted together; getFailedItems() and
+     * getResult() cover the whole bulk. Items in getResult() follow in order of
+     * the bulk, getFailedItems() are grouped by sub-bulks in order of their completion.
+     * \return Number of errors occured.
+     */
+    std::size_t performParallel(const IBulkData &bulk, std::size_t subBulkSize);
+
+    /**
+     * Send \p bulks concurrently, see setParallelism() and
+     * performParallel(const IBulkData &, std::size_t). Items in getResult() follow
+     * in order of the bulks.
+     * \return Number of errors occured in all bulks.
+     */
+    std::size_t performParallel(const std::vector<const IBulkData *> &bulks);
+
+    /**
+     * Split \p bulk into bulks of items of single primary shard or single node
+     * by \p router and send them concurrently, see setParallelism() and
+     * BulkShardRouter. Errors of all of them are counted together, getFailedItems()
+     * and getResult() cover the whole bulk. Items in getResult() follow in order of
+     * the bulk, getFailedItems() are grouped by sent bulks in order of their completion.
+     * \return Number of errors occured.
+     */
+    std::size_t performRouted(const IBulkData &bulk, BulkShardRouter &router);
+
     /// Return number of errors in last bulk being ran.
     std::size_t getErrorCount() const;
 
+    /// Return statistics of requests of last bulk being ran.
+    const Statistics &getStatistics() const;
+
+    /// Return items of last bulk being ran which failed even after retries.
+    const std::vector<FailedItem> &getFailedItems() const;
+
+    /// Set retrying of failed items (no retries by default).
+    void setRetryPolicy(const RetryPolicy &policy);
+
+    /**
+     * Set collection of results of all items into getResult() (disabled by default).
+     * Successful bulk responses have to be fully read when enabled.
+     */
+    void setResultCollection(bool enabled);
+
+    /// Return results of items of last bulk being ran, empty if collection is disabled.
+    const BulkResult &getResult() const;
+
+    /**
+     * Set maximal number of bulk requests sent concurrently by performParallel()
+     * (1 by default). Use Client::LoadBalancingOption to spread them over all nodes
+     * and Client::MaxConnectionsOption to limit connections of the whole Client.
+     */
+    void setParallelism(std::size_t parallelism);
+
+    /**
+     * Set queue the items are appended to when they can not be sent because all hosts
+     * failed (none by default). Spilled items are not counted as errors, see
+     * Statistics::spilledItems and BulkSpillQueue::replay().
+     */
+    void setSpillQueue(const std::shared_ptr<BulkSpillQueue> &queue);
+
+    /// Set priority of bulk requests (RequestPriority::LOW by default).
+    void setRequestPriority(RequestPriority priority);
+
     /// Return Client class with current config.
     const std::shared_ptr<Client> &getClient() const;
 
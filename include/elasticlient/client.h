@@ -13,6 +13,7 @@
 #include <utility>
 #include <initializer_list>
 #include <type_traits>
+#include <functional>
 
 
 // Forward cpr::Response existence.
@@ -31,6 +32,50 @@ class ConnectionException: public std::runtime_error {
 };
 
 
+/**
+ * State shared between Client instances - DNS cache, TLS session IDs and optionally
+ * the connection cache. Clients attached to the same share reuse resolved names,
+ * resume TLS sessions and (if enabled) warm connections of each other, so short-lived
+ * Client, Bulk and Scroll objects do not pay for new handshakes.
+ * Instance is thread-safe and may be attached to any number of Clients.
+ */
+class ConnectionShare {
+    class Implementation;
+    /// Hidden implementation and data holder.
+    std::unique_ptr<Implementation> impl;
+
+    friend class Client;
+
+  public:
+    /**
+     * Create new shared state.
+     * \param shareConnections share also the connection cache. libcurl does not support
+     *        shared connection cache to be used by concurrently running threads, so enable
+     *        it only if Clients attached to the share perform requests one at a time.
+     */
+    explicit ConnectionShare(bool shareConnections = false);
+    ~ConnectionShare();
+
+    ConnectionShare(const ConnectionShare &) = delete;
+    ConnectionShare &operator=(const ConnectionShare &) = delete;
+
+    /// Return true if the connection cache is shared.
+    bool sharesConnections() const;
+};
+
+
+/**
+ * Priority classes of requests. When number of connections is limited
+ * (see Client::MaxConnectionsOption), waiting requests of higher priority are performed
+ * before the waiting requests of lower priority. Bulk and Scroll use LOW priority.
+ */
+enum class RequestPriority: int {
+    LOW     = 0,
+    NORMAL  = 1,
+    HIGH    = 2
+};
+
+
 /// Class for managing Elasticsearch connection in one Elasticsearch cluster
 class Client {
     class Implementation;
@@ -47,6 +92,15 @@ class Client {
         HEAD    = 4
     };
 
+    /// Priority classes of requests, see elasticlient::RequestPriority.
+    typedef elasticlient::RequestPriority RequestPriority;
+
+    /**
+     * Producer of streamed request body. Appends next part of the body to the given
+     * buffer, returns false when the body is complete (nothing more is appended then).
+     */
+    typedef std::function<bool(std::string &buffer)> BodyProducer;
+
     /// Abstract class for various options passed to Client constructor.
     struct ClientOption {
         virtual ~ClientOption() {}
@@ -105,6 +159,75 @@ class Client {
         void accept(Implementation &) const override;
     };
 
+    /// Attach the client to ConnectionShare (DNS, TLS session and connection caches).
+    struct ConnectionShareOption: public ClientOptionValue<std::shared_ptr<ConnectionShare>> {
+        explicit ConnectionShareOption(std::shared_ptr<ConnectionShare> share)
+            : ClientOptionValue(std::move(share)) {}
+      protected:
+        void accept(Implementation &) const override;
+    };
+
+    /**
+     * Negotiate HTTP/2 with Elasticsearch nodes - by ALPN for https and by h2c upgrade
+     * for plain http. Nodes (or proxies) not speaking HTTP/2 are used with HTTP/1.1.
+     * Concurrent requests to a node speaking HTTP/2 are multiplexed over its connection
+     * instead of opening connection per request.
+     */
+    struct HTTP2Option: public ClientOptionValue<bool> {
+        explicit HTTP2Option(bool enable = true)
+            : ClientOptionValue(enable) {}
+      protected:
+        void accept(Implementation &) const override;
+    };
+
+    /**
+     * Maximal number of requests the client performs concurrently, i.e. maximal number
+     * of sessions it keeps. Requests above the limit wait for a free session. Zero means
+     * no limit (default). Number of connections is limited by MaxHostConnectionsOption.
+     */
+    struct MaxConnectionsOption: public ClientOptionValue<std::size_t> {
+        explicit MaxConnectionsOption(std::size_t maxConnections)
+            : ClientOptionValue(maxConnections) {}
+      protected:
+        void accept(Implementation &) const override;
+    };
+
+    /**
+     * Maximal number of connections the client opens to one node. Requests above the
+     * limit wait for a free connection, or share one when multiplexed (see HTTP2Option).
+     * Zero means no limit (default).
+     */
+    struct MaxHostConnectionsOption: public ClientOptionValue<std::size_t> {
+        explicit MaxHostConnectionsOption(std::size_t maxConnections)
+            : ClientOptionValue(maxConnections) {}
+      protected:
+        void accept(Implementation &) const override;
+    };
+
+    /**
+     * Number of connections (out of MaxConnectionsOption) reserved for requests with
+     * priority higher than RequestPriority::LOW, so background bulks and scrolls can not
+     * starve interactive requests. At least one connection is always left for LOW priority.
+     */
+    struct ReservedConnectionsOption: public ClientOptionValue<std::size_t> {
+        explicit ReservedConnectionsOption(std::size_t reservedConnections)
+            : ClientOptionValue(reservedConnections) {}
+      protected:
+        void accept(Implementation &) const override;
+    };
+
+    /**
+     * Spread requests over all nodes - each request starts on the next node in round
+     * robin order, so concurrent requests (e.g. Bulk::performParallel()) are served
+     * by more nodes. By default all requests go to one node until it fails.
+     */
+    struct LoadBalancingOption: public ClientOptionValue<bool> {
+        explicit LoadBalancingOption(bool enable = true)
+            : ClientOptionValue(enable) {}
+      protected:
+        void accept(Implementation &) const override;
+    };
+
     /// Options to setup SSL for client connection.
     struct SSLOption: public ClientOption {
         /// Implementation hidden from public interface.
@@ -198,7 +321,8 @@ class Client {
     /**
      * Initialize the Client.
      * \param hostUrlList  Vector of URLs of Elasticsearch nodes in one Elasticsearch cluster.
-     *  Each URL in vector should ends by "/".
+     *  Each URL in vector should ends by "/". Node (or local proxy) listening on Unix domain
+     *  socket is specified as "unix:///path/to/socket".
      * \param timeout      Elastic node connection timeout.
      */
     explicit Client(const std::vector<std::string> &hostUrlList,
@@ -245,6 +369,8 @@ class Client {
     /**
      * Perform request on nodes until it is successful. Throws exception if all nodes
      * has failed to respond.
+     * Requests may be performed from more threads concurrently, each of them uses its own
+     * session (see MaxConnectionsOption), connections to nodes are shared by the sessions.
      * \param method one of Client::HTTPMethod.
      * \param urlPath part of URL immediately behind "scheme://host/".
      * \param body Elasticsearch request body.
@@ -256,6 +382,35 @@ class Client {
                                  const std::string &urlPath,
                                  const std::string &body);
 
+    /**
+     * Perform request with given priority on nodes until it is successful.
+     * \see performRequest(HTTPMethod, const std::string &, const std::string &)
+     * \param priority priority of the request when waiting for free connection.
+     */
+    cpr::Response performRequest(HTTPMethod method,
+                                 const std::string &urlPath,
+                                 const std::string &body,
+                                 RequestPriority priority);
+
+    /**
+     * Perform request with body streamed by chunked transfer encoding. Body is pulled
+     * from \p producer as curl sends it, so it does not need to be in memory at once.
+     * The request fails over to next node only until the first part of body is pulled.
+     * The producer may be called from another thread performing request of the same
+     * client, never concurrently with the calling thread which waits for the response.
+     * \param method Client::HTTPMethod::POST or Client::HTTPMethod::PUT.
+     * \param urlPath part of URL immediately behind "scheme://host/".
+     * \param producer producer of Elasticsearch request body.
+     * \param priority priority of the request when waiting for free connection.
+     *
+     * \return cpr::Response if any of node responds to request.
+     * \throws ConnectionException if hosts failed to respond.
+     */
+    cpr::Response performStreamedRequest(HTTPMethod method,
+                                         const std::string &urlPath,
+                                         const BodyProducer &producer,
+                                         RequestPriority priority);
+
     /**
      * Perform search on nodes until it is successful. Throws exception if all nodes
      * has failed to respond.
@@ -272,6 +427,13 @@ class Client {
                          const std::string &body,
                          const std::string &routing = std::string());
 
+    /// \see search(), performed with given request \p priority.
+    cpr::Response search(const std::string &indexName,
+                         const std::string &docType,
+                         const std::string &body,
+                         const std::string &routing,
+                         RequestPriority priority);
+
     /**
      * Get document with specified id from cluster. Throws exception if all nodes
      * has failed to respond.
@@ -288,6 +450,13 @@ class Client {
                       const std::string &id = std::string(),
                       const std::string &routing = std::string());
 
+    /// \see get(), performed with given request \p priority.
+    cpr::Response get(const std::string &indexName,
+                      const std::string &docType,
+                      const std::string &id,
+                      const std::string &routing,
+                      RequestPriority priority);
+
     /**
      * Index new document to cluster. Throws exception if all nodes has failed to respond.
      * \param indexName specification of an Elasticsearch index.
@@ -306,6 +475,14 @@ class Client {
                         const std::string &body,
                         const std::string &routing = std::string());
 
+    /// \see index(), performed with given request \p priority.
+    cpr::Response index(const std::string &indexName,
+                        const std::string &docType,
+                        const std::string &id,
+                        const std::string &body,
+                        const std::string &routing,
+                        RequestPriority priority);
+
     /**
      * Delete document with specified id from cluster. Throws exception if all nodes
      * has failed to respond.
@@ -321,6 +498,13 @@ class Client {
                          const std::string &docType,
                          const std::string &id,
                          const std::string &routing = std::string());
+
+    /// \see remove(), performed with given request \p priority.
+    cpr::Response remove(const std::string &indexName,
+                         const std::string &docType,
+                         const std::string &id,
+                         const std::string &routing,
+                         RequestPriority priority);
   private:
     /// Helper method to setup client with ClientOption options.
     template <typename T>
@@ -5,6 +5,7 @@
 
 #pragma once
 #include <string>
+#include <cstddef>
 
 
 /// The elasticlient namespace
@@ -34,4 +35,28 @@ using LogCallback = void(*)(LogLevel, const std::string &);
 void setLogFunction(LogCallback extLogFunction);
 
 
+/**
+ * Switch logging to asynchronous mode. Formatted messages are queued into bounded
+ * ring buffer and the LogCallback is called from a background thread, so slow callback
+ * (e.g. writing into a file) does not stall requests. When the buffer is full, new messages
+ * are dropped and counted (see getDroppedLogCount()).
+ * Like setLogFunction(), it should be called before forking your program in more threads.
+ * \param capacity Number of messages the buffer can hold (rounded up to power of two).
+ *                 Zero switches back to synchronous logging after pending messages are passed
+ *                 to the callback.
+ */
+void setAsyncLogging(std::size_t capacity);
+
+
+/**
+ * Block until all messages queued so far are passed to the LogCallback. Should be called
+ * before program shutdown when asynchronous logging is enabled. Does nothing otherwise.
+ */
+void flushLog();
+
+
+/// Return number of messages dropped because the asynchronous log buffer was full.
+std::size_t getDroppedLogCount();
+
+
 } // namespace elasticlient
@@ -21,8 +21,10 @@ namespace Json {
 namespace elasticlient {
 
 
-// Forward Client class existence.
+// Forward Client, ConnectionShare classes and RequestPriority enum existence.
 class Client;
+class ConnectionShare;
+enum class RequestPriority: int;
 
 
 /// Class for use of Elasticsearch Scroll API
@@ -58,6 +60,22 @@ class Scroll {
                     const std::string &scrollTimeout = "1m",
                     std::int32_t connectionTimeout = 6000);
 
+    /**
+     * Initialize class for usage of Elasticsearch scroll API and create Client instance
+     * for specified hostUrlList and timeout attached to the \p connectionShare.
+     * \param hostUrlList list of URLs of Elastic nodes in one cluster.
+     * \param scrollSize number of results per one scroll "page".
+     * \param scrollTimeout time during scroll search context remaining alive. Defined by
+     *        Elastic Time Units (i.e. 1m = 1 minute).
+     * \param timeout Elasticsearch node connection timeout.
+     * \param connectionShare shared DNS, TLS session and connection caches.
+     */
+    Scroll(const std::vector<std::string> &hostUrlList,
+           std::size_t scrollSize,
+           const std::string &scrollTimeout,
+           std::int32_t connectionTimeout,
+           const std::shared_ptr<ConnectionShare> &connectionShare);
+
     Scroll(Scroll &&);
 
     virtual ~Scroll();
@@ -82,6 +100,9 @@ class Scroll {
      */
     bool next(Json::Value &parsedResult);
 
+    /// Set priority of scroll requests (RequestPriority::LOW by default).
+    void setRequestPriority(RequestPriority priority);
+
     /// Return Client class with current config.
     const std::shared_ptr<Client> &getClient() const;
 
@@ -0,0 +1,101 @@
+/**
+ * \file
+ * Index of bulk items used to coalesce operations on the same document.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+namespace elasticlient {
+
+
+/**
+ * Open addressing hash index of the last bulk item of each (index, type, id) key.
+ * Keys are kept serialized in one buffer, slots hold just their hash, position of
+ * the key and of the item.
+ */
+class BulkItemIndex {
+  public:
+    /// Kind of indexed item, tells how a following item may be coalesced with it.
+    enum class Kind: std::uint8_t {
+        /// Index action, may be dropped or merged with partial update.
+        INDEX,
+        /// Update by partial document, may be dropped or merged.
+        PARTIAL_UPDATE,
+        /// Other update (script, upsert), may be dropped by following index.
+        UPDATE,
+        /// Item which must be kept (create, delete, item with metadata).
+        BARRIER
+    };
+
+    /// Last item of a key.
+    struct Entry {
+        /// Position of the item in the bulk, npos for new key.
+        std::uint32_t item;
+        Kind kind;
+    };
+
+    static const std::uint32_t npos = 0xffffffff;
+
+    BulkItemIndex(): slots(), keys(), used(0), scratch() {}
+
+    /**
+     * Return entry of the key, new entry with npos item is created for unknown key.
+     * Reference is valid until next call of find().
+     */
+    Entry &find(const std::string &indexName,
+                const std::string &docType,
+                const std::string &docId);
+
+    /// Replace item positions by \p positions[item] after the bulk has been compacted.
+    void remap(const std::vector<std::uint32_t> &positions);
+
+    /// Remove all keys, keeping allocated memory.
+    void clear();
+
+  private:
+    struct Slot {
+        std::uint64_t hash;
+        std::uint32_t keyOffset;
+        std::uint32_t keyLength;
+        Entry entry;
+        bool used;
+    };
+
+    /// Double number of slots and insert used ones again.
+    void grow();
+
+    /// Slots, their number is power of two.
+    std::vector<Slot> slots;
+    /// Serialized keys of all slots.
+    std::string keys;
+    /// Number of used slots.
+    std::size_t used;
+    /// Key being searched for.
+    std::string scratch;
+};
+
+
+/**
+ * Parse update action \p source of \p length bytes.
+ * \return true if it is update by partial document only, i.e. {"doc": {...}}.
+ */
+bool isPartialUpdate(const char *source, std::size_t length);
+
+
+/**
+ * Merge partial document of update \p update into \p target, which is either
+ * other partial update (\p targetIsUpdate) or indexed document, the same way
+ * Elasticsearch applies it: objects are merged recursively, other values replaced.
+ * \param out merged source of update or index action.
+ * \return false if sources can not be parsed.
+ */
+bool mergePartialUpdate(const char *target, std::size_t targetLength, bool targetIsUpdate,
+                        const char *update, std::size_t updateLength, std::string &out);
+
+
+}  // namespace elasticlient
@@ -0,0 +1,160 @@
+/**
+ * \file
+ * Implementation of index of bulk items used to coalesce operations.
+ */
+
+#include "bulk-coalesce-impl.h"
+
+#include <algorithm>
+#include <json/json.h>
+
+
+namespace {
+
+
+/// Append length of the key part and the part itself to \p out.
+void appendKeyPart(std::string &out, const std::string &part) {
+    const std::uint32_t length = part.size();
+    out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    out += part;
+}
+
+
+/// Return FNV-1a hash of \p key.
+std::uint64_t hashKey(const std::string &key) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c: key) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+/// Parse JSON object from \p data of \p length bytes into \p value.
+bool parseObject(const char *data, std::size_t length, Json::Value &value) {
+    Json::Reader reader;
+    return reader.parse(data, data + length, value, false) && value.isObject();
+}
+
+
+/// Merge object \p update into object \p target recursively.
+void mergeObject(Json::Value &target, const Json::Value &update) {
+    for (Json::Value::const_iterator it = update.begin(); it != update.end(); ++it) {
+        const std::string name = it.name();
+        Json::Value &member = target[name];
+        if (member.isObject() && it->isObject()) {
+            mergeObject(member, *it);
+        } else {
+            member = *it;
+        }
+    }
+}
+
+
+} // anonymous namespace
+
+
+namespace elasticlient {
+
+
+const std::uint32_t BulkItemIndex::npos;
+
+
+BulkItemIndex::Entry &BulkItemIndex::find(const std::string &indexName,
+                                          const std::string &docType,
+                                          const std::string &docId)
+{
+    // keep load factor at most one half
+    if ((used + 1) * 2 > slots.size()) {
+        grow();
+    }
+    scratch.clear();
+    appendKeyPart(scratch, indexName);
+    appendKeyPart(scratch, docType);
+    scratch += docId;
+    const std::uint64_t hash = hashKey(scratch);
+
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = hash & mask; ; i = (i + 1) & mask) {
+        Slot &slot = slots[i];
+        if (!slot.used) {
+            slot.used = true;
+            slot.hash = hash;
+            slot.keyOffset = keys.size();
+            slot.keyLength = scratch.size();
+            slot.entry.item = npos;
+            slot.entry.kind = Kind::BARRIER;
+            keys += scratch;
+            ++used;
+            return slot.entry;
+        }
+        if (slot.hash == hash && slot.keyLength == scratch.size()
+            && keys.compare(slot.keyOffset, slot.keyLength, scratch) == 0)
+        {
+            return slot.entry;
+        }
+    }
+}
+
+
+void BulkItemIndex::grow() {
+    std::vector<Slot> old(std::max<std::size_t>(64, slots.size() * 2));
+    old.swap(slots);
+    for (Slot &slot: slots) {
+        slot.used = false;
+    }
+    const std::size_t mask = slots.size() - 1;
+    for (const Slot &slot: old) {
+        if (slot.used) {
+            std::size_t i = slot.hash & mask;
+            while (slots[i].used) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+    }
+}
+
+
+void BulkItemIndex::remap(const std::vector<std::uint32_t> &positions) {
+    for (Slot &slot: slots) {
+        if (slot.used && slot.entry.item != npos) {
+            slot.entry.item = positions[slot.entry.item];
+        }
+    }
+}
+
+
+void BulkItemIndex::clear() {
+    for (Slot &slot: slots) {
+        slot.used = false;
+    }
+    keys.clear();
+    used = 0;
+}
+
+
+bool isPartialUpdate(const char *source, std::size_t length) {
+    Json::Value update;
+    return parseObject(source, length, update) && update.size() == 1
+        && update.isMember("doc") && update["doc"].isObject();
+}
+
+
+bool mergePartialUpdate(const char *target, std::size_t targetLength, bool targetIsUpdate,
+                        const char *update, std::size_t updateLength, std::string &out)
+{
+    Json::Value merged;
+    Json::Value partial;
+    if (!parseObject(target, targetLength, merged) || !parseObject(update, updateLength, partial)) {
+        return false;
+    }
+    mergeObject(targetIsUpdate ? merged["doc"] : merged, partial["doc"]);
+    Json::FastWriter writer;
+    writer.omitEndingLineFeed();
+    out = writer.write(merged);
+    return true;
+}
+
+
+}  // namespace elasticlient
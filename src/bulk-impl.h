@@ -6,10 +6,19 @@
 #pragma once
 
 #include "elasticlient/bulk.h"
+#include "elasticlient/client.h"
+#include "bulk-response-impl.h"
+#include "bulk-coalesce-impl.h"
 
 #include <string>
 #include <vector>
-#include <ostream>
+#include <memory>
+#include <utility>
+#include <random>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <cstdint>
 #include <stdexcept>
 
 
@@ -32,66 +41,527 @@ std::string createControl(const std::string &action,
                           const std::string &docId = "");
 
 
-struct BulkItem {
-    /// Control field record.
-    std::string control;
-    /// Data (_source) field. Not needed for "delete" action.
-    std::string source;
+/**
+ * Create control field for one bulk item with item \p metadata.
+ * \code
+ *   {"delete": {"_type": "type1", "_id": "1", "routing": "user1", "version": 3}}
+ * \endcode
+ */
+std::string createControl(const std::string &action,
+                          const std::string &docType,
+                          const std::string &docId,
+                          const BulkItemMetadata &metadata);
+
+
+/**
+ * Append control field for one bulk item to \p out.
+ * \see createControl()
+ */
+void appendControl(std::string &out,
+                   const std::string &action,
+                   const std::string &docType,
+                   const std::string &docId);
+
+
+/**
+ * Append control field for one bulk item of index \p indexName to \p out.
+ * Index is omitted if \p indexName is empty, \p metadata if it is nullptr.
+ * \code
+ *   {"index": {"_index": "index1", "_type": "type1", "_id": "1"}}
+ * \endcode
+ */
+void appendControl(std::string &out,
+                   const std::string &action,
+                   const std::string &indexName,
+                   const std::string &docType,
+                   const std::string &docId,
+                   const BulkItemMetadata *metadata);
+
+
+/**
+ * Append \p value to \p out as quoted JSON string, escaping quotes, backslashes and
+ * control characters. Other bytes (including UTF-8 sequences) are copied as they are.
+ */
+void appendJsonString(std::string &out, const std::string &value);
+
+
+/// \see appendJsonString(std::string &, const std::string &)
+void appendJsonString(std::string &out, const char *value, std::size_t length);
 
-    explicit BulkItem(const std::string &control = "",
-                      const std::string &source = "")
-      : control(control), source(source)
-    {}
 
-    friend std::ostream &operator<<(std::ostream &os, const BulkItem &item) {
-        if (item.control.empty()) {
-            return os;
+/**
+ * Append \p value to \p out as compact JSON, the same way as Json::FastWriter with
+ * omitted ending line feed does, except that strings are not escaped to ASCII.
+ */
+void appendJsonValue(std::string &out, const Json::Value &value);
+
+
+/**
+ * Writer of bulk control lines. Beginning of the line given by action, index and
+ * document type is serialized once and reused by following items of the same kind,
+ * only ID and metadata are escaped for each item.
+ */
+class ControlLineWriter {
+    /// Serialized beginning of control line.
+    struct Prefix {
+        std::string action;
+        std::string indexName;
+        std::string docType;
+        std::string line;
+    };
+
+    /// Maximal number of cached prefixes, bulks usually have just a few kinds of items.
+    static const std::size_t maxPrefixes = 8;
+
+    std::vector<Prefix> prefixes;
+    /// Prefix replaced when the cache is full.
+    std::size_t nextReplaced;
+
+  public:
+    ControlLineWriter(): prefixes(), nextReplaced(0) {}
+
+    /**
+     * Append control line to \p out, the same as appendControl().
+     * \see appendControl()
+     */
+    void append(std::string &out,
+                const char *action,
+                const std::string &indexName,
+                const std::string &docType,
+                const std::string &docId,
+                const BulkItemMetadata *metadata);
+
+  private:
+    /// Return cached prefix of the line, serialize it if it is not cached.
+    const std::string &prefix(const char *action,
+                              const std::string &indexName,
+                              const std::string &docType);
+};
+
+
+/**
+ * Serialized body of bulk data collectors. Items are appended into one buffer
+ * kept allocated across clear().
+ */
+class BulkBuffer {
+  protected:
+    /// Desired bulk size
+    std::size_t size;
+    /// Desired bulk body size in bytes, 0 for no limit.
+    std::size_t maxBytes;
+    /// Serialized bulk body, including items dropped by coalescing until compact().
+    std::string buffer;
+    /// Offsets of the items (their control lines) in the buffer.
+    std::vector<std::size_t> itemOffsets;
+    /// Writer of control lines, keeps prefixes across clear().
+    ControlLineWriter controlWriter;
+
+    /// Index of last item of each document, null unless coalescing is enabled.
+    std::unique_ptr<BulkItemIndex> itemIndex;
+    /// Flag of each item dropped by coalescing (if enabled).
+    std::vector<bool> dropped;
+    /// Number of dropped items still in the buffer.
+    std::size_t droppedItems;
+    /// Number of bytes of dropped items still in the buffer.
+    std::size_t droppedBytes;
+    /// Number of items dropped by coalescing since creation.
+    std::size_t droppedOperations;
+    /// Number of items merged by coalescing since creation.
+    std::size_t mergedOperations;
+    /// Merged source of update being coalesced.
+    std::string merged;
+    /// Serialized Json::Value source of item being coalesced.
+    std::string jsonSource;
+    /// Guards compact() by serialized(), const body accessors may read one bulk at once.
+    std::mutex compactMutex;
+
+  public:
+    BulkBuffer(std::size_t size, std::size_t maxBytes)
+      : size(size), maxBytes(maxBytes), buffer(), itemOffsets(), controlWriter(),
+        itemIndex(), dropped(), droppedItems(0), droppedBytes(0), droppedOperations(0),
+        mergedOperations(0), merged(), jsonSource(), compactMutex()
+    {
+        if (size) {
+            itemOffsets.reserve(size);
+        }
+    }
+
+    /**
+     * Serialize item into the buffer, \p indexName is omitted from control line
+     * when empty, \p metadata when nullptr. Empty \p source has no line.
+     * \return true if bulk has reached its desired capacity.
+     */
+    bool append(const char *action,
+                const std::string &indexName,
+                const std::string &docType,
+                const std::string &docId,
+                DocumentView source,
+                const BulkItemMetadata *metadata)
+    {
+        if (itemIndex && !docId.empty()) {
+            appendCoalesced(action, indexName, docType, docId, source, metadata);
+        } else {
+            appendItem(action, indexName, docType, docId, source, metadata);
+        }
+        if (itemCount() >= size || (maxBytes && byteCount() >= maxBytes)) {
+            // full bulk is about to be sent, do not leave compacting to its readers
+            compact();
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Serialize item with \p source document written straight into the buffer.
+     * \see append()
+     */
+    bool append(const char *action,
+                const std::string &indexName,
+                const std::string &docType,
+                const std::string &docId,
+                const Json::Value &source,
+                const BulkItemMetadata *metadata)
+    {
+        if (itemIndex && !docId.empty()) {
+            // coalescing reads the source, serialize it on its own
+            jsonSource.clear();
+            appendJsonValue(jsonSource, source);
+            return append(action, indexName, docType, docId,
+                          DocumentView(jsonSource.data(), jsonSource.size()), metadata);
+        }
+        itemOffsets.push_back(buffer.size());
+        controlWriter.append(buffer, action, indexName, docType, docId, metadata);
+        buffer += '\n';
+        appendJsonValue(buffer, source);
+        buffer += '\n';
+        if (itemIndex) {
+            dropped.push_back(false);
+        }
+        return itemCount() >= size || (maxBytes && byteCount() >= maxBytes);
+    }
+
+    /// Enable or disable coalescing of following items.
+    void setCoalescing(bool enabled);
+
+    /// Return number of items, not counting dropped ones.
+    std::size_t itemCount() const {
+        return itemOffsets.size() - droppedItems;
+    }
+
+    /// Return size of serialized body, not counting dropped items.
+    std::size_t byteCount() const {
+        return buffer.size() - droppedBytes;
+    }
+
+    /**
+     * Return serialized body without dropped items. Dropped items are removed
+     * on the first call after they were dropped, following calls (also from
+     * other threads) only read the buffer.
+     */
+    const std::string &serialized() {
+        std::lock_guard<std::mutex> lock(compactMutex);
+        compact();
+        return buffer;
+    }
+
+    /// Remove all items, keeping allocated memory for next ones.
+    void clear() {
+        buffer.clear();
+        itemOffsets.clear();
+        dropped.clear();
+        droppedItems = 0;
+        droppedBytes = 0;
+        if (itemIndex) {
+            itemIndex->clear();
+        }
+    }
+
+  private:
+    /// Serialize item into the buffer.
+    void appendItem(const char *action,
+                    const std::string &indexName,
+                    const std::string &docType,
+                    const std::string &docId,
+                    DocumentView source,
+                    const BulkItemMetadata *metadata)
+    {
+        itemOffsets.push_back(buffer.size());
+        // control and source lines are both terminated by newline
+        controlWriter.append(buffer, action, indexName, docType, docId, metadata);
+        buffer += '\n';
+        if (source.length) {
+            buffer.append(source.data, source.length);
+            buffer += '\n';
         }
-        os << item.control << "\n";
-        if (not item.source.empty()) {
-            os << item.source << "\n";
+        if (itemIndex) {
+            dropped.push_back(false);
         }
-        return os;
     }
+
+    /**
+     * Serialize item, dropping or merging previous item of the same document:
+     * index action supersedes previous index and update, partial document update
+     * is merged into previous partial update or index.
+     */
+    void appendCoalesced(const char *action,
+                         const std::string &indexName,
+                         const std::string &docType,
+                         const std::string &docId,
+                         DocumentView source,
+                         const BulkItemMetadata *metadata);
+
+    /// Return source line (without newline) of item at \p position.
+    DocumentView sourceOf(std::size_t position) const;
+
+    /// Mark item at \p position dropped.
+    void drop(std::size_t position);
+
+    /// Remove dropped items from the buffer.
+    void compact();
 };
 
 
-class SameIndexBulkData::Implementation {
+class SameIndexBulkData::Implementation: public BulkBuffer {
     /// Index to which all data belongs to.
     std::string indexName;
-    /// Desired bulk size
-    std::size_t size;
-    /// Bulk documents
-    std::vector<BulkItem> data;
+    /// Empty index name of control lines.
+    const std::string noIndex;
 
   public:
-    explicit Implementation(const std::string &indexName, std::size_t size)
-      : indexName(indexName), size(size), data()
+    explicit Implementation(const std::string &indexName,
+                            std::size_t size,
+                            std::size_t maxBytes = 0)
+      : BulkBuffer(size, maxBytes), indexName(indexName), noIndex()
     {
         if (indexName.empty()) {
             throw std::runtime_error("Index name is mandatory argument");
         }
-        if (size) {
-            data.reserve(size);
-        }
+    }
+
+    /**
+     * Serialize item into the buffer.
+     * \return true if bulk has reached its desired capacity.
+     */
+    bool append(const char *action,
+                const std::string &docType,
+                const std::string &docId,
+                DocumentView source,
+                const BulkItemMetadata *metadata = nullptr)
+    {
+        // index is given by URL of the request
+        return BulkBuffer::append(action, noIndex, docType, docId, source, metadata);
+    }
+
+    /// \see append()
+    bool append(const char *action,
+                const std::string &docType,
+                const std::string &docId,
+                const Json::Value &source,
+                const BulkItemMetadata *metadata = nullptr)
+    {
+        return BulkBuffer::append(action, noIndex, docType, docId, source, metadata);
     }
 
     friend class SameIndexBulkData;
 };
 
 
+class MultiIndexBulkData::Implementation: public BulkBuffer {
+  public:
+    Implementation(std::size_t size, std::size_t maxBytes)
+      : BulkBuffer(size, maxBytes)
+    {}
+
+    /**
+     * Serialize item with its index into the buffer.
+     * \return true if bulk has reached its desired capacity.
+     */
+    bool append(const char *action,
+                const std::string &indexName,
+                const std::string &docType,
+                const std::string &docId,
+                DocumentView source,
+                const BulkItemMetadata *metadata = nullptr)
+    {
+        if (indexName.empty()) {
+            throw std::runtime_error("Index name is mandatory argument");
+        }
+        return BulkBuffer::append(action, indexName, docType, docId, source, metadata);
+    }
+
+    /// \see append()
+    bool append(const char *action,
+                const std::string &indexName,
+                const std::string &docType,
+                const std::string &docId,
+                const Json::Value &source,
+                const BulkItemMetadata *metadata = nullptr)
+    {
+        if (indexName.empty()) {
+            throw std::runtime_error("Index name is mandatory argument");
+        }
+        return BulkBuffer::append(action, indexName, docType, docId, source, metadata);
+    }
+
+    friend class MultiIndexBulkData;
+};
+
+
+class BulkResult::Implementation {
+    /// Result of one item, strings are stored in the strings buffer.
+    struct Item {
+        std::uint32_t idOffset;
+        std::uint32_t idLength;
+        std::uint32_t reasonOffset;
+        std::uint32_t reasonLength;
+        /// Index to errorTypes.
+        std::uint32_t errorType;
+        std::int16_t status;
+        Action action;
+
+        Item()
+          : idOffset(0), idLength(0), reasonOffset(0), reasonLength(0), errorType(0),
+            status(0), action(Action::UNKNOWN)
+        {}
+    };
+
+    std::vector<Item> items;
+    /// Ids and error reasons of all items, id followed by reason for each item.
+    std::string strings;
+    /// Bytes of strings no longer referenced by any item.
+    std::size_t unusedStrings;
+    /// Distinct error types, the first one is empty.
+    std::vector<std::string> errorTypes;
+    /// Index of each error type in errorTypes.
+    std::map<std::string, std::uint32_t> errorTypeIndex;
+    std::size_t errCount;
+
+    friend class BulkResult;
+
+  public:
+    Implementation()
+      : items(), strings(), unusedStrings(0), errorTypes(1), errorTypeIndex(), errCount(0)
+    {}
+
+    /// Clear result and prepare it for \p size items without response (failed).
+    void reset(std::size_t size) {
+        items.assign(size, Item());
+        strings.clear();
+        unusedStrings = 0;
+        errorTypes.resize(1);
+        errorTypeIndex.clear();
+        errCount = size;
+    }
+
+    /// Store result of item at \p position.
+    void set(std::size_t position,
+             Action action,
+             const std::string &id,
+             int status,
+             const std::string &errorType,
+             const std::string &errorReason);
+
+    /// Store results of all items of \p other at positions starting at \p offset.
+    void merge(std::size_t offset, const Implementation &other);
+
+    /// Store results of items of \p other at corresponding \p positions.
+    void merge(const std::vector<std::size_t> &positions, const Implementation &other);
+
+    /// Return BulkResult::Action of action named \p name.
+    static Action parseAction(const std::string &name);
+
+    /// Return true if \p status of \p action means failure.
+    static bool isFailure(int status, Action action) {
+        // document to delete is already missing
+        return status / 100 != 2 && !(status == 404 && action == Action::DELETE);
+    }
+
+  private:
+    /// Drop unused bytes from strings.
+    void compactStrings();
+};
+
+
+/**
+ * Split serialized bulk \p body into items.
+ * \return offset and length of each item (control line and source line, except
+ *         "delete" action which has no source line).
+ */
+std::vector<std::pair<std::size_t, std::size_t>> splitBulkItems(const std::string &body);
+
+
 class Bulk::Implementation {
+    /// Failure of one bulk item reported by Elasticsearch.
+    struct ItemFailure {
+        /// Position of the item in the bulk.
+        std::size_t position;
+        /// HTTP status of the item.
+        int status;
+        /// Elasticsearch error type, empty if not reported.
+        std::string errorType;
+
+        ItemFailure(std::size_t position, int status, const std::string &errorType)
+          : position(position), status(status), errorType(errorType)
+        {}
+    };
+
+    /// Bulk or part of it sent concurrently with others by runParallel().
+    struct Part {
+        /// Serialized items, points to bulk data or to ownedBody.
+        const std::string *body;
+        /// Items of the part copied out of larger bulk (if needed).
+        std::string ownedBody;
+        /// Number of items.
+        std::size_t size;
+        std::string urlPath;
+        /// Position of the first item of the part in result.
+        std::size_t offset;
+        /// Positions of the items in result if they do not follow from offset.
+        std::vector<std::size_t> positions;
+        /// Client of node the part is sent to directly, null for Client of the Bulk.
+        std::shared_ptr<Client> client;
+        /// Set when node of the part did not respond and the bulk Client was used.
+        bool unreachable;
+
+        Part()
+          : body(nullptr), ownedBody(), size(0), urlPath(), offset(0), positions(), client(),
+            unreachable(false)
+        {}
+    };
+
     /// Client holder
     std::shared_ptr<Client> client;
     /// Number of errors occured (failed to index).
     std::size_t errCount;
+    /// Priority of bulk requests.
+    Client::RequestPriority priority;
+    /// Retrying of failed bulk items.
+    RetryPolicy retryPolicy;
+    /// Items of last bulk failed permanently.
+    std::vector<FailedItem> failedItems;
+    /// Statistics of requests of last bulk.
+    Statistics statistics;
+    /// Queue of bulks which could not be sent, may be null.
+    std::shared_ptr<BulkSpillQueue> spillQueue;
+    /// Generator of backoff jitter.
+    std::mt19937 random;
+    /// True if results of all items are collected.
+    bool collectResult;
+    /// Results of last bulk items.
+    BulkResult result;
+    /// Item of bulk response being read, kept to reuse its strings.
+    BulkItemResponse item;
+    /// Maximal number of concurrent requests of runParallel().
+    std::size_t parallelism;
 
     // allow Bulk to access private members
     friend class Bulk;
 
   public:
     Implementation(std::shared_ptr<Client> elasticClient)
-      : client(std::move(elasticClient)), errCount(0)
+      : client(std::move(elasticClient)), errCount(0), priority(Client::RequestPriority::LOW),
+        retryPolicy(), failedItems(), statistics(), spillQueue(), random(std::random_device()()),
+        collectResult(false), result(), item(), parallelism(1)
     {
         if (!client) {
             throw std::runtime_error("Valid Client instance is required.");
@@ -99,14 +569,99 @@ class Bulk::Implementation {
     }
 
     /**
-     * Send bulk body on Client
+     * Send bulk body on Client, retry failed items according to retryPolicy.
      * Request errors are counted to the bulk counters.
      */
     void run(const IBulkData &bulk);
 
+    /**
+     * Send \p parts concurrently on at most parallelism connections, each one
+     * retried according to retryPolicy. Request errors of all parts are counted
+     * to the bulk counters.
+     * \param size total number of items of all parts.
+     */
+    void runParallel(std::vector<Part> &parts, std::size_t size);
+
+    /**
+     * Send bulk body pulled from \p producer on Client.
+     * Request errors are counted to the bulk counters.
+     */
+    void run(IBulkDataProducer &producer);
+
+    /**
+     * Send serialized \p body of \p size items to \p urlPath as new bulk, retry failed
+     * items according to retryPolicy.
+     * \return number of errors occured.
+     */
+    std::size_t runSerialized(const std::string &body, std::size_t size,
+                              const std::string &urlPath)
+    {
+        errCount = 0;
+        failedItems.clear();
+        statistics = Statistics();
+        runBody(body, size, urlPath, false);
+        return errCount;
+    }
+
+    /**
+     * Send bulk \p body of \p size items spilled for \p urlPath. Once the cluster
+     * has responded, retried items which can not be sent are spilled again.
+     * \return false if the cluster is still unavailable, no errors are counted then.
+     */
+    bool runSpilled(const std::string &body, std::size_t size, const std::string &urlPath) {
+        return runBody(body, size, urlPath, true);
+    }
+
+    /**
+     * Return serialized body of \p bulk, copied into \p copy unless the bulk
+     * keeps it serialized.
+     */
+    static const std::string &bodyOf(const IBulkData &bulk, std::string &copy);
+
+    /// Return URL path of bulk request of \p indexName (empty for more indices).
+    static std::string urlPathOf(const std::string &indexName);
+
   private:
-    /// Check correctness of bulk result and update error counters.
-    void processResult(const std::string &result, std::size_t size);
+    /**
+     * Send serialized \p body of \p size items to \p urlPath, retry failed items
+     * according to retryPolicy. Items which can not be sent, because all hosts failed,
+     * are appended to spillQueue (if any).
+     * \param replay whether the body can be sent later or elsewhere (replayed from
+     *        spillQueue or sent to other node), it is not spilled then unless
+     *        the first attempt has got a response.
+     * \return false if the first attempt to send replayed body has got no response
+     *         (no errors are counted then).
+     */
+    bool runBody(const std::string &body, std::size_t size, const std::string &urlPath,
+                 bool replay);
+
+    /**
+     * Check correctness of bulk result and collect failed items into \p failures.
+     * Item results are stored into result at original item positions. Items without
+     * readable response are failed with status 0.
+     * \param positions original positions of the sent items, empty if not retried.
+     * \return false if result can not be parsed, i.e. whole bulk has failed.
+     */
+    bool processResult(const std::string &response, std::size_t size,
+                       const std::vector<std::size_t> &positions,
+                       std::vector<ItemFailure> &failures);
+
+    /// Store result of whole bulk failed with \p status for sent items.
+    void setFailed(std::size_t size, const std::vector<std::size_t> &positions, int status);
+
+    /// Fail items from \p first to \p size which have no readable response.
+    void setUnanswered(std::size_t first, std::size_t size,
+                       const std::vector<std::size_t> &positions,
+                       std::vector<ItemFailure> &failures);
+
+    /// Count items of \p failures rejected by Elasticsearch to statistics.
+    void countRejected(const std::vector<ItemFailure> &failures);
+
+    /// Return true if item failed with \p status should be sent again.
+    bool isRetryable(int status) const;
+
+    /// Return jittered time to wait before \p attempt (2 for first retry).
+    std::chrono::milliseconds backoff(std::size_t attempt);
 };
 
 
@@ -0,0 +1,172 @@
+/**
+ * \file
+ * Implementation of compact Json::Value serialization into bulk buffers.
+ */
+
+#include "bulk-impl.h"
+
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <json/json.h>
+
+
+namespace {
+
+
+/// Decimal representation of numbers 0 - 99, two digits each.
+const char digitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+
+/// Append decimal representation of \p value to \p out.
+void appendUnsigned(std::string &out, std::uint64_t value) {
+    // 20 digits of UINT64_MAX
+    char buffer[20];
+    char *end = buffer + sizeof(buffer);
+    char *begin = end;
+    while (value >= 100) {
+        const std::size_t pair = (value % 100) * 2;
+        value /= 100;
+        *--begin = digitPairs[pair + 1];
+        *--begin = digitPairs[pair];
+    }
+    if (value >= 10) {
+        *--begin = digitPairs[value * 2 + 1];
+        *--begin = digitPairs[value * 2];
+    } else {
+        *--begin = static_cast<char>('0' + value);
+    }
+    out.append(begin, end);
+}
+
+
+/// Append decimal representation of \p value to \p out.
+void appendSigned(std::string &out, std::int64_t value) {
+    if (value < 0) {
+        out += '-';
+        // negate in unsigned arithmetic, INT64_MIN has no positive counterpart
+        appendUnsigned(out, 0 - static_cast<std::uint64_t>(value));
+    } else {
+        appendUnsigned(out, static_cast<std::uint64_t>(value));
+    }
+}
+
+
+/**
+ * Append \p value to \p out the same way as Json::FastWriter does: 17 significant
+ * digits, always with decimal point or exponent, infinities as out-of-range numbers
+ * and NaN as null.
+ */
+void appendDouble(std::string &out, double value) {
+    if (std::isnan(value)) {
+        out += "null";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value < 0 ? "-1e+9999" : "1e+9999";
+        return;
+    }
+    // whole numbers (counts, timestamps) are printed exactly, skip snprintf for them
+    double whole;
+    if (std::fabs(value) < 1e15 && std::fpclassify(std::modf(value, &whole)) == FP_ZERO) {
+        if (std::signbit(value)) {
+            out += '-';
+        }
+        appendUnsigned(out, static_cast<std::uint64_t>(std::fabs(whole)));
+        out += ".0";
+        return;
+    }
+
+    char buffer[32];
+    const int length = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    bool fraction = false;
+    for (int i = 0; i < length; ++i) {
+        if (buffer[i] == ',') {
+            // decimal separator of current locale
+            buffer[i] = '.';
+        }
+        if (buffer[i] == '.' || buffer[i] == 'e') {
+            fraction = true;
+        }
+    }
+    out.append(buffer, length);
+    if (!fraction) {
+        out += ".0";
+    }
+}
+
+
+}  // anonymous namespace
+
+
+namespace elasticlient {
+
+
+void appendJsonValue(std::string &out, const Json::Value &value) {
+    switch (value.type()) {
+        case Json::nullValue:
+            out += "null";
+            break;
+        case Json::intValue:
+            appendSigned(out, value.asLargestInt());
+            break;
+        case Json::uintValue:
+            appendUnsigned(out, value.asLargestUInt());
+            break;
+        case Json::realValue:
+            appendDouble(out, value.asDouble());
+            break;
+        case Json::booleanValue:
+            out += value.asBool() ? "true" : "false";
+            break;
+        case Json::stringValue: {
+            const char *begin = nullptr;
+            const char *end = nullptr;
+            value.getString(&begin, &end);
+            appendJsonString(out, begin, end - begin);
+            break;
+        }
+        case Json::arrayValue: {
+            out += '[';
+            const Json::ArrayIndex size = value.size();
+            for (Json::ArrayIndex i = 0; i < size; ++i) {
+                if (i) {
+                    out += ',';
+                }
+                appendJsonValue(out, value[i]);
+            }
+            out += ']';
+            break;
+        }
+        case Json::objectValue: {
+            out += '{';
+            for (Json::Value::const_iterator it = value.begin(); it != value.end(); ++it) {
+                if (it != value.begin()) {
+                    out += ',';
+                }
+                // member name without copying it into std::string
+                const char *end = nullptr;
+                const char *name = it.memberName(&end);
+                appendJsonString(out, name, end - name);
+                out += ':';
+                appendJsonValue(out, *it);
+            }
+            out += '}';
+            break;
+        }
+    }
+}
+
+
+}  // namespace elasticlient
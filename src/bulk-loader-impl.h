@@ -0,0 +1,81 @@
+/**
+ * \file
+ * Implementation of bulk loader of NDJSON files.
+ */
+
+#pragma once
+
+#include "elasticlient/bulk-loader.h"
+#include "bulk-impl.h"
+
+#include <string>
+#include <chrono>
+#include <mutex>
+
+
+namespace elasticlient {
+
+
+/**
+ * Find end of bulk item (or document) of \p format starting at \p begin.
+ * \return pointer past newline of the item, \p end if it is not terminated.
+ */
+const char *bulkFileItemEnd(const char *begin, const char *end, BulkFileLoader::Format format);
+
+
+class BulkFileLoader::Implementation {
+    typedef std::chrono::steady_clock Clock;
+
+    /// Slice of the mapped file sent as one bulk.
+    struct Batch {
+        const char *begin;
+        const char *end;
+        /// Number of documents (items) of the batch.
+        std::size_t size;
+    };
+
+    std::shared_ptr<Client> client;
+    const std::string indexName;
+    const Settings settings;
+    /// URL path of bulk requests.
+    const std::string urlPath;
+    /// Control line (with newline) of each document of DOCUMENTS format.
+    std::string control;
+
+    /// Guards members below.
+    mutable std::mutex mutex;
+    /// Unread part of the mapped file.
+    const char *cursor;
+    const char *fileEnd;
+    Progress progress;
+    Clock::time_point started;
+    Clock::time_point lastReport;
+    /// Serializes progress callbacks.
+    std::mutex callbackMutex;
+
+    friend class BulkFileLoader;
+
+  public:
+    Implementation(const std::shared_ptr<Client> &client,
+                   const std::string &indexName,
+                   const Settings &settings);
+
+    /// \see BulkFileLoader::load
+    Progress load(const std::string &path);
+
+  private:
+    /// Take next batch of the file, return false at the end of the file.
+    bool nextBatch(Batch &batch);
+
+    /// Append serialized batch to \p body.
+    void serialize(const Batch &batch, std::string &body) const;
+
+    /// Send batches until the file is read, run by each worker.
+    void runWorker();
+
+    /// Report progress by the callback if interval has passed or \p force is set.
+    void report(bool force);
+};
+
+
+}  // namespace elasticlient
@@ -0,0 +1,333 @@
+/**
+ * \file
+ * Implementation of bulk loader of NDJSON files.
+ */
+
+#include "bulk-loader-impl.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "logging-impl.h"
+
+
+namespace {
+
+
+/// Read-only memory mapping of whole file.
+class MappedFile {
+    void *data;
+    std::size_t length;
+
+  public:
+    explicit MappedFile(const std::string &path): data(nullptr), length(0) {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(errno));
+        }
+        length = info.st_size;
+        if (length) {
+            data = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("Cannot map " + path + ": " + std::strerror(errno));
+        }
+        if (data) {
+            // the file is read once from start to end
+            ::madvise(data, length, MADV_SEQUENTIAL);
+        }
+    }
+
+    ~MappedFile() {
+        if (data) {
+            ::munmap(data, length);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *begin() const {
+        return static_cast<const char *>(data);
+    }
+
+    const char *end() const {
+        return begin() + length;
+    }
+
+    std::size_t size() const {
+        return length;
+    }
+};
+
+
+/// Return pointer past the newline ending line at \p begin, \p end if there is none.
+const char *lineEnd(const char *begin, const char *end) {
+    const void *newline = std::memchr(begin, '\n', end - begin);
+    return newline ? static_cast<const char *>(newline) + 1 : end;
+}
+
+
+/// Return true if line [begin, end) has only whitespace.
+bool isBlank(const char *begin, const char *end) {
+    for (; begin != end; ++begin) {
+        if (*begin != '\n' && *begin != '\r' && *begin != ' ' && *begin != '\t') {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/// Return true if bulk control line [begin, end) has "delete" action.
+bool isDeleteControl(const char *begin, const char *end) {
+    // action is the first key of the control line
+    const void *quote = std::memchr(begin, '"', end - begin);
+    if (!quote) {
+        return false;
+    }
+    const char *action = static_cast<const char *>(quote) + 1;
+    return end - action > 7 && std::memcmp(action, "delete\"", 7) == 0;
+}
+
+
+} // anonymous namespace
+
+
+namespace elasticlient {
+
+
+const char *bulkFileItemEnd(const char *begin, const char *end, BulkFileLoader::Format format) {
+    const char *controlEnd = lineEnd(begin, end);
+    if (format == BulkFileLoader::Format::DOCUMENTS || isDeleteControl(begin, controlEnd)) {
+        return controlEnd;
+    }
+    // source line follows blank lines, if any
+    const char *source = controlEnd;
+    const char *sourceEnd = lineEnd(source, end);
+    while (sourceEnd != end && isBlank(source, sourceEnd)) {
+        source = sourceEnd;
+        sourceEnd = lineEnd(source, end);
+    }
+    return sourceEnd;
+}
+
+
+BulkFileLoader::Implementation::Implementation(const std::shared_ptr<Client> &client,
+                                               const std::string &indexName,
+                                               const Settings &settings)
+  : client(client), indexName(indexName), settings(settings),
+    urlPath(Bulk::Implementation::urlPathOf(indexName)), control(), mutex(),
+    cursor(nullptr), fileEnd(nullptr), progress(), started(), lastReport(), callbackMutex()
+{
+    if (!client) {
+        throw std::runtime_error("Valid Client instance is required.");
+    }
+    if (!settings.maxDocuments || !settings.workers) {
+        throw std::runtime_error("BulkFileLoader document and worker limits must be positive.");
+    }
+    if (settings.format == Format::DOCUMENTS) {
+        if (indexName.empty()) {
+            throw std::runtime_error("Index name is mandatory argument");
+        }
+        // documents get the same control line, serialize it once
+        appendControl(control, "index", "", settings.docType, "", nullptr);
+        control += '\n';
+    }
+}
+
+
+bool BulkFileLoader::Implementation::nextBatch(Batch &batch) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // skip blank lines between items
+    while (cursor != fileEnd) {
+        const char *next = lineEnd(cursor, fileEnd);
+        if (!isBlank(cursor, next)) {
+            break;
+        }
+        cursor = next;
+    }
+    if (cursor == fileEnd) {
+        return false;
+    }
+
+    batch.begin = cursor;
+    batch.size = 0;
+    std::size_t bytes = 0;
+    while (cursor != fileEnd && batch.size < settings.maxDocuments) {
+        // blank lines between items are not sent, see serialize()
+        const char *line = lineEnd(cursor, fileEnd);
+        if (isBlank(cursor, line)) {
+            cursor = line;
+            continue;
+        }
+        const char *next = bulkFileItemEnd(cursor, fileEnd, settings.format);
+        const std::size_t itemBytes = (next - cursor) + control.size();
+        if (batch.size && settings.maxBytes && bytes + itemBytes > settings.maxBytes) {
+            break;
+        }
+        ++batch.size;
+        bytes += itemBytes;
+        cursor = next;
+    }
+    batch.end = cursor;
+    return true;
+}
+
+
+void BulkFileLoader::Implementation::serialize(const Batch &batch, std::string &body) const {
+    if (settings.format == Format::BULK) {
+        // lines are copied as they are in runs between blank lines
+        const char *run = batch.begin;
+        for (const char *line = batch.begin; line != batch.end; ) {
+            const char *next = lineEnd(line, batch.end);
+            if (isBlank(line, next)) {
+                body.append(run, line);
+                run = next;
+            }
+            line = next;
+        }
+        body.append(run, batch.end);
+    } else {
+        for (const char *line = batch.begin; line != batch.end; ) {
+            const char *next = lineEnd(line, batch.end);
+            if (!isBlank(line, next)) {
+                const char *docEnd = next;
+                while (docEnd != line && (docEnd[-1] == '\n' || docEnd[-1] == '\r')) {
+                    --docEnd;
+                }
+                body += control;
+                body.append(line, docEnd);
+                body += '\n';
+            }
+            line = next;
+        }
+    }
+    // last line of the file may be unterminated
+    if (!body.empty() && body.back() != '\n') {
+        body += '\n';
+    }
+}
+
+
+void BulkFileLoader::Implementation::runWorker() {
+    Bulk bulk(client);
+    bulk.setRetryPolicy(settings.retryPolicy);
+    std::string body;
+    Batch batch;
+    while (nextBatch(batch)) {
+        body.clear();
+        serialize(batch, body);
+        std::size_t errors;
+        try {
+            errors = bulk.impl->runSerialized(body, batch.size, urlPath);
+        } catch (const std::exception &ex) {
+            LOG(LogLevel::ERROR, "Loaded bulk failed: %s", ex.what());
+            errors = batch.size;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            progress.documents += batch.size;
+            progress.errors += errors;
+            progress.bytes += batch.end - batch.begin;
+            ++progress.bulks;
+        }
+        report(false);
+    }
+}
+
+
+void BulkFileLoader::Implementation::report(bool force) {
+    if (!settings.progressCallback) {
+        return;
+    }
+    std::lock_guard<std::mutex> callbackLock(callbackMutex);
+    Progress current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const Clock::time_point now = Clock::now();
+        if (!force && now - lastReport < settings.progressInterval) {
+            return;
+        }
+        lastReport = now;
+        current = progress;
+        current.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - started);
+    }
+    settings.progressCallback(current);
+}
+
+
+BulkFileLoader::Progress BulkFileLoader::Implementation::load(const std::string &path) {
+    const MappedFile file(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cursor = file.begin();
+        fileEnd = file.end();
+        progress = Progress();
+        progress.totalBytes = file.size();
+        started = Clock::now();
+        lastReport = started;
+    }
+    LOG(LogLevel::INFO, "Going to load %lu bytes of %s.", file.size(), path.c_str());
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < settings.workers; ++i) {
+        workers.emplace_back(&Implementation::runWorker, this);
+    }
+    // the calling thread sends bulks as well
+    runWorker();
+    for (std::thread &worker: workers) {
+        worker.join();
+    }
+    report(true);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // the mapping is released on return
+    cursor = fileEnd = nullptr;
+    progress.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            Clock::now() - started);
+    return progress;
+}
+
+
+BulkFileLoader::BulkFileLoader(const std::shared_ptr<Client> &client,
+                               const std::string &indexName,
+                               const Settings &settings)
+  : impl(new Implementation(client, indexName, settings))
+{}
+
+
+BulkFileLoader::~BulkFileLoader() {}
+
+
+BulkFileLoader::Progress BulkFileLoader::load(const std::string &path) {
+    return impl->load(path);
+}
+
+
+BulkFileLoader::Progress BulkFileLoader::getProgress() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    Progress current = impl->progress;
+    if (impl->cursor) {
+        current.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                Implementation::Clock::now() - impl->started);
+    }
+    return current;
+}
+
+
+}  // namespace elasticlient
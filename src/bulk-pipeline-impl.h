@@ -0,0 +1,78 @@
+/**
+ * \file
+ * Implementation of multi-buffered bulk sending.
+ */
+
+#pragma once
+
+#include "elasticlient/bulk-pipeline.h"
+#include "elasticlient/bulk.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace elasticlient {
+
+
+class BulkPipeline::Implementation {
+    /// Client shared by all sender threads.
+    std::shared_ptr<Client> client;
+    const Settings settings;
+
+    /// All buffers, owned by the pipeline.
+    std::vector<std::unique_ptr<SameIndexBulkData>> buffers;
+    /// Buffer being filled, accessed by the producer only.
+    SameIndexBulkData *filling;
+
+    /// Guards all members below.
+    mutable std::mutex mutex;
+    /// Signalled when there is a buffer to be sent or the pipeline is closed.
+    std::condition_variable workAvailable;
+    /// Signalled when a buffer has been sent.
+    std::condition_variable bufferSent;
+    /// Full buffers waiting for sender thread.
+    std::deque<SameIndexBulkData *> full;
+    /// Sent buffers ready to be filled.
+    std::vector<SameIndexBulkData *> free;
+    /// Number of buffers being sent right now.
+    std::size_t inFlight;
+    /// True when sender threads should stop.
+    bool closed;
+
+    std::size_t sentCount;
+    std::size_t errCount;
+    std::size_t bulkCount;
+    std::chrono::microseconds waitTime;
+
+    std::vector<std::thread> senders;
+
+    friend class BulkPipeline;
+
+  public:
+    Implementation(const std::shared_ptr<Client> &client,
+                   const std::string &indexName,
+                   const Settings &settings);
+
+    /// \see BulkPipeline::send
+    void send();
+
+    /// \see BulkPipeline::flush
+    void flush();
+
+    /// Flush and stop sender threads.
+    void close();
+
+  private:
+    /// Body of sender thread.
+    void runSender();
+};
+
+
+}  // namespace elasticlient
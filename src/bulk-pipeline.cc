@@ -0,0 +1,172 @@
+/**
+ * \file
+ * Implementation of multi-buffered bulk sending.
+ */
+
+#include "bulk-pipeline-impl.h"
+
+#include <string>
+#include <stdexcept>
+#include "logging-impl.h"
+
+
+namespace elasticlient {
+
+
+BulkPipeline::Implementation::Implementation(const std::shared_ptr<Client> &client,
+                                             const std::string &indexName,
+                                             const Settings &settings)
+  : client(client), settings(settings), buffers(), filling(nullptr), mutex(),
+    workAvailable(), bufferSent(), full(), free(), inFlight(0), closed(false),
+    sentCount(0), errCount(0), bulkCount(0), waitTime(0), senders()
+{
+    if (!client) {
+        throw std::runtime_error("Valid Client instance is required.");
+    }
+    if (settings.buffers < 2 || !settings.concurrentBulks
+        || settings.concurrentBulks >= settings.buffers || !settings.maxDocuments)
+    {
+        throw std::runtime_error("BulkPipeline requires at least 2 buffers, more than "
+                                 "concurrently sent ones, and positive document limit.");
+    }
+    for (std::size_t i = 0; i < settings.buffers; ++i) {
+        buffers.emplace_back(new SameIndexBulkData(indexName, settings.maxDocuments,
+                                                   settings.maxBytes));
+        free.push_back(buffers.back().get());
+    }
+    filling = free.back();
+    free.pop_back();
+    for (std::size_t i = 0; i < settings.concurrentBulks; ++i) {
+        senders.emplace_back(&Implementation::runSender, this);
+    }
+}
+
+
+void BulkPipeline::Implementation::send() {
+    if (filling->empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    full.push_back(filling);
+    workAvailable.notify_one();
+    if (free.empty()) {
+        const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        bufferSent.wait(lock, [this]() { return !free.empty(); });
+        waitTime += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - started);
+    }
+    filling = free.back();
+    free.pop_back();
+}
+
+
+void BulkPipeline::Implementation::flush() {
+    send();
+    std::unique_lock<std::mutex> lock(mutex);
+    bufferSent.wait(lock, [this]() { return full.empty() && !inFlight; });
+}
+
+
+void BulkPipeline::Implementation::close() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        workAvailable.notify_all();
+    }
+    for (std::thread &sender: senders) {
+        if (sender.joinable()) {
+            sender.join();
+        }
+    }
+}
+
+
+void BulkPipeline::Implementation::runSender() {
+    Bulk bulk(client);
+    bulk.setRetryPolicy(settings.retryPolicy);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workAvailable.wait(lock, [this]() { return closed || !full.empty(); });
+        if (full.empty()) {
+            return;
+        }
+        SameIndexBulkData *data = full.front();
+        full.pop_front();
+        ++inFlight;
+        lock.unlock();
+
+        std::size_t errors;
+        try {
+            errors = bulk.perform(*data);
+        } catch (const std::exception &ex) {
+            LOG(LogLevel::ERROR, "Pipelined bulk failed: %s", ex.what());
+            errors = data->size();
+        }
+        const std::size_t size = data->size();
+        // keep allocated memory for next documents
+        data->clear();
+
+        lock.lock();
+        sentCount += size;
+        errCount += errors;
+        ++bulkCount;
+        free.push_back(data);
+        --inFlight;
+        bufferSent.notify_all();
+    }
+}
+
+
+BulkPipeline::BulkPipeline(const std::shared_ptr<Client> &client,
+                           const std::string &indexName,
+                           const Settings &settings)
+  : impl(new Implementation(client, indexName, settings))
+{}
+
+
+BulkPipeline::~BulkPipeline() {
+    impl->close();
+}
+
+
+SameIndexBulkData &BulkPipeline::current() {
+    return *impl->filling;
+}
+
+
+void BulkPipeline::send() {
+    impl->send();
+}
+
+
+void BulkPipeline::flush() {
+    impl->flush();
+}
+
+
+std::size_t BulkPipeline::getSentCount() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->sentCount;
+}
+
+
+std::size_t BulkPipeline::getErrorCount() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->errCount;
+}
+
+
+std::size_t BulkPipeline::getBulkCount() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->bulkCount;
+}
+
+
+std::chrono::microseconds BulkPipeline::getWaitTime() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->waitTime;
+}
+
+
+}  // namespace elasticlient
@@ -0,0 +1,144 @@
+/**
+ * \file
+ * Implementation of background bulk indexer.
+ */
+
+#pragma once
+
+#include "elasticlient/bulk-processor.h"
+#include "elasticlient/bulk.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace elasticlient {
+
+
+/**
+ * Controller of adaptive bulk size and concurrency (additive increase, multiplicative
+ * decrease), see BulkProcessor.
+ */
+class AdaptiveBulkSizing {
+    const std::size_t minBytes;
+    const std::size_t maxBytes;
+    const std::size_t maxConcurrency;
+    const std::chrono::milliseconds targetLatency;
+    /// Current bulk size limit.
+    std::size_t bytes;
+    /// Current number of concurrently sent bulks.
+    std::size_t concurrency;
+
+  public:
+    AdaptiveBulkSizing(std::size_t minBytes, std::size_t maxBytes, std::size_t maxConcurrency,
+                       std::chrono::milliseconds targetLatency)
+      : minBytes(minBytes), maxBytes(maxBytes), maxConcurrency(maxConcurrency),
+        targetLatency(targetLatency), bytes(minBytes), concurrency(1)
+    {}
+
+    /**
+     * Adjust the limits by bulk of \p bulkBytes sent in \p latency.
+     * \param statistics requests of the bulk, "took" is preferred to latency.
+     */
+    void update(std::size_t bulkBytes, std::chrono::milliseconds latency,
+                const Bulk::Statistics &statistics);
+
+    std::size_t getBytes() const {
+        return bytes;
+    }
+
+    std::size_t getConcurrency() const {
+        return concurrency;
+    }
+};
+
+
+class BulkProcessor::Implementation {
+    typedef std::chrono::steady_clock Clock;
+
+    /// Client shared by all sender threads.
+    std::shared_ptr<Client> client;
+    const std::string indexName;
+    const Settings settings;
+
+    /// Guards all members below.
+    mutable std::mutex mutex;
+    /// Signalled when there is a bulk to be sent or current bulk changed its state.
+    std::condition_variable workAvailable;
+    /// Signalled when a bulk is taken by sender thread or finished.
+    std::condition_variable stateChanged;
+
+    /// Bulk documents are added to.
+    std::unique_ptr<SameIndexBulkData> current;
+    /// Time the first document of current bulk was added.
+    Clock::time_point currentStarted;
+    /// Full bulks waiting for sender thread.
+    std::deque<std::unique_ptr<SameIndexBulkData>> pending;
+    /// Sent bulks kept for reuse of their allocated memory.
+    std::vector<std::unique_ptr<SameIndexBulkData>> spare;
+    /// Number of bulks being sent right now.
+    std::size_t inFlight;
+    /// True when no more documents are accepted.
+    bool closed;
+
+    std::size_t sentCount;
+    std::size_t errCount;
+    std::size_t bulkCount;
+
+    /// Adaptive limits, used if enabled by settings.
+    AdaptiveBulkSizing sizing;
+
+    std::vector<std::thread> senders;
+
+    friend class BulkProcessor;
+
+  public:
+    Implementation(const std::shared_ptr<Client> &client,
+                   const std::string &indexName,
+                   const Settings &settings);
+
+    /**
+     * Add document to current bulk.
+     * \param wait whether to wait for space in queue of full bulks.
+     * \return false if the document has not been added.
+     */
+    bool add(const std::string &docType,
+             const std::string &id,
+             const std::string &doc,
+             Action action,
+             bool wait);
+
+    /// \see BulkProcessor::flush
+    void flush();
+
+    /// \see BulkProcessor::close
+    void close();
+
+  private:
+    /// Return true if current bulk has reached its flush limit (mutex locked).
+    bool isCurrentFull() const;
+
+    /// Return true if current bulk waits longer than linger interval (mutex locked).
+    bool isCurrentExpired(Clock::time_point now) const;
+
+    /// Return current bulk size limit in bytes, 0 for no limit (mutex locked).
+    std::size_t targetBytes() const;
+
+    /// Return current number of concurrently sent bulks (mutex locked).
+    std::size_t targetConcurrency() const;
+
+    /// Move current bulk to queue of full bulks and start new one (mutex locked).
+    void seal();
+
+    /// Body of sender thread.
+    void runSender();
+};
+
+
+}  // namespace elasticlient
@@ -0,0 +1,334 @@
+/**
+ * \file
+ * Implementation of the background bulk indexer.
+ */
+
+#include "bulk-processor-impl.h"
+
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include "logging-impl.h"
+
+
+namespace elasticlient {
+
+
+BulkProcessor::Implementation::Implementation(const std::shared_ptr<Client> &client,
+                                              const std::string &indexName,
+                                              const Settings &settings)
+  : client(client), indexName(indexName), settings(settings), mutex(),
+    workAvailable(), stateChanged(),
+    current(new SameIndexBulkData(indexName, settings.maxDocuments, settings.maxBytes)),
+    currentStarted(), pending(), spare(), inFlight(0), closed(false),
+    sentCount(0), errCount(0), bulkCount(0),
+    sizing(settings.minBytes, settings.maxBytes, settings.concurrentBulks,
+           settings.targetLatency),
+    senders()
+{
+    if (!client) {
+        throw std::runtime_error("Valid Client instance is required.");
+    }
+    if (!settings.maxDocuments || !settings.concurrentBulks || !settings.maxPendingBulks) {
+        throw std::runtime_error("BulkProcessor document, bulk and queue limits "
+                                 "must be positive.");
+    }
+    if (settings.adaptive
+        && (!settings.minBytes || settings.minBytes > settings.maxBytes))
+    {
+        throw std::runtime_error("Adaptive BulkProcessor requires 0 < minBytes <= maxBytes.");
+    }
+    for (std::size_t i = 0; i < settings.concurrentBulks; ++i) {
+        senders.emplace_back(&Implementation::runSender, this);
+    }
+}
+
+
+void AdaptiveBulkSizing::update(std::size_t bulkBytes,
+                                std::chrono::milliseconds latency,
+                                const Bulk::Statistics &statistics)
+{
+    if (statistics.rejectedItems) {
+        // write queues of the cluster are full, back off quickly
+        bytes = std::max(minBytes, bytes / 2);
+        concurrency = std::max<std::size_t>(1, concurrency / 2);
+        return;
+    }
+
+    // processing time reported by Elasticsearch does not include transfer of the body
+    std::chrono::milliseconds processing = latency;
+    if (statistics.took.count() && statistics.requests) {
+        processing = statistics.took / statistics.requests;
+    }
+    if (processing > targetLatency) {
+        bytes = std::max(minBytes, bytes - bytes / 4);
+        return;
+    }
+
+    // only full bulks tell the cluster could take more
+    if (bulkBytes < bytes) {
+        return;
+    }
+    if (bytes < maxBytes) {
+        bytes = std::min(maxBytes, bytes + std::max<std::size_t>(1, (maxBytes - minBytes) / 8));
+    } else if (concurrency < maxConcurrency) {
+        ++concurrency;
+    }
+}
+
+
+bool BulkProcessor::Implementation::isCurrentFull() const {
+    const std::size_t maxBytes = targetBytes();
+    return current->size() >= settings.maxDocuments
+        || (maxBytes && current->byteSize() >= maxBytes);
+}
+
+
+std::size_t BulkProcessor::Implementation::targetBytes() const {
+    return settings.adaptive ? sizing.getBytes() : settings.maxBytes;
+}
+
+
+std::size_t BulkProcessor::Implementation::targetConcurrency() const {
+    return settings.adaptive ? sizing.getConcurrency() : settings.concurrentBulks;
+}
+
+
+bool BulkProcessor::Implementation::isCurrentExpired(Clock::time_point now) const {
+    return settings.linger.count() && now - currentStarted >= settings.linger;
+}
+
+
+void BulkProcessor::Implementation::seal() {
+    pending.push_back(std::move(current));
+    if (spare.empty()) {
+        current.reset(new SameIndexBulkData(indexName, settings.maxDocuments,
+                                            settings.maxBytes));
+    } else {
+        current = std::move(spare.back());
+        spare.pop_back();
+    }
+    workAvailable.notify_one();
+}
+
+
+bool BulkProcessor::Implementation::add(const std::string &docType,
+                                        const std::string &id,
+                                        const std::string &doc,
+                                        Action action,
+                                        bool wait)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (closed) {
+            throw std::runtime_error("BulkProcessor is closed.");
+        }
+        if (!isCurrentFull()) {
+            break;
+        }
+        if (pending.size() < settings.maxPendingBulks) {
+            seal();
+            break;
+        }
+        if (!wait) {
+            return false;
+        }
+        stateChanged.wait(lock);
+    }
+
+    switch (action) {
+        case Action::INDEX:
+            current->indexDocument(docType, id, doc, true);
+            break;
+        case Action::CREATE:
+            current->createDocument(docType, id, doc, true);
+            break;
+        case Action::UPDATE:
+            current->updateDocument(docType, id, doc, true);
+            break;
+        case Action::DELETE:
+            current->deleteDocument(docType, id);
+            break;
+    }
+
+    if (current->size() == 1) {
+        currentStarted = Clock::now();
+        if (settings.linger.count()) {
+            // let sender threads know when to flush this bulk
+            workAvailable.notify_all();
+        }
+    }
+    if (isCurrentFull() && pending.size() < settings.maxPendingBulks) {
+        seal();
+    }
+    return true;
+}
+
+
+void BulkProcessor::Implementation::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (!current->empty()) {
+            if (pending.size() < settings.maxPendingBulks) {
+                seal();
+                continue;
+            }
+        } else if (pending.empty() && !inFlight) {
+            return;
+        }
+        stateChanged.wait(lock);
+    }
+}
+
+
+void BulkProcessor::Implementation::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        workAvailable.notify_all();
+        // wake up producers waiting for space, so they fail
+        stateChanged.notify_all();
+    }
+    // sender threads send the rest of documents before they finish
+    for (std::thread &sender: senders) {
+        if (sender.joinable()) {
+            sender.join();
+        }
+    }
+}
+
+
+void BulkProcessor::Implementation::runSender() {
+    Bulk bulk(client);
+    bulk.setRetryPolicy(settings.retryPolicy);
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (pending.empty() && !current->empty()
+            && (closed || isCurrentFull() || isCurrentExpired(Clock::now())))
+        {
+            seal();
+        }
+
+        if (!pending.empty() && inFlight < targetConcurrency()) {
+            std::unique_ptr<SameIndexBulkData> data = std::move(pending.front());
+            pending.pop_front();
+            ++inFlight;
+            stateChanged.notify_all();
+            if (pending.empty() && !current->empty() && settings.linger.count()) {
+                // senders may seal current bulk once its linger expires
+                workAvailable.notify_all();
+            }
+            lock.unlock();
+
+            std::size_t errors;
+            const Clock::time_point started = Clock::now();
+            try {
+                errors = bulk.perform(*data);
+            } catch (const std::exception &ex) {
+                LOG(LogLevel::ERROR, "Background bulk failed: %s", ex.what());
+                errors = data->size();
+            }
+            const std::chrono::milliseconds latency =
+                    std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - started);
+
+            lock.lock();
+            sentCount += data->size();
+            errCount += errors;
+            ++bulkCount;
+            if (settings.adaptive) {
+                sizing.update(data->byteSize(), latency, bulk.getStatistics());
+            }
+            data->clear();
+            spare.push_back(std::move(data));
+            --inFlight;
+            stateChanged.notify_all();
+            // let senders held by concurrency limit go
+            workAvailable.notify_all();
+            continue;
+        }
+
+        if (closed && pending.empty()) {
+            return;
+        }
+        // linger matters only while current bulk can be sealed, senders held by
+        // concurrency limit are woken up by finished bulks
+        if (pending.empty() && !current->empty() && settings.linger.count()) {
+            workAvailable.wait_until(lock, currentStarted + settings.linger);
+        } else {
+            workAvailable.wait(lock);
+        }
+    }
+}
+
+
+BulkProcessor::BulkProcessor(const std::shared_ptr<Client> &client,
+                             const std::string &indexName,
+                             const Settings &settings)
+  : impl(new Implementation(client, indexName, settings))
+{}
+
+
+BulkProcessor::~BulkProcessor() {
+    impl->close();
+}
+
+
+void BulkProcessor::add(const std::string &docType,
+                        const std::string &id,
+                        const std::string &doc,
+                        Action action)
+{
+    impl->add(docType, id, doc, action, true);
+}
+
+
+bool BulkProcessor::tryAdd(const std::string &docType,
+                           const std::string &id,
+                           const std::string &doc,
+                           Action action)
+{
+    return impl->add(docType, id, doc, action, false);
+}
+
+
+void BulkProcessor::flush() {
+    impl->flush();
+}
+
+
+void BulkProcessor::close() {
+    impl->close();
+}
+
+
+std::size_t BulkProcessor::getSentCount() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->sentCount;
+}
+
+
+std::size_t BulkProcessor::getErrorCount() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->errCount;
+}
+
+
+std::size_t BulkProcessor::getBulkCount() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->bulkCount;
+}
+
+
+std::size_t BulkProcessor::getTargetBytes() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->targetBytes();
+}
+
+
+std::size_t BulkProcessor::getTargetConcurrency() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->targetConcurrency();
+}
+
+
+}  // namespace elasticlient
@@ -0,0 +1,174 @@
+/**
+ * \file
+ * Scanner of Elasticsearch bulk responses.
+ */
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+
+namespace elasticlient {
+
+
+/// Fields of one item of bulk response needed to check its result.
+struct BulkItemResponse {
+    /// Action of the item (index, create, update, delete).
+    std::string action;
+    /// Document ID.
+    std::string id;
+    /// HTTP status of the item, 500 if missing.
+    int status;
+    /// False if status is present, but it is not a number.
+    bool statusValid;
+    /// Error type, empty for no error.
+    std::string errorType;
+    /// Error reason, empty for no error.
+    std::string errorReason;
+
+    BulkItemResponse()
+      : action(), id(), status(500), statusValid(true), errorType(), errorReason()
+    {}
+
+    /// Clear fields, keeping memory of the strings.
+    void clear() {
+        action.clear();
+        id.clear();
+        status = 500;
+        statusValid = true;
+        errorType.clear();
+        errorReason.clear();
+    }
+};
+
+
+/// Fields of bulk request control line needed to route the item.
+struct BulkControlLine {
+    /// Action of the item (index, create, update, delete).
+    std::string action;
+    /// Index name, empty if not present.
+    std::string indexName;
+    /// Document ID, empty if not present.
+    std::string id;
+    /// Routing value, empty if not present.
+    std::string routing;
+
+    /// Clear fields, keeping memory of the strings.
+    void clear() {
+        action.clear();
+        indexName.clear();
+        id.clear();
+        routing.clear();
+    }
+};
+
+
+/**
+ * Incremental scanner of bulk response. Reads top level members of the response
+ * until "errors": false or "items" array is found, then reads items one by one
+ * extracting only fields of BulkItemResponse. Other values are skipped without
+ * building any document tree. Rest of the response after last read value is not
+ * validated.
+ */
+class BulkResponseScanner {
+  public:
+    /// State of the response found by start().
+    enum class Start {
+        /// Response is not valid JSON object.
+        INVALID,
+        /// Response has "errors": false (only when requested to stop on it).
+        NO_ERRORS,
+        /// Items array follows, read them by nextItem().
+        ITEMS,
+        /// Response has no "items" member.
+        NO_ITEMS,
+        /// Member "items" is not an array.
+        ITEMS_NOT_ARRAY
+    };
+
+    /// Create scanner of \p response, which must outlive the scanner.
+    explicit BulkResponseScanner(const std::string &response)
+      : pos(response.data()), end(response.data() + response.size()), isValid(true),
+        firstItem(true), tookMs(-1)
+    {}
+
+    /// Create scanner of text from \p begin up to \p end, which must outlive the scanner.
+    BulkResponseScanner(const char *begin, const char *end)
+      : pos(begin), end(end), isValid(true), firstItem(true), tookMs(-1)
+    {}
+
+    /**
+     * Read response up to the items array.
+     * \param stopOnNoErrors return NO_ERRORS as soon as "errors": false is read.
+     */
+    Start start(bool stopOnNoErrors);
+
+    /**
+     * Read next item of items array into \p item. Action of item which is not
+     * an object with action result object is left empty.
+     * \return false at the end of items array or on syntax error (see valid()).
+     */
+    bool nextItem(BulkItemResponse &item);
+
+    /**
+     * Read bulk request control line, i.e. object with single action object
+     * (the same shape as item of the response), into \p control.
+     * \return false on syntax error.
+     */
+    bool readControlLine(BulkControlLine &control);
+
+    /// Return false if syntax error has been found.
+    bool valid() const {
+        return isValid;
+    }
+
+    /// Return processing time reported in "took" member read by start(), -1 if not read.
+    int took() const {
+        return tookMs;
+    }
+
+  private:
+    /// Skip whitespace, return false at the end of input.
+    bool skipWhitespace();
+
+    /// Consume \p c (after whitespace), return false if other char follows.
+    bool consume(char c);
+
+    /// Read string value into \p out (if not nullptr), decoding escapes.
+    bool readString(std::string *out);
+
+    /// Read object key (not decoded) and following colon.
+    bool readKey(const char *&keyStart, std::size_t &keyLength);
+
+    /// Read number value as integer, clamped to range of int.
+    bool readInt(int &value);
+
+    /// Skip any value, nested at most \p depth levels.
+    bool skipValue(int depth = 64);
+
+    /// Skip literal \p literal (true, false, null).
+    bool skipLiteral(const char *literal);
+
+    /// Read members of "error" object (or string in old Elasticsearch versions).
+    bool readError(BulkItemResponse &item);
+
+    /// Read object of action result.
+    bool readActionResult(BulkItemResponse &item);
+
+    /// Mark input invalid, return false.
+    bool fail() {
+        isValid = false;
+        return false;
+    }
+
+    const char *pos;
+    const char *end;
+    bool isValid;
+    /// True until first item is read.
+    bool firstItem;
+    int tookMs;
+};
+
+
+}  // namespace elasticlient
@@ -0,0 +1,459 @@
+/**
+ * \file
+ * Implementation of the bulk response scanner.
+ */
+
+#include "bulk-response-impl.h"
+
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+
+namespace {
+
+
+/// Return true if \p key of \p length equals to \p literal.
+bool keyEquals(const char *key, std::size_t length, const char *literal) {
+    return std::strlen(literal) == length && std::memcmp(key, literal, length) == 0;
+}
+
+
+/// Return value of hex digit \p c, -1 if it is not a hex digit.
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+
+/// Append \p codePoint encoded in UTF-8 to \p out.
+void appendUtf8(std::string &out, unsigned codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+
+} // anonymous namespace
+
+
+namespace elasticlient {
+
+
+bool BulkResponseScanner::skipWhitespace() {
+    while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) {
+        ++pos;
+    }
+    return pos < end;
+}
+
+
+bool BulkResponseScanner::consume(char c) {
+    if (!skipWhitespace() || *pos != c) {
+        return false;
+    }
+    ++pos;
+    return true;
+}
+
+
+bool BulkResponseScanner::readString(std::string *out) {
+    if (!consume('"')) {
+        return fail();
+    }
+    while (true) {
+        const char *chunk = pos;
+        while (pos < end && *pos != '"' && *pos != '\\') {
+            ++pos;
+        }
+        if (out) {
+            out->append(chunk, pos - chunk);
+        }
+        if (pos == end) {
+            return fail();
+        }
+        if (*pos++ == '"') {
+            return true;
+        }
+
+        // escape sequence
+        if (pos == end) {
+            return fail();
+        }
+        char c = *pos++;
+        switch (c) {
+            case '"': case '\\': case '/':
+                break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case 'u': {
+                unsigned codePoint = 0;
+                for (int i = 0; i < 4; ++i) {
+                    const int digit = (pos < end) ? hexValue(*pos++) : -1;
+                    if (digit < 0) {
+                        return fail();
+                    }
+                    codePoint = (codePoint << 4) | digit;
+                }
+                // surrogate pair
+                if (codePoint >= 0xD800 && codePoint < 0xDC00
+                    && end - pos >= 6 && pos[0] == '\\' && pos[1] == 'u')
+                {
+                    unsigned low = 0;
+                    for (int i = 2; i < 6 && hexValue(pos[i]) >= 0; ++i) {
+                        low = (low << 4) | hexValue(pos[i]);
+                    }
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        pos += 6;
+                    }
+                }
+                if (out) {
+                    appendUtf8(*out, codePoint);
+                }
+                continue;
+            }
+            default:
+                return fail();
+        }
+        if (out) {
+            *out += c;
+        }
+    }
+}
+
+
+bool BulkResponseScanner::readKey(const char *&keyStart, std::size_t &keyLength) {
+    if (!consume('"')) {
+        return fail();
+    }
+    keyStart = pos;
+    while (pos < end && *pos != '"') {
+        if (*pos == '\\' && ++pos == end) {
+            return fail();
+        }
+        ++pos;
+    }
+    if (pos == end) {
+        return fail();
+    }
+    keyLength = pos - keyStart;
+    ++pos;
+    return consume(':') || fail();
+}
+
+
+bool BulkResponseScanner::readInt(int &value) {
+    if (!skipWhitespace()) {
+        return fail();
+    }
+    const bool negative = *pos == '-';
+    if (negative) {
+        ++pos;
+    }
+    if (pos == end || *pos < '0' || *pos > '9') {
+        return fail();
+    }
+    // out of range values saturate
+    long long number = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+        number = std::min<long long>(number * 10 + (*pos - '0'), INT_MAX);
+        ++pos;
+    }
+    // fraction and exponent are ignored
+    while (pos < end && (*pos == '.' || *pos == 'e' || *pos == 'E' || *pos == '+'
+                         || *pos == '-' || (*pos >= '0' && *pos <= '9')))
+    {
+        ++pos;
+    }
+    value = static_cast<int>(negative ? -number : number);
+    return true;
+}
+
+
+bool BulkResponseScanner::skipLiteral(const char *literal) {
+    const std::size_t length = std::strlen(literal);
+    if (static_cast<std::size_t>(end - pos) < length || std::memcmp(pos, literal, length) != 0) {
+        return fail();
+    }
+    pos += length;
+    return true;
+}
+
+
+bool BulkResponseScanner::skipValue(int depth) {
+    if (!skipWhitespace() || depth == 0) {
+        return fail();
+    }
+    const char *key;
+    std::size_t keyLength;
+    switch (*pos) {
+        case '"':
+            return readString(nullptr);
+        case '{':
+            ++pos;
+            if (consume('}')) {
+                return true;
+            }
+            do {
+                if (!readKey(key, keyLength) || !skipValue(depth - 1)) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume('}') || fail();
+        case '[':
+            ++pos;
+            if (consume(']')) {
+                return true;
+            }
+            do {
+                if (!skipValue(depth - 1)) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']') || fail();
+        case 't':
+            return skipLiteral("true");
+        case 'f':
+            return skipLiteral("false");
+        case 'n':
+            return skipLiteral("null");
+        default:
+            int number;
+            return readInt(number);
+    }
+}
+
+
+BulkResponseScanner::Start BulkResponseScanner::start(bool stopOnNoErrors) {
+    if (!consume('{')) {
+        fail();
+        return Start::INVALID;
+    }
+    if (consume('}')) {
+        return Start::NO_ITEMS;
+    }
+    bool noErrors = false;
+    bool itemsNotArray = false;
+    const char *key;
+    std::size_t keyLength;
+    do {
+        if (!readKey(key, keyLength) || !skipWhitespace()) {
+            fail();
+            return Start::INVALID;
+        }
+        if (keyEquals(key, keyLength, "errors") && *pos == 'f') {
+            if (!skipLiteral("false")) {
+                return Start::INVALID;
+            }
+            noErrors = true;
+            if (stopOnNoErrors) {
+                return Start::NO_ERRORS;
+            }
+            continue;
+        }
+        if (keyEquals(key, keyLength, "took") && (*pos >= '0' && *pos <= '9')) {
+            if (!readInt(tookMs)) {
+                return Start::INVALID;
+            }
+            continue;
+        }
+        if (keyEquals(key, keyLength, "items")) {
+            if (*pos == '[') {
+                ++pos;
+                return Start::ITEMS;
+            }
+            itemsNotArray = true;
+        }
+        if (!skipValue()) {
+            return Start::INVALID;
+        }
+    } while (consume(','));
+
+    if (!consume('}')) {
+        fail();
+        return Start::INVALID;
+    }
+    if (itemsNotArray) {
+        return Start::ITEMS_NOT_ARRAY;
+    }
+    return noErrors ? Start::NO_ERRORS : Start::NO_ITEMS;
+}
+
+
+bool BulkResponseScanner::readError(BulkItemResponse &item) {
+    if (!skipWhitespace()) {
+        return fail();
+    }
+    if (*pos == '"') {
+        // old Elasticsearch versions report error as string
+        return readString(&item.errorReason);
+    }
+    if (*pos != '{') {
+        return skipValue();
+    }
+    ++pos;
+    if (consume('}')) {
+        return true;
+    }
+    const char *key;
+    std::size_t keyLength;
+    do {
+        if (!readKey(key, keyLength) || !skipWhitespace()) {
+            return fail();
+        }
+        bool read;
+        if (*pos == '"' && keyEquals(key, keyLength, "type")) {
+            read = readString(&item.errorType);
+        } else if (*pos == '"' && keyEquals(key, keyLength, "reason")) {
+            read = readString(&item.errorReason);
+        } else {
+            read = skipValue();
+        }
+        if (!read) {
+            return false;
+        }
+    } while (consume(','));
+    return consume('}') || fail();
+}
+
+
+bool BulkResponseScanner::readActionResult(BulkItemResponse &item) {
+    if (!consume('{')) {
+        return fail();
+    }
+    if (consume('}')) {
+        return true;
+    }
+    const char *key;
+    std::size_t keyLength;
+    do {
+        if (!readKey(key, keyLength) || !skipWhitespace()) {
+            return fail();
+        }
+        bool read;
+        if (keyEquals(key, keyLength, "_id") && *pos == '"') {
+            read = readString(&item.id);
+        } else if (keyEquals(key, keyLength, "status")) {
+            if (*pos == '-' || (*pos >= '0' && *pos <= '9')) {
+                read = readInt(item.status);
+            } else {
+                item.statusValid = false;
+                read = skipValue();
+            }
+        } else if (keyEquals(key, keyLength, "error")) {
+            read = readError(item);
+        } else {
+            read = skipValue();
+        }
+        if (!read) {
+            return false;
+        }
+    } while (consume(','));
+    return consume('}') || fail();
+}
+
+
+bool BulkResponseScanner::nextItem(BulkItemResponse &item) {
+    if (!isValid) {
+        return false;
+    }
+    if (consume(']')) {
+        return false;
+    }
+    if (!firstItem && !consume(',')) {
+        return fail();
+    }
+    firstItem = false;
+
+    item.clear();
+    if (!skipWhitespace()) {
+        return fail();
+    }
+    if (*pos != '{') {
+        return skipValue();
+    }
+    ++pos;
+    if (consume('}')) {
+        return true;
+    }
+    const char *key;
+    std::size_t keyLength;
+    if (!readKey(key, keyLength) || !skipWhitespace()) {
+        return fail();
+    }
+    if (*pos == '{') {
+        item.action.assign(key, keyLength);
+        if (!readActionResult(item)) {
+            return false;
+        }
+    } else if (!skipValue()) {
+        return false;
+    }
+    // single action is expected, skip the rest
+    while (consume(',')) {
+        if (!readKey(key, keyLength) || !skipValue()) {
+            return false;
+        }
+    }
+    return consume('}') || fail();
+}
+
+
+bool BulkResponseScanner::readControlLine(BulkControlLine &control) {
+    control.clear();
+    const char *key;
+    std::size_t keyLength;
+    if (!consume('{') || !readKey(key, keyLength) || !consume('{')) {
+        return fail();
+    }
+    control.action.assign(key, keyLength);
+    if (consume('}')) {
+        return consume('}') || fail();
+    }
+    do {
+        if (!readKey(key, keyLength) || !skipWhitespace()) {
+            return fail();
+        }
+        bool read;
+        if (*pos == '"' && keyEquals(key, keyLength, "_index")) {
+            read = readString(&control.indexName);
+        } else if (*pos == '"' && keyEquals(key, keyLength, "_id")) {
+            read = readString(&control.id);
+        } else if (*pos == '"' && (keyEquals(key, keyLength, "routing")
+                                   || keyEquals(key, keyLength, "_routing")))
+        {
+            read = readString(&control.routing);
+        } else {
+            read = skipValue();
+        }
+        if (!read) {
+            return false;
+        }
+    } while (consume(','));
+    return (consume('}') && consume('}')) || fail();
+}
+
+
+}  // namespace elasticlient
@@ -0,0 +1,119 @@
+/**
+ * \file
+ * Implementation of client-side shard routing of bulk items.
+ */
+
+#pragma once
+
+#include "elasticlient/bulk-router.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+
+namespace elasticlient {
+
+
+/**
+ * Return Elasticsearch routing hash of \p routing, i.e. murmur3 (x86, 32 bit, seed 0)
+ * of UTF-16LE code units of the value.
+ */
+std::int32_t routingHash(const std::string &routing);
+
+
+/// Routing of one index read from cluster state.
+struct IndexRouting {
+    /// Number of primary shards.
+    std::uint32_t numberOfShards;
+    /// Number of shards the hash space is split into (index.routing_num_shards).
+    std::uint32_t routingNumShards;
+    /// Number of shards custom routing value routes to (index.routing_partition_size).
+    std::uint32_t partitionSize;
+    /// ID of node holding primary of each shard, empty if the primary is not assigned.
+    std::vector<std::string> primaryNodes;
+    /// False if the routing could not be read.
+    bool valid;
+    /// Time the routing was read at.
+    std::chrono::steady_clock::time_point fetched;
+
+    IndexRouting()
+      : numberOfShards(0), routingNumShards(0), partitionSize(1), primaryNodes(),
+        valid(false), fetched()
+    {}
+
+    /// Return shard document \p id with \p routing value (may be empty) is stored in.
+    std::uint32_t shardOf(const std::string &id, const std::string &routing) const;
+};
+
+
+/// Items of the bulk routed to the same shard or node.
+struct RoutedGroup {
+    /// Serialized items.
+    std::string body;
+    /// Positions of the items in the original bulk.
+    std::vector<std::size_t> positions;
+    /// Client of node the group is sent to, null for Client of the Bulk.
+    std::shared_ptr<Client> client;
+};
+
+
+class BulkShardRouter::Implementation {
+    std::shared_ptr<Client> client;
+    const Settings settings;
+
+    /// Guards all members below, it is not held while cluster state is being read.
+    std::mutex mutex;
+    /// Cached routing of indices (or aliases) by name, replaced as a whole when read again.
+    std::map<std::string, std::shared_ptr<const IndexRouting>> indices;
+    /// HTTP URLs of nodes by node ID.
+    std::map<std::string, std::string> nodeUrls;
+    /// Time nodeUrls were read at.
+    std::chrono::steady_clock::time_point nodesFetched;
+    /// Clients of nodes by URL, kept over refreshes of routing.
+    std::map<std::string, std::shared_ptr<Client>> nodeClients;
+
+    friend class BulkShardRouter;
+
+  public:
+    Implementation(const std::shared_ptr<Client> &client, const Settings &settings);
+
+    /**
+     * Split serialized bulk \p body into groups of items of the same shard or node.
+     * \param indexName index of items without index in control line.
+     * \return groups in order of their first items; items which can not be routed
+     *         are in the group without node Client.
+     */
+    std::vector<RoutedGroup> partition(const std::string &body, const std::string &indexName);
+
+    /// \see BulkShardRouter::invalidate
+    void invalidate();
+
+  private:
+    /**
+     * Return cached routing of \p indexName, read it if needed. The mutex, locked
+     * by \p lock, is released while routing is being read; other threads use
+     * the stale routing meanwhile.
+     */
+    std::shared_ptr<const IndexRouting> routingOf(const std::string &indexName,
+                                                  std::unique_lock<std::mutex> &lock);
+
+    /// Read routing of \p indexName from cluster state.
+    IndexRouting fetchRouting(const std::string &indexName);
+
+    /**
+     * Return Client of node \p nodeId, null if its address is unknown. The mutex,
+     * locked by \p lock, is released while node addresses are being read.
+     */
+    std::shared_ptr<Client> nodeClient(const std::string &nodeId,
+                                       std::unique_lock<std::mutex> &lock);
+
+    /// Read HTTP addresses of nodes into \p urls, return false on failure.
+    bool fetchNodes(std::map<std::string, std::string> &urls);
+};
+
+
+}  // namespace elasticlient
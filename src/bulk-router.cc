@@ -0,0 +1,448 @@
+/**
+ * \file
+ * Implementation of client-side shard routing of bulk items.
+ */
+
+#include "bulk-router-impl.h"
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <json/json.h>
+#include <cpr/response.h>
+#include "bulk-impl.h"
+#include "bulk-response-impl.h"
+#include "logging-impl.h"
+
+
+namespace {
+
+
+/// Routing which could not be read is read again after this time at the latest.
+const std::chrono::seconds failedRefreshInterval(10);
+
+
+/// Incremental murmur3 (x86, 32 bit, seed 0) of 16 bit code units.
+class Murmur3 {
+  public:
+    Murmur3(): hash(0), block(0), length(0) {}
+
+    /// Hash code unit \p unit as two bytes in little endian.
+    void add(std::uint16_t unit) {
+        if (length & 2) {
+            mix(block | (static_cast<std::uint32_t>(unit) << 16));
+        } else {
+            block = unit;
+        }
+        length += 2;
+    }
+
+    /// Return hash of all added code units.
+    std::int32_t finish() {
+        std::uint32_t h = hash;
+        if (length & 2) {
+            std::uint32_t k = block * 0xcc9e2d51;
+            k = rotate(k, 15) * 0x1b873593;
+            h ^= k;
+        }
+        h ^= length;
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        return static_cast<std::int32_t>(h);
+    }
+
+  private:
+    static std::uint32_t rotate(std::uint32_t x, int bits) {
+        return (x << bits) | (x >> (32 - bits));
+    }
+
+    void mix(std::uint32_t k) {
+        k *= 0xcc9e2d51;
+        k = rotate(k, 15) * 0x1b873593;
+        hash ^= k;
+        hash = rotate(hash, 13) * 5 + 0xe6546b64;
+    }
+
+    std::uint32_t hash;
+    /// Code unit waiting for the second half of 4 byte block.
+    std::uint32_t block;
+    /// Number of bytes added.
+    std::uint32_t length;
+};
+
+
+/// Return \p value modulo \p divisor rounded towards negative infinity (Java Math.floorMod).
+std::uint32_t floorMod(std::int32_t value, std::uint32_t divisor) {
+    std::int64_t result = static_cast<std::int64_t>(value) % divisor;
+    return static_cast<std::uint32_t>(result < 0 ? result + divisor : result);
+}
+
+
+/// Return unsigned value of setting \p value (settings are strings), 0 if invalid.
+std::uint32_t settingValue(const Json::Value &value) {
+    if (value.isString()) {
+        return static_cast<std::uint32_t>(std::strtoul(value.asCString(), nullptr, 10));
+    }
+    return value.isUInt() ? value.asUInt() : 0;
+}
+
+
+} // anonymous namespace
+
+
+namespace elasticlient {
+
+
+std::int32_t routingHash(const std::string &routing) {
+    Murmur3 murmur;
+    const unsigned char *pos = reinterpret_cast<const unsigned char *>(routing.data());
+    const unsigned char *end = pos + routing.size();
+    while (pos < end) {
+        // decode UTF-8 sequence, invalid bytes are replaced by U+FFFD as Java does
+        std::uint32_t codePoint = *pos++;
+        int continuation = 0;
+        if (codePoint >= 0xF0 && codePoint < 0xF5) {
+            codePoint &= 0x07;
+            continuation = 3;
+        } else if (codePoint >= 0xE0 && codePoint < 0xF0) {
+            codePoint &= 0x0F;
+            continuation = 2;
+        } else if (codePoint >= 0xC2 && codePoint < 0xE0) {
+            codePoint &= 0x1F;
+            continuation = 1;
+        } else if (codePoint >= 0x80) {
+            codePoint = 0xFFFD;
+        }
+        for (; continuation && pos < end && (*pos & 0xC0) == 0x80; --continuation) {
+            codePoint = (codePoint << 6) | (*pos++ & 0x3F);
+        }
+        if (continuation) {
+            codePoint = 0xFFFD;
+        }
+
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            murmur.add(static_cast<std::uint16_t>(0xD800 + (codePoint >> 10)));
+            murmur.add(static_cast<std::uint16_t>(0xDC00 + (codePoint & 0x3FF)));
+        } else {
+            murmur.add(static_cast<std::uint16_t>(codePoint));
+        }
+    }
+    return murmur.finish();
+}
+
+
+std::uint32_t IndexRouting::shardOf(const std::string &id, const std::string &routing) const {
+    // OperationRouting.calculateScaledShardId() of Elasticsearch
+    std::uint32_t hash = static_cast<std::uint32_t>(routingHash(routing.empty() ? id : routing));
+    if (!routing.empty() && partitionSize > 1) {
+        hash += floorMod(routingHash(id), partitionSize);
+    }
+    const std::uint32_t routingFactor = routingNumShards / numberOfShards;
+    return floorMod(static_cast<std::int32_t>(hash), routingNumShards) / routingFactor;
+}
+
+
+BulkShardRouter::BulkShardRouter(const std::shared_ptr<Client> &client,
+                                 const Settings &settings)
+  : impl(new Implementation(client, settings))
+{}
+
+
+BulkShardRouter::~BulkShardRouter() {}
+
+
+std::uint32_t BulkShardRouter::shardOf(const std::string &indexName,
+                                       const std::string &id,
+                                       const std::string &routing)
+{
+    std::unique_lock<std::mutex> lock(impl->mutex);
+    const std::shared_ptr<const IndexRouting> indexRouting = impl->routingOf(indexName, lock);
+    lock.unlock();
+    if (!indexRouting->valid) {
+        throw std::runtime_error("Routing of index " + indexName + " can not be read.");
+    }
+    return indexRouting->shardOf(id, routing);
+}
+
+
+void BulkShardRouter::invalidate() {
+    impl->invalidate();
+}
+
+
+BulkShardRouter::Implementation::Implementation(const std::shared_ptr<Client> &client,
+                                                const Settings &settings)
+  : client(client), settings(settings), mutex(), indices(), nodeUrls(), nodesFetched(),
+    nodeClients()
+{
+    if (!client) {
+        throw std::runtime_error("Valid Client instance is required.");
+    }
+}
+
+
+void BulkShardRouter::Implementation::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex);
+    indices.clear();
+    nodeUrls.clear();
+    nodesFetched = std::chrono::steady_clock::time_point();
+}
+
+
+std::vector<RoutedGroup> BulkShardRouter::Implementation::partition(
+        const std::string &body, const std::string &indexName)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const std::vector<std::pair<std::size_t, std::size_t>> items = splitBulkItems(body);
+    std::vector<RoutedGroup> groups;
+    // group by shard ("index\nshard") or node ID, empty key for items not routed
+    std::map<std::string, std::size_t> groupOf;
+    // items with auto-generated ID may go to any group
+    std::vector<std::size_t> anyGroup;
+    BulkControlLine control;
+    std::string key;
+    // routing of indices used by this bulk, kept even if the cache is refreshed meanwhile
+    std::map<std::string, std::shared_ptr<const IndexRouting>> routings;
+    for (std::size_t position = 0; position < items.size(); ++position) {
+        const char *item = body.data() + items[position].first;
+        const char *itemEnd = item + items[position].second;
+        const char *lineEnd = static_cast<const char *>(std::memchr(item, '\n', itemEnd - item));
+        BulkResponseScanner scanner(item, lineEnd ? lineEnd : itemEnd);
+
+        key.clear();
+        std::shared_ptr<Client> nodeClient;
+        if (scanner.readControlLine(control)) {
+            if (control.id.empty() && control.routing.empty()) {
+                anyGroup.push_back(position);
+                continue;
+            }
+            const std::string &index = control.indexName.empty() ? indexName
+                                                                 : control.indexName;
+            const IndexRouting *routing = nullptr;
+            if (!index.empty()) {
+                std::shared_ptr<const IndexRouting> &cached = routings[index];
+                if (!cached) {
+                    cached = routingOf(index, lock);
+                }
+                routing = cached.get();
+            }
+            // ID generated for item with custom routing selects shard of partition
+            if (routing && routing->valid && !(control.id.empty() && routing->partitionSize > 1)) {
+                const std::uint32_t shard = routing->shardOf(control.id, control.routing);
+                if (settings.grouping == Grouping::SHARD) {
+                    key = index + '\n' + std::to_string(shard);
+                } else if (!routing->primaryNodes[shard].empty()) {
+                    nodeClient = this->nodeClient(routing->primaryNodes[shard], lock);
+                    if (nodeClient) {
+                        key = routing->primaryNodes[shard];
+                    }
+                }
+            }
+        }
+
+        const std::map<std::string, std::size_t>::const_iterator found = groupOf.find(key);
+        std::size_t group;
+        if (found == groupOf.end()) {
+            group = groups.size();
+            groupOf.emplace(key, group);
+            groups.emplace_back();
+            groups.back().client = std::move(nodeClient);
+        } else {
+            group = found->second;
+        }
+        groups[group].body.append(item, items[position].second);
+        groups[group].positions.push_back(position);
+    }
+
+    // spread items with auto-generated ID over the groups
+    if (!anyGroup.empty() && groups.empty()) {
+        groups.emplace_back();
+    }
+    for (std::size_t i = 0; i < anyGroup.size(); ++i) {
+        RoutedGroup &group = groups[i % groups.size()];
+        group.body.append(body, items[anyGroup[i]].first, items[anyGroup[i]].second);
+        group.positions.push_back(anyGroup[i]);
+    }
+    return groups;
+}
+
+
+std::shared_ptr<const IndexRouting> BulkShardRouter::Implementation::routingOf(
+        const std::string &indexName, std::unique_lock<std::mutex> &lock)
+{
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::shared_ptr<const IndexRouting> &cached = indices[indexName];
+    if (cached) {
+        const std::chrono::steady_clock::duration age = now - cached->fetched;
+        if (age < settings.refreshInterval && (cached->valid || age < failedRefreshInterval)) {
+            return cached;
+        }
+    }
+
+    if (cached) {
+        // other threads keep using the stale routing until it is read again
+        std::shared_ptr<IndexRouting> claimed = std::make_shared<IndexRouting>(*cached);
+        claimed->fetched = now;
+        cached = claimed;
+    }
+    lock.unlock();
+    std::shared_ptr<IndexRouting> fetched = std::make_shared<IndexRouting>(
+            fetchRouting(indexName));
+    lock.lock();
+    fetched->fetched = now;
+    indices[indexName] = fetched;
+    return fetched;
+}
+
+
+IndexRouting BulkShardRouter::Implementation::fetchRouting(const std::string &indexName) {
+    // Expected response:
+    // {"metadata": {"indices": {"name": {
+    //      "routing_num_shards": int,
+    //      "settings": {"index": {"number_of_shards": "int", ...}}}}},
+    //  "routing_table": {"indices": {"name": {"shards": {
+    //      "0": [{"state": "STARTED", "primary": true, "node": string, ...}, ...]}}}}}
+    IndexRouting routing;
+    try {
+        const cpr::Response response = client->performRequest(
+                Client::HTTPMethod::GET, "_cluster/state/metadata,routing_table/" + indexName,
+                std::string());
+        Json::Value state;
+        Json::Reader reader;
+        if (response.status_code / 100 != 2 || !reader.parse(response.text, state, false)
+            || !state.isObject())
+        {
+            LOG(LogLevel::WARNING, "Routing of index %s can not be read, status %ld.",
+                indexName.c_str(), static_cast<long>(response.status_code));
+            return routing;
+        }
+
+        // alias has to point to single index
+        const Json::Value &indices = state["metadata"]["indices"];
+        if (!indices.isObject() || indices.size() != 1) {
+            LOG(LogLevel::WARNING, "Index %s is not single index, items are not routed.",
+                indexName.c_str());
+            return routing;
+        }
+        const std::string name = indices.getMemberNames().front();
+        const Json::Value &metadata = indices[name];
+        const Json::Value &indexSettings = metadata["settings"]["index"];
+        routing.numberOfShards = settingValue(indexSettings["number_of_shards"]);
+        routing.routingNumShards = metadata.isMember("routing_num_shards")
+                ? settingValue(metadata["routing_num_shards"]) : routing.numberOfShards;
+        if (indexSettings.isMember("routing_partition_size")) {
+            routing.partitionSize = settingValue(indexSettings["routing_partition_size"]);
+        }
+        if (!routing.numberOfShards || !routing.partitionSize
+            || routing.routingNumShards % routing.numberOfShards != 0)
+        {
+            LOG(LogLevel::WARNING, "Index %s has unexpected shard counts, items are not routed.",
+                indexName.c_str());
+            return routing;
+        }
+
+        routing.primaryNodes.resize(routing.numberOfShards);
+        const Json::Value &shards = state["routing_table"]["indices"][name]["shards"];
+        for (std::uint32_t shard = 0; shards.isObject() && shard < routing.numberOfShards;
+             ++shard)
+        {
+            for (const Json::Value &copy: shards[std::to_string(shard)]) {
+                const std::string copyState = copy["state"].asString();
+                if (copy["primary"].asBool() && copy["node"].isString()
+                    && (copyState == "STARTED" || copyState == "RELOCATING"))
+                {
+                    routing.primaryNodes[shard] = copy["node"].asString();
+                }
+            }
+        }
+        routing.valid = true;
+        LOG(LogLevel::DEBUG, "Routing of index %s read, %u shards.", indexName.c_str(),
+            routing.numberOfShards);
+    } catch (const ConnectionException &ex) {
+        LOG(LogLevel::WARNING, "Routing of index %s can not be read: %s", indexName.c_str(),
+            ex.what());
+    } catch (const std::exception &ex) {
+        LOG(LogLevel::WARNING, "Routing of index %s is not valid: %s", indexName.c_str(),
+            ex.what());
+    }
+    return routing;
+}
+
+
+std::shared_ptr<Client> BulkShardRouter::Implementation::nodeClient(
+        const std::string &nodeId, std::unique_lock<std::mutex> &lock)
+{
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::duration age = now - nodesFetched;
+    std::map<std::string, std::string>::const_iterator url = nodeUrls.find(nodeId);
+    if (age >= settings.refreshInterval
+        || (url == nodeUrls.end() && age >= failedRefreshInterval))
+    {
+        // other threads use the addresses known so far until they are read
+        nodesFetched = now;
+        lock.unlock();
+        std::map<std::string, std::string> urls;
+        const bool fetched = fetchNodes(urls);
+        lock.lock();
+        if (fetched) {
+            nodeUrls.swap(urls);
+        }
+        url = nodeUrls.find(nodeId);
+    }
+    if (url == nodeUrls.end()) {
+        return std::shared_ptr<Client>();
+    }
+
+    std::shared_ptr<Client> &nodeClient = nodeClients[url->second];
+    if (!nodeClient) {
+        nodeClient = settings.nodeClientFactory
+                ? settings.nodeClientFactory(url->second)
+                : std::make_shared<Client>(std::vector<std::string>({url->second}));
+    }
+    return nodeClient;
+}
+
+
+bool BulkShardRouter::Implementation::fetchNodes(std::map<std::string, std::string> &urls) {
+    // Expected response:
+    // {"nodes": {"id": {"http": {"publish_address": "[hostname/]ip:port", ...}, ...}}}
+    try {
+        const cpr::Response response = client->performRequest(
+                Client::HTTPMethod::GET, "_nodes/http", std::string());
+        Json::Value nodes;
+        Json::Reader reader;
+        if (response.status_code / 100 != 2 || !reader.parse(response.text, nodes, false)
+            || !nodes["nodes"].isObject())
+        {
+            LOG(LogLevel::WARNING, "Addresses of nodes can not be read, status %ld.",
+                static_cast<long>(response.status_code));
+            return false;
+        }
+        for (const std::string &id: nodes["nodes"].getMemberNames()) {
+            std::string address = nodes["nodes"][id]["http"]["publish_address"].asString();
+            if (address.empty()) {
+                continue;
+            }
+            const std::size_t slash = address.rfind('/');
+            if (slash != std::string::npos) {
+                address.erase(0, slash + 1);
+            }
+            urls[id] = settings.nodeScheme + "://" + address + "/";
+        }
+        return true;
+    } catch (const ConnectionException &ex) {
+        LOG(LogLevel::WARNING, "Addresses of nodes can not be read: %s", ex.what());
+    } catch (const std::exception &ex) {
+        LOG(LogLevel::WARNING, "Addresses of nodes are not valid: %s", ex.what());
+    }
+    return false;
+}
+
+
+}  // namespace elasticlient
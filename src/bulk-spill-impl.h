@@ -0,0 +1,92 @@
+/**
+ * \file
+ * Implementation of disk-backed queue of bulks.
+ */
+
+#pragma once
+
+#include "elasticlient/bulk-spill.h"
+#include "bulk-impl.h"
+
+#include <string>
+#include <istream>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+
+namespace elasticlient {
+
+
+class BulkSpillQueue::Implementation {
+    /// Segment file with bulks, each one stored as header line and body:
+    /// "<urlPath> <number of items> <body length>\n<body>"
+    struct Segment {
+        std::string path;
+        /// Size of the file.
+        std::size_t bytes;
+        /// Number of bulks not replayed yet.
+        std::size_t bulks;
+
+        Segment(const std::string &path, std::size_t bytes, std::size_t bulks)
+          : path(path), bytes(bytes), bulks(bulks)
+        {}
+    };
+
+    const std::string directory;
+    const Settings settings;
+
+    /// Guards all members below.
+    mutable std::mutex mutex;
+    /// Segments in order of appends; the last one is written if writeFd is valid.
+    std::deque<Segment> segments;
+    /// Descriptor of segment being written, -1 if there is none.
+    int writeFd;
+    /// Sequence number of next segment file.
+    std::uint64_t nextSequence;
+    /// Bytes appended since last sync.
+    std::size_t unsyncedBytes;
+    /// Size of all segments.
+    std::size_t totalBytes;
+    /// Number of bulks in all segments.
+    std::size_t totalBulks;
+    /// Offset of next bulk to replay in the first segment.
+    std::size_t readOffset;
+
+    /// Serializes replays.
+    std::mutex replayMutex;
+
+    friend class BulkSpillQueue;
+
+  public:
+    Implementation(const std::string &directory, const Settings &settings);
+
+    ~Implementation();
+
+    /// \see BulkSpillQueue::append
+    bool append(const std::string &urlPath, const std::string &body, std::size_t size);
+
+    /// \see BulkSpillQueue::sync
+    void sync();
+
+    /// \see BulkSpillQueue::replay
+    std::size_t replay(Bulk::Implementation &bulk, double maxBulksPerSecond);
+
+  private:
+    /// Sync and close segment being written (mutex locked).
+    void closeSegment();
+
+    /// Remove the first segment, it has been replayed (mutex locked).
+    void removeFirstSegment();
+
+    /**
+     * Read bulk stored at current position of segment \p file, skip its body
+     * if \p body is null.
+     * \return length of the stored bulk, 0 if the bulk can not be read.
+     */
+    static std::size_t readBulk(std::istream &file, std::string &urlPath,
+                                std::string *body, std::size_t &size);
+};
+
+
+}  // namespace elasticlient
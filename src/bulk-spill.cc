@@ -0,0 +1,374 @@
+/**
+ * \file
+ * Implementation of disk-backed queue of bulks.
+ */
+
+#include "bulk-spill-impl.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "logging-impl.h"
+
+
+namespace {
+
+
+const char segmentPrefix[] = "bulk-spill-";
+const char segmentSuffix[] = ".seg";
+
+
+/// Write whole \p data to \p fd, return false on error.
+bool writeAll(int fd, const char *data, std::size_t length) {
+    while (length) {
+        const ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+
+} // anonymous namespace
+
+
+namespace elasticlient {
+
+
+BulkSpillQueue::Implementation::Implementation(const std::string &directory,
+                                               const Settings &settings)
+  : directory(directory), settings(settings), mutex(), segments(), writeFd(-1),
+    nextSequence(0), unsyncedBytes(0), totalBytes(0), totalBulks(0), readOffset(0),
+    replayMutex()
+{
+    DIR *dir = ::opendir(directory.c_str());
+    if (!dir) {
+        throw std::runtime_error("Cannot open bulk spill directory " + directory + ".");
+    }
+    // segments left by previous process with their sequence numbers, other files
+    // are ignored
+    std::vector<std::pair<std::uint64_t, std::string>> names;
+    while (const dirent *entry = ::readdir(dir)) {
+        const std::string name = entry->d_name;
+        const std::size_t prefixLength = sizeof(segmentPrefix) - 1;
+        const std::size_t suffixLength = sizeof(segmentSuffix) - 1;
+        if (name.size() <= prefixLength + suffixLength
+            || name.compare(0, prefixLength, segmentPrefix) != 0
+            || name.compare(name.size() - suffixLength, suffixLength, segmentSuffix) != 0)
+        {
+            continue;
+        }
+        const std::string sequence = name.substr(
+                prefixLength, name.size() - prefixLength - suffixLength);
+        if (sequence.find_first_not_of("0123456789") != std::string::npos) {
+            LOG(LogLevel::WARNING, "Ignoring unknown file %s in bulk spill directory.",
+                name.c_str());
+            continue;
+        }
+        errno = 0;
+        const unsigned long long number = std::strtoull(sequence.c_str(), nullptr, 10);
+        if (errno == ERANGE) {
+            LOG(LogLevel::WARNING, "Ignoring unknown file %s in bulk spill directory.",
+                name.c_str());
+            continue;
+        }
+        names.emplace_back(number, name);
+    }
+    ::closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    for (const std::pair<std::uint64_t, std::string> &entry: names) {
+        const std::string &name = entry.second;
+        const std::string path = directory + "/" + name;
+        std::size_t bulks = 0;
+        std::size_t offset = 0;
+        std::string urlPath;
+        std::size_t size;
+        // only headers are read, bodies are skipped
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        const std::streamoff fileSize = file.tellg();
+        file.seekg(0);
+        while (std::size_t length = readBulk(file, urlPath, nullptr, size)) {
+            if (fileSize < 0 || offset + length > static_cast<std::size_t>(fileSize)) {
+                // bulk has not been written completely
+                break;
+            }
+            offset += length;
+            ++bulks;
+        }
+        segments.emplace_back(path, offset, bulks);
+        totalBytes += offset;
+        totalBulks += bulks;
+        nextSequence = std::max<std::uint64_t>(nextSequence, entry.first + 1);
+    }
+    if (totalBulks) {
+        LOG(LogLevel::INFO, "Found %lu spilled bulks in %lu segments.",
+            totalBulks, segments.size());
+    }
+}
+
+
+BulkSpillQueue::Implementation::~Implementation() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closeSegment();
+}
+
+
+bool BulkSpillQueue::Implementation::append(const std::string &urlPath,
+                                            const std::string &body,
+                                            std::size_t size)
+{
+    std::ostringstream header;
+    header << urlPath << ' ' << size << ' ' << body.size() << '\n';
+    const std::string headerLine = header.str();
+    const std::size_t length = headerLine.size() + body.size();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (settings.maxBytes && totalBytes + length > settings.maxBytes) {
+        LOG(LogLevel::ERROR, "Bulk spill queue is full, %lu items refused.", size);
+        return false;
+    }
+    if (writeFd >= 0 && segments.back().bytes >= settings.segmentBytes) {
+        closeSegment();
+    }
+    if (writeFd < 0) {
+        std::ostringstream path;
+        path << directory << '/' << segmentPrefix << std::setw(20) << std::setfill('0')
+             << nextSequence++ << segmentSuffix;
+        writeFd = ::open(path.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (writeFd < 0) {
+            LOG(LogLevel::ERROR, "Cannot create bulk spill segment %s: %s",
+                path.str().c_str(), std::strerror(errno));
+            return false;
+        }
+        segments.emplace_back(path.str(), 0, 0);
+    }
+
+    Segment &segment = segments.back();
+    if (!writeAll(writeFd, headerLine.data(), headerLine.size())
+        || !writeAll(writeFd, body.data(), body.size()))
+    {
+        LOG(LogLevel::ERROR, "Cannot write bulk spill segment %s: %s",
+            segment.path.c_str(), std::strerror(errno));
+        // drop partially written bulk
+        if (::ftruncate(writeFd, segment.bytes) != 0) {
+            closeSegment();
+        }
+        return false;
+    }
+    segment.bytes += length;
+    ++segment.bulks;
+    totalBytes += length;
+    ++totalBulks;
+
+    // sync in batches, sequential appends are cheap but fsync is not
+    unsyncedBytes += length;
+    if (unsyncedBytes >= settings.syncBytes) {
+        ::fsync(writeFd);
+        unsyncedBytes = 0;
+    }
+    return true;
+}
+
+
+void BulkSpillQueue::Implementation::sync() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (writeFd >= 0 && unsyncedBytes) {
+        ::fsync(writeFd);
+        unsyncedBytes = 0;
+    }
+}
+
+
+void BulkSpillQueue::Implementation::closeSegment() {
+    if (writeFd < 0) {
+        return;
+    }
+    ::fsync(writeFd);
+    ::close(writeFd);
+    writeFd = -1;
+    unsyncedBytes = 0;
+}
+
+
+void BulkSpillQueue::Implementation::removeFirstSegment() {
+    if (segments.size() == 1 && writeFd >= 0) {
+        closeSegment();
+    }
+    const Segment &segment = segments.front();
+    ::unlink(segment.path.c_str());
+    totalBytes -= segment.bytes;
+    totalBulks -= segment.bulks;
+    segments.pop_front();
+    readOffset = 0;
+}
+
+
+std::size_t BulkSpillQueue::Implementation::readBulk(std::istream &file,
+                                                     std::string &urlPath,
+                                                     std::string *body,
+                                                     std::size_t &size)
+{
+    std::string header;
+    std::size_t length;
+    if (!std::getline(file, header)) {
+        return 0;
+    }
+    std::istringstream fields(header);
+    if (!(fields >> urlPath >> size >> length)) {
+        return 0;
+    }
+    if (!body) {
+        if (!file.seekg(length, std::ios::cur)) {
+            return 0;
+        }
+    } else {
+        body->resize(length);
+        if (length && !file.read(&(*body)[0], length)) {
+            // bulk has not been written completely
+            return 0;
+        }
+    }
+    return header.size() + 1 + length;
+}
+
+
+std::size_t BulkSpillQueue::Implementation::replay(Bulk::Implementation &bulk,
+                                                   double maxBulksPerSecond)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::lock_guard<std::mutex> replayLock(replayMutex);
+    {
+        // bulks spilled during replay go to new segment
+        std::lock_guard<std::mutex> lock(mutex);
+        closeSegment();
+    }
+
+    const Clock::duration interval = maxBulksPerSecond > 0
+            ? std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(1 / maxBulksPerSecond))
+            : Clock::duration::zero();
+    Clock::time_point nextSend = Clock::now();
+    std::size_t replayed = 0;
+    std::string urlPath;
+    std::string body;
+    std::size_t size;
+    // the first segment stays open while its bulks are replayed
+    std::ifstream file;
+    std::string filePath;
+    std::size_t fileOffset = 0;
+    while (true) {
+        std::string path;
+        std::size_t offset;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (segments.empty() || (segments.size() == 1 && writeFd >= 0)) {
+                return replayed;
+            }
+            path = segments.front().path;
+            offset = readOffset;
+        }
+
+        if (path != filePath || offset != fileOffset) {
+            file.close();
+            file.clear();
+            file.open(path, std::ios::binary);
+            file.seekg(offset);
+            filePath = path;
+        }
+        const std::size_t length = readBulk(file, urlPath, &body, size);
+        fileOffset = offset + length;
+        if (!length) {
+            // end of segment, possibly truncated by crash during write
+            std::lock_guard<std::mutex> lock(mutex);
+            if (segments.front().bulks) {
+                LOG(LogLevel::WARNING, "Spill segment %s is damaged, dropping %lu bulks.",
+                    path.c_str(), segments.front().bulks);
+            }
+            removeFirstSegment();
+            continue;
+        }
+
+        std::this_thread::sleep_until(nextSend);
+        nextSend = Clock::now() + interval;
+        if (!bulk.runSpilled(body, size, urlPath)) {
+            LOG(LogLevel::INFO, "Cluster still unavailable, replayed %lu spilled bulks.",
+                replayed);
+            return replayed;
+        }
+        ++replayed;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        readOffset = fileOffset;
+        --segments.front().bulks;
+        --totalBulks;
+        if (!segments.front().bulks) {
+            removeFirstSegment();
+        }
+    }
+}
+
+
+BulkSpillQueue::BulkSpillQueue(const std::string &directory, const Settings &settings)
+  : impl(new Implementation(directory, settings))
+{}
+
+
+BulkSpillQueue::~BulkSpillQueue() {}
+
+
+bool BulkSpillQueue::append(const std::string &urlPath,
+                            const std::string &body,
+                            std::size_t size)
+{
+    return impl->append(urlPath, body, size);
+}
+
+
+void BulkSpillQueue::sync() {
+    impl->sync();
+}
+
+
+bool BulkSpillQueue::empty() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return !impl->totalBulks;
+}
+
+
+std::size_t BulkSpillQueue::size() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->totalBulks;
+}
+
+
+std::size_t BulkSpillQueue::byteSize() const {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    return impl->totalBytes;
+}
+
+
+std::size_t BulkSpillQueue::replay(Bulk &bulk, double maxBulksPerSecond) {
+    return impl->replay(*bulk.impl, maxBulksPerSecond);
+}
+
+
+}  // namespace elasticlient
@@ -0,0 +1,43 @@
+/**
+ * \file
+ * Validation of documents added to bulks.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+
+namespace elasticlient {
+
+
+/// Result of checkDocument().
+enum class DocumentCheck {
+    VALID,
+    /// Document contains raw newline, which would split the bulk line.
+    NEWLINE,
+    /// Document is not valid UTF-8.
+    INVALID_UTF8,
+    /**
+     * Document is not well-formed JSON: unbalanced brackets, unterminated string,
+     * invalid escape or control character.
+     */
+    MALFORMED
+};
+
+
+/**
+ * Check document of \p length bytes in one pass. Raw newlines, UTF-8 encoding and
+ * structure of JSON (strings, escapes and balance of brackets outside of strings)
+ * are checked, the rest of JSON grammar is left to Elasticsearch. Blocks of the
+ * document are scanned by SSE2 (AVX2 if enabled at compile time) instructions for
+ * bytes which need attention, other bytes are skipped.
+ */
+DocumentCheck checkDocument(const char *data, std::size_t length);
+
+
+/// The same as checkDocument(), but scanning byte by byte.
+DocumentCheck checkDocumentScalar(const char *data, std::size_t length);
+
+
+}  // namespace elasticlient
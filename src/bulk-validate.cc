@@ -0,0 +1,318 @@
+/**
+ * \file
+ * Implementation of validation of documents added to bulks.
+ */
+
+#include "bulk-validate-impl.h"
+
+#include <cstdint>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+namespace {
+
+
+using elasticlient::DocumentCheck;
+
+
+/// Maximal nesting of objects and arrays.
+const std::size_t maxDepth = 256;
+
+
+/// Return true if \p c needs attention of the checker.
+inline bool isSpecial(unsigned char c) {
+    return c < 0x20 || c >= 0x80 || c == '"' || c == '\\'
+        || (c | 0x20) == '{' || (c | 0x20) == '}';
+}
+
+
+#if defined(__AVX2__)
+
+/// Number of bytes scanned at once.
+const std::size_t blockSize = 32;
+
+/// Return bit mask of bytes of the block at \p data for which isSpecial() is true.
+inline std::uint32_t specialMask(const char *data) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+    // brackets differ from braces by 0x20 only
+    const __m256i folded = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+    __m256i special = _mm256_or_si256(
+            _mm256_cmpeq_epi8(block, _mm256_set1_epi8('"')),
+            _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\\')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')));
+    special = _mm256_or_si256(special, _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}')));
+    // signed comparison catches control characters and non-ASCII bytes at once
+    special = _mm256_or_si256(special, _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), block));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(special));
+}
+
+#elif defined(__SSE2__)
+
+/// Number of bytes scanned at once.
+const std::size_t blockSize = 16;
+
+/// Return bit mask of bytes of the block at \p data for which isSpecial() is true.
+inline std::uint32_t specialMask(const char *data) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    // brackets differ from braces by 0x20 only
+    const __m128i folded = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')),
+                                   _mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(folded, _mm_set1_epi8('{')));
+    special = _mm_or_si128(special, _mm_cmpeq_epi8(folded, _mm_set1_epi8('}')));
+    // signed comparison catches control characters and non-ASCII bytes at once
+    special = _mm_or_si128(special, _mm_cmplt_epi8(block, _mm_set1_epi8(0x20)));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(special));
+}
+
+#endif
+
+
+/// Return true if \p c is UTF-8 continuation byte.
+inline bool isContinuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+
+/// Return true if \p c is hex digit.
+inline bool isHexDigit(unsigned char c) {
+    return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+}
+
+
+/// Structure of the document being checked.
+class DocumentChecker {
+    const unsigned char *data;
+    const std::size_t length;
+    bool inString;
+    std::size_t depth;
+    /// Bit for each nesting level, set for arrays.
+    std::uint64_t arrays[maxDepth / 64];
+
+  public:
+    DocumentChecker(const char *data, std::size_t length)
+      : data(reinterpret_cast<const unsigned char *>(data)), length(length),
+        inString(false), depth(0), arrays()
+    {}
+
+    /**
+     * Check special byte at \p pos and bytes belonging to it (rest of UTF-8
+     * sequence or escape), set \p pos after them.
+     */
+    DocumentCheck check(std::size_t &pos);
+
+    /// Check state at the end of the document.
+    DocumentCheck finish() const {
+        return inString || depth ? DocumentCheck::MALFORMED : DocumentCheck::VALID;
+    }
+
+  private:
+    /// Check UTF-8 sequence at \p pos, set \p pos after it.
+    DocumentCheck checkUtf8(std::size_t &pos) const;
+
+    /// Check escape sequence at \p pos, set \p pos after it.
+    DocumentCheck checkEscape(std::size_t &pos) const;
+};
+
+
+DocumentCheck DocumentChecker::check(std::size_t &pos) {
+    const unsigned char c = data[pos];
+    if (c >= 0x80) {
+        return checkUtf8(pos);
+    }
+    if (c < 0x20) {
+        if (c == '\n') {
+            return DocumentCheck::NEWLINE;
+        }
+        // whitespace is allowed between tokens only
+        if (inString || (c != '\t' && c != '\r')) {
+            return DocumentCheck::MALFORMED;
+        }
+        ++pos;
+        return DocumentCheck::VALID;
+    }
+    if (inString) {
+        if (c == '\\') {
+            return checkEscape(pos);
+        }
+        if (c == '"') {
+            inString = false;
+        }
+        ++pos;
+        return DocumentCheck::VALID;
+    }
+
+    switch (c) {
+        case '"':
+            inString = true;
+            break;
+        case '{':
+        case '[':
+            if (depth == maxDepth) {
+                return DocumentCheck::MALFORMED;
+            }
+            if (c == '[') {
+                arrays[depth / 64] |= std::uint64_t(1) << (depth % 64);
+            } else {
+                arrays[depth / 64] &= ~(std::uint64_t(1) << (depth % 64));
+            }
+            ++depth;
+            break;
+        case '}':
+        case ']': {
+            if (!depth) {
+                return DocumentCheck::MALFORMED;
+            }
+            --depth;
+            const bool isArray = (arrays[depth / 64] >> (depth % 64)) & 1;
+            if (isArray != (c == ']')) {
+                return DocumentCheck::MALFORMED;
+            }
+            break;
+        }
+        default:
+            // backslash outside of string
+            return DocumentCheck::MALFORMED;
+    }
+    ++pos;
+    return DocumentCheck::VALID;
+}
+
+
+DocumentCheck DocumentChecker::checkUtf8(std::size_t &pos) const {
+    const unsigned char c = data[pos];
+    std::size_t size;
+    // allowed range of the second byte excludes overlong forms and surrogates
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+        size = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        size = 3;
+        if (c == 0xE0) {
+            low = 0xA0;
+        } else if (c == 0xED) {
+            high = 0x9F;
+        }
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        size = 4;
+        if (c == 0xF0) {
+            low = 0x90;
+        } else if (c == 0xF4) {
+            high = 0x8F;
+        }
+    } else {
+        return DocumentCheck::INVALID_UTF8;
+    }
+    if (length - pos < size || data[pos + 1] < low || data[pos + 1] > high) {
+        return DocumentCheck::INVALID_UTF8;
+    }
+    for (std::size_t i = 2; i < size; ++i) {
+        if (!isContinuation(data[pos + i])) {
+            return DocumentCheck::INVALID_UTF8;
+        }
+    }
+    pos += size;
+    return DocumentCheck::VALID;
+}
+
+
+DocumentCheck DocumentChecker::checkEscape(std::size_t &pos) const {
+    if (length - pos < 2) {
+        return DocumentCheck::MALFORMED;
+    }
+    switch (data[pos + 1]) {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+            pos += 2;
+            return DocumentCheck::VALID;
+        case 'u':
+            if (length - pos < 6) {
+                return DocumentCheck::MALFORMED;
+            }
+            for (std::size_t i = 2; i < 6; ++i) {
+                if (!isHexDigit(data[pos + i])) {
+                    return DocumentCheck::MALFORMED;
+                }
+            }
+            pos += 6;
+            return DocumentCheck::VALID;
+        case '\n':
+            return DocumentCheck::NEWLINE;
+        default:
+            return DocumentCheck::MALFORMED;
+    }
+}
+
+
+/// Check bytes from \p pos to the end of the document one by one.
+DocumentCheck checkTail(DocumentChecker &checker, const char *data,
+                        std::size_t length, std::size_t pos)
+{
+    while (pos < length) {
+        if (!isSpecial(data[pos])) {
+            ++pos;
+            continue;
+        }
+        const DocumentCheck result = checker.check(pos);
+        if (result != DocumentCheck::VALID) {
+            return result;
+        }
+    }
+    return checker.finish();
+}
+
+
+} // anonymous namespace
+
+
+namespace elasticlient {
+
+
+DocumentCheck checkDocument(const char *data, std::size_t length) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    DocumentChecker checker(data, length);
+    std::size_t pos = 0;
+    while (pos + blockSize <= length) {
+        const std::size_t blockStart = pos;
+        std::uint32_t mask = specialMask(data + blockStart);
+        while (mask) {
+            const std::size_t special = blockStart + __builtin_ctz(mask);
+            mask &= mask - 1;
+            // bytes of escape or UTF-8 sequence have been checked already
+            if (special < pos) {
+                continue;
+            }
+            pos = special;
+            const DocumentCheck result = checker.check(pos);
+            if (result != DocumentCheck::VALID) {
+                return result;
+            }
+        }
+        pos = std::max(pos, blockStart + blockSize);
+    }
+    return checkTail(checker, data, length, pos);
+#else
+    return checkDocumentScalar(data, length);
+#endif
+}
+
+
+DocumentCheck checkDocumentScalar(const char *data, std::size_t length) {
+    DocumentChecker checker(data, length);
+    return checkTail(checker, data, length, 0);
+}
+
+
+}  // namespace elasticlient
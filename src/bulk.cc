@@ -4,26 +4,179 @@
  */
 
 #include "bulk-impl.h"
+#include "bulk-validate-impl.h"
+#include "bulk-router-impl.h"
 
 #include <string>
-#include <sstream>
+#include <thread>
+#include <mutex>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
 #include <cpr/cpr.h>
-#include <json/json.h>
 #include "logging-impl.h"
 #include "elasticlient/client.h"
+#include "elasticlient/bulk-spill.h"
 
 
 namespace {
 
 
-/// Check whether a document does not contains new-line character.
-void validateDocument(const std::string &doc, const std::string &id) {
-    // new-line char is not allowed in document
-    if (doc.find_first_of("\n") != std::string::npos) {
-        LOG(elasticlient::LogLevel::ERROR,
-            "A document for %s contains newline character.", id.c_str());
-        throw std::runtime_error("Cannot index document containing newline char");
+/// Check whether a document does not contain new-line character and it is well-formed.
+void validateDocument(elasticlient::DocumentView doc, const std::string &id) {
+    switch (elasticlient::checkDocument(doc.data, doc.length)) {
+        case elasticlient::DocumentCheck::VALID:
+            return;
+        case elasticlient::DocumentCheck::NEWLINE:
+            // new-line char is not allowed in document
+            LOG(elasticlient::LogLevel::ERROR,
+                "A document for %s contains newline character.", id.c_str());
+            throw std::runtime_error("Cannot index document containing newline char");
+        case elasticlient::DocumentCheck::INVALID_UTF8:
+            LOG(elasticlient::LogLevel::ERROR,
+                "A document for %s is not valid UTF-8.", id.c_str());
+            throw std::runtime_error("Cannot index document with invalid UTF-8");
+        case elasticlient::DocumentCheck::MALFORMED:
+            LOG(elasticlient::LogLevel::ERROR,
+                "A document for %s is not well-formed JSON.", id.c_str());
+            throw std::runtime_error("Cannot index malformed JSON document");
+    }
+}
+
+
+/// Check whether document to delete is identified.
+void validateDeletedId(const std::string &id) {
+    if (id.empty()) {
+        throw std::runtime_error("Document ID is mandatory for delete action");
+    }
+}
+
+
+/// Return true if any byte of \p word is quote, backslash or control character.
+inline bool needsEscape(std::uint64_t word) {
+    const std::uint64_t ones = 0x0101010101010101ULL;
+    const std::uint64_t high = 0x8080808080808080ULL;
+    const std::uint64_t quote = word ^ (ones * '"');
+    const std::uint64_t backslash = word ^ (ones * '\\');
+    // byte is zero (or below 0x20) iff subtraction borrows into its high bit
+    return (((quote - ones) & ~quote)
+            | ((backslash - ones) & ~backslash)
+            | ((word - ones * 0x20) & ~word)) & high;
+}
+
+
+/// Append escape sequence of \p c to \p out.
+void appendEscaped(std::string &out, unsigned char c) {
+    static const char hexDigits[] = "0123456789abcdef";
+    switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            out += "\\u00";
+            out += hexDigits[c >> 4];
+            out += hexDigits[c & 0xf];
+    }
+}
+
+
+/// Append decimal \p value to \p out.
+void appendInt(std::string &out, std::int64_t value) {
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *pos = end;
+    std::uint64_t rest = value < 0 ? 0 - static_cast<std::uint64_t>(value) : value;
+    do {
+        *--pos = '0' + rest % 10;
+        rest /= 10;
+    } while (rest);
+    if (value < 0) {
+        *--pos = '-';
+    }
+    out.append(pos, end);
+}
+
+
+/// Append `, "key": "value"` to \p out if \p value is not empty.
+void appendField(std::string &out, const char *key, const std::string &value) {
+    if (!value.empty()) {
+        out += ", \"";
+        out += key;
+        out += "\": ";
+        elasticlient::appendJsonString(out, value);
+    }
+}
+
+
+/// Append `, "key": value` to \p out if \p value is not negative.
+void appendField(std::string &out, const char *key, std::int64_t value) {
+    if (value >= 0) {
+        out += ", \"";
+        out += key;
+        out += "\": ";
+        appendInt(out, value);
+    }
+}
+
+
+/// Append beginning of control line up to document type to \p out.
+void appendControlPrefix(std::string &out,
+                         const char *action,
+                         const std::string &indexName,
+                         const std::string &docType)
+{
+    out += "{\"";
+    out += action;
+    out += "\": {";
+    if (!indexName.empty()) {
+        out += "\"_index\": ";
+        elasticlient::appendJsonString(out, indexName);
+        out += ", ";
+    }
+    out += "\"_type\": ";
+    elasticlient::appendJsonString(out, docType);
+}
+
+
+/// Append rest of control line following document type to \p out.
+void appendControlSuffix(std::string &out,
+                         const std::string &docId,
+                         const elasticlient::BulkItemMetadata *metadata)
+{
+    if (!docId.empty()) {
+        out += ", \"_id\": ";
+        elasticlient::appendJsonString(out, docId);
+    }
+
+    if (metadata) {
+        appendField(out, "routing", metadata->routing);
+        appendField(out, "version", metadata->version);
+        appendField(out, "version_type", metadata->versionType);
+        appendField(out, "if_seq_no", metadata->ifSeqNo);
+        appendField(out, "if_primary_term", metadata->ifPrimaryTerm);
+        appendField(out, "pipeline", metadata->pipeline);
     }
+
+    out += "}}";
 }
 
 
@@ -36,11 +189,21 @@ namespace elasticlient {
 IBulkData::~IBulkData() {}
 
 
+IBulkDataProducer::~IBulkDataProducer() {}
+
+
 SameIndexBulkData::SameIndexBulkData(const std::string &indexName, std::size_t size)
   : impl(new Implementation(indexName, size))
 {}
 
 
+SameIndexBulkData::SameIndexBulkData(const std::string &indexName,
+                                     std::size_t size,
+                                     std::size_t maxBytes)
+  : impl(new Implementation(indexName, size, maxBytes))
+{}
+
+
 SameIndexBulkData::~SameIndexBulkData() {}
 
 
@@ -53,7 +216,7 @@ bool SameIndexBulkData::indexDocument(const std::string &docType,
                                       const std::string &id,
                                       const std::string &doc)
 {
-    return indexDocument(docType, id, doc, true);
+    return indexDocument(docType, id, DocumentView(doc.data(), doc.size()), true);
 }
 
 
@@ -62,241 +225,1594 @@ bool SameIndexBulkData::indexDocument(const std::string &docType,
                                       const std::string &doc,
                                       bool validate)
 {
-    if (validate) {
-        validateDocument(doc, id);
-    }
+    return indexDocument(docType, id, DocumentView(doc.data(), doc.size()), validate);
+}
 
-    impl->data.emplace_back(createControl("index", docType, id), doc);
-    // return true if bulk has reached its desired capacity
-    return impl->data.size() >= impl->size;
+
+bool SameIndexBulkData::createDocument(const std::string &docType,
+                                       const std::string &id,
+                                       const std::string &doc)
+{
+    return createDocument(docType, id, DocumentView(doc.data(), doc.size()), true);
 }
 
 
 bool SameIndexBulkData::createDocument(const std::string &docType,
+                                       const std::string &id,
+                                       const std::string &doc,
+                                       bool validate)
+{
+    return createDocument(docType, id, DocumentView(doc.data(), doc.size()), validate);
+}
+
+
+bool SameIndexBulkData::updateDocument(const std::string &docType,
                                        const std::string &id,
                                        const std::string &doc)
 {
-    return createDocument(docType, id, doc, true);
+    return updateDocument(docType, id, DocumentView(doc.data(), doc.size()), true);
+}
+
+
+bool SameIndexBulkData::updateDocument(const std::string &docType,
+                                       const std::string &id,
+                                       const std::string &doc,
+                                       bool validate)
+{
+    return updateDocument(docType, id, DocumentView(doc.data(), doc.size()), validate);
+}
+
+
+bool SameIndexBulkData::deleteDocument(const std::string &docType, const std::string &id) {
+    validateDeletedId(id);
+    // delete action has no source line
+    return impl->append("delete", docType, id, DocumentView(nullptr, 0));
+}
+
+
+bool SameIndexBulkData::indexDocument(const std::string &docType,
+                                      const std::string &id,
+                                      const std::string &doc,
+                                      const BulkItemMetadata &metadata,
+                                      bool validate)
+{
+    return indexDocument(docType, id, DocumentView(doc.data(), doc.size()), metadata, validate);
 }
 
 
 bool SameIndexBulkData::createDocument(const std::string &docType,
                                        const std::string &id,
                                        const std::string &doc,
+                                       const BulkItemMetadata &metadata,
                                        bool validate)
+{
+    return createDocument(docType, id, DocumentView(doc.data(), doc.size()), metadata, validate);
+}
+
+
+bool SameIndexBulkData::updateDocument(const std::string &docType,
+                                       const std::string &id,
+                                       const std::string &doc,
+                                       const BulkItemMetadata &metadata,
+                                       bool validate)
+{
+    return updateDocument(docType, id, DocumentView(doc.data(), doc.size()), metadata, validate);
+}
+
+
+bool SameIndexBulkData::deleteDocument(const std::string &docType,
+                                       const std::string &id,
+                                       const BulkItemMetadata &metadata)
+{
+    validateDeletedId(id);
+    return impl->append("delete", docType, id, DocumentView(nullptr, 0), &metadata);
+}
+
+
+bool SameIndexBulkData::indexDocument(const std::string &docType,
+                                      const std::string &id,
+                                      DocumentView doc,
+                                      bool validate)
 {
     if (validate) {
         validateDocument(doc, id);
     }
 
-    impl->data.emplace_back(createControl("create", docType, id), doc);
     // return true if bulk has reached its desired capacity
-    return impl->data.size() >= impl->size;
+    return impl->append("index", docType, id, doc);
 }
 
 
-bool SameIndexBulkData::updateDocument(const std::string &docType,
+bool SameIndexBulkData::createDocument(const std::string &docType,
                                        const std::string &id,
-                                       const std::string &doc)
+                                       DocumentView doc,
+                                       bool validate)
 {
-    return updateDocument(docType, id, doc, true);
+    if (validate) {
+        validateDocument(doc, id);
+    }
+
+    // return true if bulk has reached its desired capacity
+    return impl->append("create", docType, id, doc);
 }
 
 
 bool SameIndexBulkData::updateDocument(const std::string &docType,
                                        const std::string &id,
-                                       const std::string &doc,
+                                       DocumentView doc,
                                        bool validate)
 {
     if (validate) {
         validateDocument(doc, id);
     }
 
-    impl->data.emplace_back(createControl("update", docType, id), doc);
     // return true if bulk has reached its desired capacity
-    return impl->data.size() >= impl->size;
+    return impl->append("update", docType, id, doc);
 }
 
 
-void SameIndexBulkData::clear() {
-    impl->data.resize(0);
+bool SameIndexBulkData::indexDocument(const std::string &docType,
+                                      const std::string &id,
+                                      DocumentView doc,
+                                      const BulkItemMetadata &metadata,
+                                      bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("index", docType, id, doc, &metadata);
 }
 
 
-bool SameIndexBulkData::empty() const {
-    return impl->data.empty();
+bool SameIndexBulkData::createDocument(const std::string &docType,
+                                       const std::string &id,
+                                       DocumentView doc,
+                                       const BulkItemMetadata &metadata,
+                                       bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("create", docType, id, doc, &metadata);
 }
 
 
-std::size_t SameIndexBulkData::size() const {
-    return impl->data.size();
+bool SameIndexBulkData::updateDocument(const std::string &docType,
+                                       const std::string &id,
+                                       DocumentView doc,
+                                       const BulkItemMetadata &metadata,
+                                       bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("update", docType, id, doc, &metadata);
 }
 
 
-std::string SameIndexBulkData::body() const {
-    std::ostringstream body;
-    for (const BulkItem &element: impl->data) {
-        body << element;
-    }
-    return body.str();
+bool SameIndexBulkData::indexDocument(const std::string &docType,
+                                      const std::string &id,
+                                      JsonDocument doc)
+{
+    return impl->append("index", docType, id, doc.value);
 }
 
 
-Bulk::Bulk(const std::shared_ptr<Client> &client)
-  : impl(new Implementation(client))
-{}
+bool SameIndexBulkData::createDocument(const std::string &docType,
+                                       const std::string &id,
+                                       JsonDocument doc)
+{
+    return impl->append("create", docType, id, doc.value);
+}
 
 
-Bulk::Bulk(const std::vector<std::string> &hostUrlList,
-           std::int32_t connectionTimeout)
-  : impl(new Implementation(
-              std::make_shared<Client>(hostUrlList, connectionTimeout)))
-{}
+bool SameIndexBulkData::updateDocument(const std::string &docType,
+                                       const std::string &id,
+                                       JsonDocument doc)
+{
+    return impl->append("update", docType, id, doc.value);
+}
 
 
-Bulk::~Bulk() {}
+bool SameIndexBulkData::indexDocument(const std::string &docType,
+                                      const std::string &id,
+                                      JsonDocument doc,
+                                      const BulkItemMetadata &metadata)
+{
+    return impl->append("index", docType, id, doc.value, &metadata);
+}
 
 
-Bulk::Bulk(Bulk &&) = default;
+bool SameIndexBulkData::createDocument(const std::string &docType,
+                                       const std::string &id,
+                                       JsonDocument doc,
+                                       const BulkItemMetadata &metadata)
+{
+    return impl->append("create", docType, id, doc.value, &metadata);
+}
 
 
-std::string createControl(const std::string &action,
-                          const std::string &docType,
-                          const std::string &docId)
+bool SameIndexBulkData::updateDocument(const std::string &docType,
+                                       const std::string &id,
+                                       JsonDocument doc,
+                                       const BulkItemMetadata &metadata)
 {
-    std::ostringstream out;
-    out << "{\"" << action << "\": {"
-           "\"_type\": \"" << docType << "\"";
+    return impl->append("update", docType, id, doc.value, &metadata);
+}
 
-    if (!docId.empty()) {
-        out << ", \"_id\": \"" << docId << "\"";
-    }
 
-    out << "}}";
+void SameIndexBulkData::setCoalescing(bool enabled) {
+    impl->setCoalescing(enabled);
+}
+
 
-    return out.str();
+std::size_t SameIndexBulkData::getDroppedCount() const {
+    return impl->droppedOperations;
 }
 
 
-void Bulk::Implementation::run(const IBulkData &bulk) {
-    std::string body = bulk.body();
-    std::string indexName = bulk.indexName();
-    try {
-        const cpr::Response r = client->performRequest(Client::HTTPMethod::POST,
-                                                       indexName + "/_bulk",
-                                                       body);
-        if (r.status_code / 100 != 2) {
-            throw ConnectionException("Elastic node not respond with status 2xx.");
-        }
-        processResult(r.text, bulk.size());
-    } catch(const ConnectionException &ex) {
-        LOG(LogLevel::ERROR, "Elastic cluster while indexing bulk: %s", ex.what());
-        errCount += bulk.size();
-    }
+std::size_t SameIndexBulkData::getMergedCount() const {
+    return impl->mergedOperations;
 }
 
 
-std::size_t Bulk::perform(const IBulkData &bulk) {
-    if (bulk.empty()) { return 0; }
+void SameIndexBulkData::clear() {
+    // keep allocated memory for next documents
+    impl->clear();
+}
 
-    LOG(LogLevel::INFO, "Going to index %lu elements.", bulk.size());
-    impl->errCount = 0;
-    impl->run(bulk);
-    return impl->errCount;
+
+bool SameIndexBulkData::empty() const {
+    return !impl->itemCount();
 }
 
 
-void Bulk::Implementation::processResult(
-        const std::string &result, std::size_t size)
-{
-    Json::Value root;
-    Json::Reader reader;
-    // parse elastic json result without comments (false at the end)
-    if (!reader.parse(result, root, false)) {
-        // probably whole bulk has failed
-        errCount += size;
-        return;
-    }
+std::size_t SameIndexBulkData::size() const {
+    return impl->itemCount();
+}
 
-    // Expected response:
-    // {"took": int,
-    //  "errors": false,
-    //  "items": [
-    //      {"index": {
-    //          "_index": string,
-    //          "_type": string,
-    //          "_id": string,
-    //          "_version": int,
-    //          "_shards": {"total": int, "successful": int, "failed": int},
-    //          "status": 201}}
-    //  ]}
 
-    // check errors flag, if it is false, do not parse single responses
-    if (root.isMember("errors")) {
-        const Json::Value &errors = root["errors"];
-        if (errors.isBool() && !errors.asBool()) {
-            // everything is alright, errors==false.
-            return;
-        }
-    }
+std::size_t SameIndexBulkData::byteSize() const {
+    return impl->byteCount();
+}
 
-    // check presence of the bulk items results
-    if (!root.isMember("items")) {
-        LOG(LogLevel::WARNING, "Bulk ran with errors, but no items are present "
-                               "at the response! Err count is inaccurate now!");
-        return;
-    }
-    const Json::Value &items = root["items"];
-    // check correct type of the items
-    if (!items.isArray()) {
-        LOG(LogLevel::WARNING, "Failed to read elastic response field 'items', because "
-                               "it is not an array! Err count is inaccurate now!");
-        return;
-    }
 
-    // process items responses
-    for (const Json::Value &item: items) {
-        if (!item.isObject()) {
-            LOG(LogLevel::WARNING, "Bulk items responses have to be objects!");
-            continue;
-        }
+std::string SameIndexBulkData::body() const {
+    return impl->serialized();
+}
 
-        // check index action response
-        if (item.isMember("index")) {
-            const Json::Value &res = item["index"];
-            if (!res.isObject()) {
-                LOG(LogLevel::WARNING, "Bulk response has unexpected format, "
-                                       "object was expected.");
-                continue;
-            }
-            // read status code
-            const Json::Value &status = res.get("status", Json::Int(500));
-            if (!status.isNumeric()) {
-                LOG(LogLevel::WARNING, "Bulk response was expected to have numeric status. "
-                                       "Skipping this response checking.");
-                continue;
-            }
 
-            // if status code is not 2xx family, consider it as error
-            if (status.asInt() / 100 != 2) {
-                errCount++;
-            }
-        } else {
-            LOG(LogLevel::WARNING, "Unsupported 'action' found at bulk response.");
+const std::string &SameIndexBulkData::bodyBuffer() const {
+    return impl->serialized();
+}
 
-        }
-    }
 
-    // complain if not all items of the bulk were covered by responses
-    if (items.size() < size) {
-        LOG(LogLevel::INFO, "Bulk has more items than responses received. Cannot tell "
-                            "whether %lu items succeeded...", size - items.size());
-    }
+MultiIndexBulkData::MultiIndexBulkData(std::size_t size, std::size_t maxBytes)
+  : impl(new Implementation(size, maxBytes))
+{}
+
+
+MultiIndexBulkData::~MultiIndexBulkData() {}
+
+
+std::string MultiIndexBulkData::indexName() const {
+    return std::string();
 }
 
 
-std::size_t Bulk::getErrorCount() const {
-    return impl->errCount;
+bool MultiIndexBulkData::indexDocument(const std::string &indexName,
+                                       const std::string &docType,
+                                       const std::string &id,
+                                       const std::string &doc,
+                                       bool validate)
+{
+    return indexDocument(indexName, docType, id, DocumentView(doc.data(), doc.size()), validate);
+}
+
+
+bool MultiIndexBulkData::createDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        const std::string &doc,
+                                        bool validate)
+{
+    return createDocument(indexName, docType, id, DocumentView(doc.data(), doc.size()), validate);
+}
+
+
+bool MultiIndexBulkData::updateDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        const std::string &doc,
+                                        bool validate)
+{
+    return updateDocument(indexName, docType, id, DocumentView(doc.data(), doc.size()), validate);
+}
+
+
+bool MultiIndexBulkData::deleteDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id)
+{
+    validateDeletedId(id);
+    // delete action has no source line
+    return impl->append("delete", indexName, docType, id, DocumentView(nullptr, 0));
+}
+
+
+bool MultiIndexBulkData::indexDocument(const std::string &indexName,
+                                       const std::string &docType,
+                                       const std::string &id,
+                                       const std::string &doc,
+                                       const BulkItemMetadata &metadata,
+                                       bool validate)
+{
+    return indexDocument(indexName, docType, id, DocumentView(doc.data(), doc.size()), metadata, validate);
+}
+
+
+bool MultiIndexBulkData::createDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        const std::string &doc,
+                                        const BulkItemMetadata &metadata,
+                                        bool validate)
+{
+    return createDocument(indexName, docType, id, DocumentView(doc.data(), doc.size()), metadata, validate);
+}
+
+
+bool MultiIndexBulkData::updateDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        const std::string &doc,
+                                        const BulkItemMetadata &metadata,
+                                        bool validate)
+{
+    return updateDocument(indexName, docType, id, DocumentView(doc.data(), doc.size()), metadata, validate);
+}
+
+
+bool MultiIndexBulkData::deleteDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        const BulkItemMetadata &metadata)
+{
+    validateDeletedId(id);
+    return impl->append("delete", indexName, docType, id, DocumentView(nullptr, 0), &metadata);
+}
+
+
+bool MultiIndexBulkData::indexDocument(const std::string &indexName,
+                                       const std::string &docType,
+                                       const std::string &id,
+                                       DocumentView doc,
+                                       bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("index", indexName, docType, id, doc);
+}
+
+
+bool MultiIndexBulkData::createDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        DocumentView doc,
+                                        bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("create", indexName, docType, id, doc);
+}
+
+
+bool MultiIndexBulkData::updateDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        DocumentView doc,
+                                        bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("update", indexName, docType, id, doc);
+}
+
+
+bool MultiIndexBulkData::indexDocument(const std::string &indexName,
+                                       const std::string &docType,
+                                       const std::string &id,
+                                       DocumentView doc,
+                                       const BulkItemMetadata &metadata,
+                                       bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("index", indexName, docType, id, doc, &metadata);
+}
+
+
+bool MultiIndexBulkData::createDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        DocumentView doc,
+                                        const BulkItemMetadata &metadata,
+                                        bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("create", indexName, docType, id, doc, &metadata);
+}
+
+
+bool MultiIndexBulkData::updateDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        DocumentView doc,
+                                        const BulkItemMetadata &metadata,
+                                        bool validate)
+{
+    if (validate) {
+        validateDocument(doc, id);
+    }
+    return impl->append("update", indexName, docType, id, doc, &metadata);
+}
+
+
+bool MultiIndexBulkData::indexDocument(const std::string &indexName,
+                                       const std::string &docType,
+                                       const std::string &id,
+                                       JsonDocument doc)
+{
+    return impl->append("index", indexName, docType, id, doc.value);
+}
+
+
+bool MultiIndexBulkData::createDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        JsonDocument doc)
+{
+    return impl->append("create", indexName, docType, id, doc.value);
+}
+
+
+bool MultiIndexBulkData::updateDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        JsonDocument doc)
+{
+    return impl->append("update", indexName, docType, id, doc.value);
+}
+
+
+bool MultiIndexBulkData::indexDocument(const std::string &indexName,
+                                       const std::string &docType,
+                                       const std::string &id,
+                                       JsonDocument doc,
+                                       const BulkItemMetadata &metadata)
+{
+    return impl->append("index", indexName, docType, id, doc.value, &metadata);
+}
+
+
+bool MultiIndexBulkData::createDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        JsonDocument doc,
+                                        const BulkItemMetadata &metadata)
+{
+    return impl->append("create", indexName, docType, id, doc.value, &metadata);
+}
+
+
+bool MultiIndexBulkData::updateDocument(const std::string &indexName,
+                                        const std::string &docType,
+                                        const std::string &id,
+                                        JsonDocument doc,
+                                        const BulkItemMetadata &metadata)
+{
+    return impl->append("update", indexName, docType, id, doc.value, &metadata);
+}
+
+
+void MultiIndexBulkData::setCoalescing(bool enabled) {
+    impl->setCoalescing(enabled);
+}
+
+
+std::size_t MultiIndexBulkData::getDroppedCount() const {
+    return impl->droppedOperations;
+}
+
+
+std::size_t MultiIndexBulkData::getMergedCount() const {
+    return impl->mergedOperations;
+}
+
+
+void MultiIndexBulkData::clear() {
+    // keep allocated memory for next documents
+    impl->clear();
+}
+
+
+bool MultiIndexBulkData::empty() const {
+    return !impl->itemCount();
+}
+
+
+std::size_t MultiIndexBulkData::size() const {
+    return impl->itemCount();
+}
+
+
+std::size_t MultiIndexBulkData::byteSize() const {
+    return impl->byteCount();
+}
+
+
+std::string MultiIndexBulkData::body() const {
+    return impl->serialized();
+}
+
+
+const std::string &MultiIndexBulkData::bodyBuffer() const {
+    return impl->serialized();
+}
+
+
+void BulkResult::Implementation::set(std::size_t position,
+                                     Action action,
+                                     const std::string &id,
+                                     int status,
+                                     const std::string &errorType,
+                                     const std::string &errorReason)
+{
+    Item &item = items.at(position);
+    // item may be set again after retry
+    if (isFailure(item.status, item.action)) {
+        --errCount;
+    }
+    if (isFailure(status, action)) {
+        ++errCount;
+    }
+    item.action = action;
+    item.status = static_cast<std::int16_t>(status);
+    // strings of retried item are overwritten in place if they fit
+    const std::size_t used = item.idLength + item.reasonLength;
+    if (id.size() + errorReason.size() <= used) {
+        strings.replace(item.idOffset, id.size(), id);
+        strings.replace(item.idOffset + id.size(), errorReason.size(), errorReason);
+        unusedStrings += used - id.size() - errorReason.size();
+    } else {
+        unusedStrings += used;
+        item.idOffset = strings.size();
+        strings += id;
+        strings += errorReason;
+    }
+    item.idLength = id.size();
+    item.reasonOffset = item.idOffset + id.size();
+    item.reasonLength = errorReason.size();
+    if (unusedStrings > strings.size() / 2) {
+        compactStrings();
+    }
+
+    item.errorType = 0;
+    if (!errorType.empty()) {
+        const std::map<std::string, std::uint32_t>::const_iterator found =
+                errorTypeIndex.find(errorType);
+        if (found != errorTypeIndex.end()) {
+            item.errorType = found->second;
+        } else {
+            item.errorType = errorTypes.size();
+            errorTypeIndex.emplace(errorType, item.errorType);
+            errorTypes.push_back(errorType);
+        }
+    }
+}
+
+
+void BulkResult::Implementation::compactStrings() {
+    std::string compacted;
+    compacted.reserve(strings.size() - unusedStrings);
+    for (Item &item: items) {
+        const std::size_t offset = compacted.size();
+        compacted.append(strings, item.idOffset, item.idLength);
+        compacted.append(strings, item.reasonOffset, item.reasonLength);
+        item.idOffset = offset;
+        item.reasonOffset = offset + item.idLength;
+    }
+    strings.swap(compacted);
+    unusedStrings = 0;
+}
+
+
+void BulkResult::Implementation::merge(std::size_t offset, const Implementation &other) {
+    for (std::size_t i = 0; i < other.items.size(); ++i) {
+        const Item &item = other.items[i];
+        set(offset + i, item.action,
+            other.strings.substr(item.idOffset, item.idLength), item.status,
+            other.errorTypes[item.errorType],
+            other.strings.substr(item.reasonOffset, item.reasonLength));
+    }
+}
+
+
+void BulkResult::Implementation::merge(const std::vector<std::size_t> &positions,
+                                       const Implementation &other)
+{
+    for (std::size_t i = 0; i < other.items.size() && i < positions.size(); ++i) {
+        const Item &item = other.items[i];
+        set(positions[i], item.action,
+            other.strings.substr(item.idOffset, item.idLength), item.status,
+            other.errorTypes[item.errorType],
+            other.strings.substr(item.reasonOffset, item.reasonLength));
+    }
+}
+
+
+BulkResult::Action BulkResult::Implementation::parseAction(const std::string &name) {
+    if (name == "index") {
+        return Action::INDEX;
+    } else if (name == "create") {
+        return Action::CREATE;
+    } else if (name == "update") {
+        return Action::UPDATE;
+    } else if (name == "delete") {
+        return Action::DELETE;
+    }
+    return Action::UNKNOWN;
+}
+
+
+BulkResult::BulkResult(): impl(new Implementation()) {}
+
+
+BulkResult::BulkResult(const BulkResult &other): impl(new Implementation(*other.impl)) {}
+
+
+BulkResult::BulkResult(BulkResult &&other): impl(new Implementation()) {
+    impl.swap(other.impl);
+}
+
+
+BulkResult &BulkResult::operator=(const BulkResult &other) {
+    *impl = *other.impl;
+    return *this;
+}
+
+
+BulkResult &BulkResult::operator=(BulkResult &&other) {
+    impl.swap(other.impl);
+    return *this;
+}
+
+
+BulkResult::~BulkResult() {}
+
+
+std::size_t BulkResult::size() const {
+    return impl->items.size();
+}
+
+
+std::size_t BulkResult::errorCount() const {
+    return impl->errCount;
+}
+
+
+BulkResult::Action BulkResult::action(std::size_t item) const {
+    return impl->items.at(item).action;
+}
+
+
+std::string BulkResult::id(std::size_t item) const {
+    const Implementation::Item &data = impl->items.at(item);
+    return impl->strings.substr(data.idOffset, data.idLength);
+}
+
+
+int BulkResult::status(std::size_t item) const {
+    return impl->items.at(item).status;
+}
+
+
+bool BulkResult::failed(std::size_t item) const {
+    const Implementation::Item &data = impl->items.at(item);
+    return Implementation::isFailure(data.status, data.action);
+}
+
+
+const std::string &BulkResult::errorType(std::size_t item) const {
+    return impl->errorTypes[impl->items.at(item).errorType];
+}
+
+
+std::string BulkResult::errorReason(std::size_t item) const {
+    const Implementation::Item &data = impl->items.at(item);
+    return impl->strings.substr(data.reasonOffset, data.reasonLength);
+}
+
+
+Bulk::Bulk(const std::shared_ptr<Client> &client)
+  : impl(new Implementation(client))
+{}
+
+
+Bulk::Bulk(const std::vector<std::string> &hostUrlList,
+           std::int32_t connectionTimeout)
+  : impl(new Implementation(
+              std::make_shared<Client>(hostUrlList, connectionTimeout)))
+{}
+
+
+Bulk::Bulk(const std::vector<std::string> &hostUrlList,
+           std::int32_t connectionTimeout,
+           const std::shared_ptr<ConnectionShare> &connectionShare)
+  : impl(new Implementation(
+              std::make_shared<Client>(hostUrlList,
+                                       Client::TimeoutOption(connectionTimeout),
+                                       Client::ConnectionShareOption(connectionShare))))
+{}
+
+
+Bulk::~Bulk() {}
+
+
+Bulk::Bulk(Bulk &&) = default;
+
+
+std::vector<std::pair<std::size_t, std::size_t>> splitBulkItems(const std::string &body) {
+    std::vector<std::pair<std::size_t, std::size_t>> items;
+    std::size_t pos = 0;
+    while (pos < body.size()) {
+        const std::size_t start = pos;
+        std::size_t end = body.find('\n', pos);
+        end = (end == std::string::npos) ? body.size() : end + 1;
+        // action is the first key of the control line
+        const std::size_t actionStart = body.find('"', start);
+        const bool hasSource = actionStart >= end
+                || body.compare(actionStart, 8, "\"delete\"") != 0;
+        if (hasSource && end < body.size()) {
+            const std::size_t sourceEnd = body.find('\n', end);
+            end = (sourceEnd == std::string::npos) ? body.size() : sourceEnd + 1;
+        }
+        items.emplace_back(start, end - start);
+        pos = end;
+    }
+    return items;
+}
+
+
+std::string createControl(const std::string &action,
+                          const std::string &docType,
+                          const std::string &docId)
+{
+    std::string out;
+    appendControl(out, action, docType, docId);
+    return out;
+}
+
+
+std::string createControl(const std::string &action,
+                          const std::string &docType,
+                          const std::string &docId,
+                          const BulkItemMetadata &metadata)
+{
+    std::string out;
+    appendControl(out, action, std::string(), docType, docId, &metadata);
+    return out;
+}
+
+
+void appendControl(std::string &out,
+                   const std::string &action,
+                   const std::string &docType,
+                   const std::string &docId)
+{
+    appendControl(out, action, std::string(), docType, docId, nullptr);
+}
+
+
+void appendControl(std::string &out,
+                   const std::string &action,
+                   const std::string &indexName,
+                   const std::string &docType,
+                   const std::string &docId,
+                   const BulkItemMetadata *metadata)
+{
+    appendControlPrefix(out, action.c_str(), indexName, docType);
+    appendControlSuffix(out, docId, metadata);
+}
+
+
+void appendJsonString(std::string &out, const std::string &value) {
+    appendJsonString(out, value.data(), value.size());
+}
+
+
+void appendJsonString(std::string &out, const char *data, std::size_t length) {
+    // start of bytes not copied to out yet
+    std::size_t start = 0;
+    std::size_t pos = 0;
+    out += '"';
+    while (pos < length) {
+        // skip eight bytes at once while there is nothing to escape
+        std::uint64_t word;
+        while (pos + sizeof(word) <= length) {
+            std::memcpy(&word, data + pos, sizeof(word));
+            if (needsEscape(word)) {
+                break;
+            }
+            pos += sizeof(word);
+        }
+        if (pos == length) {
+            break;
+        }
+        const unsigned char c = data[pos];
+        if (c == '"' || c == '\\' || c < 0x20) {
+            out.append(data + start, pos - start);
+            appendEscaped(out, c);
+            start = pos + 1;
+        }
+        ++pos;
+    }
+    out.append(data + start, length - start);
+    out += '"';
+}
+
+
+void ControlLineWriter::append(std::string &out,
+                               const char *action,
+                               const std::string &indexName,
+                               const std::string &docType,
+                               const std::string &docId,
+                               const BulkItemMetadata *metadata)
+{
+    out += prefix(action, indexName, docType);
+    appendControlSuffix(out, docId, metadata);
+}
+
+
+const std::string &ControlLineWriter::prefix(const char *action,
+                                             const std::string &indexName,
+                                             const std::string &docType)
+{
+    for (const Prefix &cached: prefixes) {
+        if (cached.action == action && cached.docType == docType
+            && cached.indexName == indexName)
+        {
+            return cached.line;
+        }
+    }
+    Prefix *created;
+    if (prefixes.size() < maxPrefixes) {
+        prefixes.emplace_back();
+        created = &prefixes.back();
+    } else {
+        created = &prefixes[nextReplaced];
+        nextReplaced = (nextReplaced + 1) % maxPrefixes;
+    }
+    created->action = action;
+    created->indexName = indexName;
+    created->docType = docType;
+    created->line.clear();
+    appendControlPrefix(created->line, action, indexName, docType);
+    return created->line;
+}
+
+
+void BulkBuffer::setCoalescing(bool enabled) {
+    if (enabled && !itemIndex) {
+        itemIndex.reset(new BulkItemIndex());
+        // items added so far are not indexed, so they are never coalesced
+        dropped.assign(itemOffsets.size(), false);
+    } else if (!enabled && itemIndex) {
+        compact();
+        itemIndex.reset();
+        dropped.clear();
+    }
+}
+
+
+void BulkBuffer::appendCoalesced(const char *action,
+                                 const std::string &indexName,
+                                 const std::string &docType,
+                                 const std::string &docId,
+                                 DocumentView source,
+                                 const BulkItemMetadata *metadata)
+{
+    typedef BulkItemIndex::Kind Kind;
+    BulkItemIndex::Entry &last = itemIndex->find(indexName, docType, docId);
+    const bool hasLast = last.item != BulkItemIndex::npos;
+    Kind kind = Kind::BARRIER;
+
+    if (!metadata && std::strcmp(action, "index") == 0) {
+        // whole document replaces previous changes
+        kind = Kind::INDEX;
+        if (hasLast && last.kind != Kind::BARRIER) {
+            drop(last.item);
+            ++droppedOperations;
+        }
+    } else if (!metadata && std::strcmp(action, "update") == 0) {
+        kind = Kind::UPDATE;
+        if (isPartialUpdate(source.data, source.length)) {
+            kind = Kind::PARTIAL_UPDATE;
+            if (hasLast && (last.kind == Kind::PARTIAL_UPDATE || last.kind == Kind::INDEX)) {
+                const DocumentView target = sourceOf(last.item);
+                if (mergePartialUpdate(target.data, target.length,
+                                       last.kind == Kind::PARTIAL_UPDATE,
+                                       source.data, source.length, merged))
+                {
+                    drop(last.item);
+                    ++mergedOperations;
+                    // update applied to indexed document gives indexed document
+                    if (last.kind == Kind::INDEX) {
+                        action = "index";
+                        kind = Kind::INDEX;
+                    }
+                    source = DocumentView(merged.data(), merged.size());
+                }
+            }
+        }
+    }
+
+    last.item = itemOffsets.size();
+    last.kind = kind;
+    appendItem(action, indexName, docType, docId, source, metadata);
+}
+
+
+DocumentView BulkBuffer::sourceOf(std::size_t position) const {
+    const std::size_t end = position + 1 < itemOffsets.size() ? itemOffsets[position + 1]
+                                                              : buffer.size();
+    const std::size_t sourceStart = buffer.find('\n', itemOffsets[position]) + 1;
+    if (sourceStart >= end) {
+        return DocumentView(nullptr, 0);
+    }
+    // without terminating newline
+    return DocumentView(buffer.data() + sourceStart, end - sourceStart - 1);
+}
+
+
+void BulkBuffer::drop(std::size_t position) {
+    const std::size_t end = position + 1 < itemOffsets.size() ? itemOffsets[position + 1]
+                                                              : buffer.size();
+    dropped[position] = true;
+    ++droppedItems;
+    droppedBytes += end - itemOffsets[position];
+}
+
+
+void BulkBuffer::compact() {
+    if (!droppedItems) {
+        return;
+    }
+    // new positions of kept items
+    std::vector<std::uint32_t> positions(itemOffsets.size(), BulkItemIndex::npos);
+    std::size_t write = 0;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < itemOffsets.size(); ++i) {
+        const std::size_t start = itemOffsets[i];
+        const std::size_t end = i + 1 < itemOffsets.size() ? itemOffsets[i + 1] : buffer.size();
+        if (dropped[i]) {
+            continue;
+        }
+        if (write != start) {
+            std::memmove(&buffer[write], &buffer[start], end - start);
+        }
+        itemOffsets[kept] = write;
+        positions[i] = kept++;
+        write += end - start;
+    }
+    buffer.resize(write);
+    itemOffsets.resize(kept);
+    dropped.assign(kept, false);
+    droppedItems = 0;
+    droppedBytes = 0;
+    itemIndex->remap(positions);
+}
+
+
+const std::string &Bulk::Implementation::bodyOf(const IBulkData &bulk, std::string &copy) {
+    // SameIndexBulkData and MultiIndexBulkData keep serialized body, do not copy it
+    if (const SameIndexBulkData *data = dynamic_cast<const SameIndexBulkData *>(&bulk)) {
+        return data->bodyBuffer();
+    }
+    if (const MultiIndexBulkData *data = dynamic_cast<const MultiIndexBulkData *>(&bulk)) {
+        return data->bodyBuffer();
+    }
+    copy = bulk.body();
+    return copy;
+}
+
+
+std::string Bulk::Implementation::urlPathOf(const std::string &indexName) {
+    // data of more indices have index in each control line
+    return indexName.empty() ? "_bulk" : indexName + "/_bulk";
+}
+
+
+void Bulk::Implementation::run(const IBulkData &bulk) {
+    std::string bodyCopy;
+    runBody(bodyOf(bulk, bodyCopy), bulk.size(), urlPathOf(bulk.indexName()), false);
+}
+
+
+bool Bulk::Implementation::runBody(const std::string &bulkBody,
+                                   std::size_t size,
+                                   const std::string &urlPath,
+                                   bool replay)
+{
+    const std::string *body = &bulkBody;
+    // items to be sent again and their positions in the bulk
+    std::string retryBody;
+    std::vector<std::size_t> positions;
+    if (collectResult) {
+        result.impl->reset(size);
+    }
+
+    for (std::size_t attempt = 1; ; ++attempt) {
+        std::vector<ItemFailure> failures;
+        bool parsed = false;
+        long status = 0;
+        ++statistics.requests;
+        try {
+            const cpr::Response r = client->performRequest(Client::HTTPMethod::POST, urlPath,
+                                                           *body, priority);
+            status = r.status_code;
+            if (r.status_code / 100 != 2) {
+                throw ConnectionException("Elastic node not respond with status 2xx.");
+            }
+            parsed = processResult(r.text, size, positions, failures);
+        } catch(const ConnectionException &ex) {
+            LOG(LogLevel::ERROR, "Elastic cluster while indexing bulk: %s", ex.what());
+        }
+        if (!parsed && !status) {
+            // no host has responded, keep the items for later; replayed body is
+            // given back only if none of its items has been processed yet
+            if (replay && attempt == 1) {
+                return false;
+            }
+            if (spillQueue && spillQueue->append(urlPath, *body, size)) {
+                LOG(LogLevel::WARNING, "Cluster unavailable, %lu bulk items spilled.", size);
+                statistics.spilledItems += size;
+                return true;
+            }
+        }
+        if (!parsed) {
+            // whole bulk has failed
+            failures.clear();
+            for (std::size_t position = 0; position < size; ++position) {
+                failures.emplace_back(position, status, std::string());
+            }
+            setFailed(size, positions, status);
+        }
+        countRejected(failures);
+        if (failures.empty()) {
+            return true;
+        }
+
+        const bool canRetry = attempt < retryPolicy.maxAttempts;
+        const std::vector<std::pair<std::size_t, std::size_t>> items = splitBulkItems(*body);
+        std::string nextBody;
+        std::vector<std::size_t> nextPositions;
+        for (const ItemFailure &failure: failures) {
+            std::string item;
+            if (failure.position < items.size()) {
+                item.assign(*body, items[failure.position].first,
+                            items[failure.position].second);
+            }
+            if (canRetry && !item.empty() && isRetryable(failure.status)) {
+                nextBody += item;
+                nextPositions.push_back(positions.empty() ? failure.position
+                                                          : positions[failure.position]);
+            } else {
+                ++errCount;
+                failedItems.push_back(FailedItem{std::move(item), failure.status,
+                                                 failure.errorType});
+            }
+        }
+        if (nextPositions.empty()) {
+            return true;
+        }
+
+        const std::chrono::milliseconds wait = backoff(attempt + 1);
+        LOG(LogLevel::INFO, "Retrying %lu bulk items in %ld ms.", nextPositions.size(),
+            static_cast<long>(wait.count()));
+        std::this_thread::sleep_for(wait);
+        retryBody.swap(nextBody);
+        body = &retryBody;
+        size = nextPositions.size();
+        positions.swap(nextPositions);
+    }
+}
+
+
+void Bulk::Implementation::countRejected(const std::vector<ItemFailure> &failures) {
+    for (const ItemFailure &failure: failures) {
+        if (failure.status == 429) {
+            ++statistics.rejectedItems;
+        }
+    }
+}
+
+
+bool Bulk::Implementation::isRetryable(int status) const {
+    return status == 429 || status == 503 || (retryPolicy.retryConflicts && status == 409);
+}
+
+
+std::chrono::milliseconds Bulk::Implementation::backoff(std::size_t attempt) {
+    std::chrono::milliseconds delay = retryPolicy.initialBackoff;
+    for (std::size_t i = 2; i < attempt && delay < retryPolicy.maxBackoff; ++i) {
+        delay *= 2;
+    }
+    delay = std::min(delay, retryPolicy.maxBackoff);
+    // full delay or down to its half at random, so retries of more clients spread
+    std::uniform_int_distribution<long long> distribution(delay.count() / 2, delay.count());
+    return std::chrono::milliseconds(distribution(random));
+}
+
+
+void Bulk::Implementation::runParallel(std::vector<Part> &parts, std::size_t size) {
+    if (collectResult) {
+        result.impl->reset(size);
+    }
+    std::mutex mutex;
+    std::size_t nextPart = 0;
+    // each sender has its own state, merged into this one after each part
+    const auto sender = [this, &parts, &mutex, &nextPart]() {
+        Implementation state(client);
+        state.priority = priority;
+        state.retryPolicy = retryPolicy;
+        state.collectResult = collectResult;
+        state.spillQueue = spillQueue;
+        while (true) {
+            std::size_t partIndex;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (nextPart == parts.size()) {
+                    return;
+                }
+                partIndex = nextPart++;
+            }
+            Part &part = parts[partIndex];
+            state.errCount = 0;
+            state.failedItems.clear();
+            state.statistics = Statistics();
+            try {
+                bool sent = false;
+                if (part.client) {
+                    // part of node which does not respond is sent by the bulk Client
+                    state.client = part.client;
+                    sent = state.runBody(*part.body, part.size, part.urlPath, true);
+                    part.unreachable = !sent;
+                    state.client = client;
+                }
+                if (!sent) {
+                    state.runBody(*part.body, part.size, part.urlPath, false);
+                }
+            } catch (const std::exception &ex) {
+                LOG(LogLevel::ERROR, "Parallel bulk part failed: %s", ex.what());
+                state.client = client;
+                // whole part has failed, results of its sent attempts are dropped
+                state.errCount = part.size;
+                state.failedItems.clear();
+                for (const std::pair<std::size_t, std::size_t> &item:
+                        splitBulkItems(*part.body)) {
+                    state.failedItems.push_back(FailedItem{
+                            part.body->substr(item.first, item.second), 0, std::string()});
+                }
+                if (collectResult) {
+                    state.result.impl->reset(part.size);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            errCount += state.errCount;
+            statistics.requests += state.statistics.requests;
+            statistics.took += state.statistics.took;
+            statistics.rejectedItems += state.statistics.rejectedItems;
+            statistics.spilledItems += state.statistics.spilledItems;
+            std::move(state.failedItems.begin(), state.failedItems.end(),
+                      std::back_inserter(failedItems));
+            if (collectResult && part.positions.empty()) {
+                result.impl->merge(part.offset, *state.result.impl);
+            } else if (collectResult) {
+                result.impl->merge(part.positions, *state.result.impl);
+            }
+        }
+    };
+
+    std::vector<std::thread> senders;
+    const std::size_t count = std::min(std::max<std::size_t>(parallelism, 1), parts.size());
+    for (std::size_t i = 1; i < count; ++i) {
+        senders.emplace_back(sender);
+    }
+    // the calling thread sends parts as well
+    sender();
+    for (std::thread &thread: senders) {
+        thread.join();
+    }
+}
+
+
+void Bulk::Implementation::run(IBulkDataProducer &producer) {
+    // pull the first item in advance, empty bulk must not be sent
+    std::string firstItem;
+    if (!producer.next(firstItem)) {
+        return;
+    }
+    std::size_t size = 1;
+    const Client::BodyProducer countingProducer =
+            [&producer, &size, &firstItem](std::string &out) {
+        if (!firstItem.empty()) {
+            out.swap(firstItem);
+            return true;
+        }
+        if (!producer.next(out)) {
+            return false;
+        }
+        ++size;
+        return true;
+    };
+    ++statistics.requests;
+    long status = 0;
+    try {
+        const cpr::Response r = client->performStreamedRequest(
+                Client::HTTPMethod::POST, urlPathOf(producer.indexName()),
+                countingProducer, priority);
+        status = r.status_code;
+        if (r.status_code / 100 == 2) {
+            if (collectResult) {
+                result.impl->reset(size);
+            }
+            std::vector<ItemFailure> failures;
+            if (!processResult(r.text, size, std::vector<std::size_t>(), failures)) {
+                // probably whole bulk has failed
+                setFailed(size, std::vector<std::size_t>(), r.status_code);
+                errCount += size;
+                failedItems.resize(size, FailedItem{std::string(),
+                                                    static_cast<int>(r.status_code),
+                                                    std::string()});
+                return;
+            }
+            errCount += failures.size();
+            countRejected(failures);
+            for (const ItemFailure &failure: failures) {
+                failedItems.push_back(FailedItem{std::string(), failure.status,
+                                                 failure.errorType});
+            }
+            return;
+        }
+        LOG(LogLevel::ERROR, "Elastic node responded to streamed bulk with status %ld.",
+            static_cast<long>(r.status_code));
+    } catch(const ConnectionException &ex) {
+        LOG(LogLevel::ERROR, "Elastic cluster while indexing streamed bulk: %s", ex.what());
+    }
+
+    // whole bulk has failed, items not sent yet (the node may respond before reading
+    // whole body) are pulled and counted as failed too, nothing is dropped silently
+    std::string item;
+    try {
+        while (producer.next(item)) {
+            ++size;
+            item.clear();
+        }
+    } catch (const std::exception &producerEx) {
+        LOG(LogLevel::ERROR, "Producer of streamed bulk failed: %s", producerEx.what());
+    }
+    if (collectResult) {
+        result.impl->reset(size);
+    }
+    setFailed(size, std::vector<std::size_t>(), status);
+    if (status == 429) {
+        statistics.rejectedItems += size;
+    }
+    errCount += size;
+    failedItems.resize(size, FailedItem{std::string(), static_cast<int>(status),
+                                        std::string()});
+}
+
+
+std::size_t Bulk::perform(const IBulkData &bulk) {
+    impl->result.impl->reset(0);
+    if (bulk.empty()) { return 0; }
+
+    LOG(LogLevel::INFO, "Going to index %lu elements.", bulk.size());
+    impl->errCount = 0;
+    impl->failedItems.clear();
+    impl->statistics = Statistics();
+    impl->run(bulk);
+    return impl->errCount;
+}
+
+
+std::size_t Bulk::performParallel(const IBulkData &bulk, std::size_t subBulkSize) {
+    impl->result.impl->reset(0);
+    impl->errCount = 0;
+    impl->failedItems.clear();
+    impl->statistics = Statistics();
+    if (bulk.empty()) { return 0; }
+    if (!subBulkSize) {
+        throw std::runtime_error("Size of sub-bulks must be positive.");
+    }
+
+    LOG(LogLevel::INFO, "Going to index %lu elements in parallel.", bulk.size());
+    std::string bodyCopy;
+    const std::string &body = Implementation::bodyOf(bulk, bodyCopy);
+    const std::string urlPath = Implementation::urlPathOf(bulk.indexName());
+    const std::vector<std::pair<std::size_t, std::size_t>> items = splitBulkItems(body);
+
+    std::vector<Implementation::Part> parts((items.size() + subBulkSize - 1) / subBulkSize);
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+        Implementation::Part &part = parts[i];
+        part.offset = i * subBulkSize;
+        part.size = std::min(subBulkSize, items.size() - part.offset);
+        const std::size_t start = items[part.offset].first;
+        const std::pair<std::size_t, std::size_t> &last = items[part.offset + part.size - 1];
+        part.ownedBody.assign(body, start, last.first + last.second - start);
+        part.body = &part.ownedBody;
+        part.urlPath = urlPath;
+    }
+    impl->runParallel(parts, items.size());
+    return impl->errCount;
+}
+
+
+std::size_t Bulk::performParallel(const std::vector<const IBulkData *> &bulks) {
+    impl->result.impl->reset(0);
+    impl->errCount = 0;
+    impl->failedItems.clear();
+    impl->statistics = Statistics();
+
+    std::vector<Implementation::Part> parts;
+    std::size_t size = 0;
+    for (const IBulkData *bulk: bulks) {
+        if (bulk && !bulk->empty()) {
+            parts.emplace_back();
+            parts.back().size = bulk->size();
+            parts.back().offset = size;
+            size += bulk->size();
+        }
+    }
+    if (parts.empty()) { return 0; }
+
+    LOG(LogLevel::INFO, "Going to index %lu elements of %lu bulks in parallel.",
+        size, parts.size());
+    std::size_t part = 0;
+    for (const IBulkData *bulk: bulks) {
+        if (bulk && !bulk->empty()) {
+            parts[part].body = &Implementation::bodyOf(*bulk, parts[part].ownedBody);
+            parts[part].urlPath = Implementation::urlPathOf(bulk->indexName());
+            ++part;
+        }
+    }
+    impl->runParallel(parts, size);
+    return impl->errCount;
+}
+
+
+std::size_t Bulk::performRouted(const IBulkData &bulk, BulkShardRouter &router) {
+    impl->result.impl->reset(0);
+    impl->errCount = 0;
+    impl->failedItems.clear();
+    impl->statistics = Statistics();
+    if (bulk.empty()) { return 0; }
+
+    std::string bodyCopy;
+    const std::string &body = Implementation::bodyOf(bulk, bodyCopy);
+    std::vector<RoutedGroup> groups = router.impl->partition(body, bulk.indexName());
+    LOG(LogLevel::INFO, "Going to index %lu elements in %lu routed bulks.",
+        bulk.size(), groups.size());
+
+    const std::string urlPath = Implementation::urlPathOf(bulk.indexName());
+    std::vector<Implementation::Part> parts(groups.size());
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < groups.size(); ++i) {
+        Implementation::Part &part = parts[i];
+        part.ownedBody.swap(groups[i].body);
+        part.body = &part.ownedBody;
+        part.size = groups[i].positions.size();
+        part.positions.swap(groups[i].positions);
+        part.client = std::move(groups[i].client);
+        part.urlPath = urlPath;
+        size += part.size;
+    }
+    impl->runParallel(parts, size);
+
+    // primaries have probably moved, read their locations again
+    for (const Implementation::Part &part: parts) {
+        if (part.unreachable) {
+            router.invalidate();
+            break;
+        }
+    }
+    return impl->errCount;
+}
+
+
+std::size_t Bulk::perform(IBulkDataProducer &producer) {
+    LOG(LogLevel::INFO, "Going to index streamed bulk.");
+    impl->result.impl->reset(0);
+    impl->errCount = 0;
+    impl->failedItems.clear();
+    impl->statistics = Statistics();
+    impl->run(producer);
+    return impl->errCount;
+}
+
+
+bool Bulk::Implementation::processResult(
+        const std::string &response, std::size_t size,
+        const std::vector<std::size_t> &positions,
+        std::vector<ItemFailure> &failures)
+{
+    // Expected response:
+    // {"took": int,
+    //  "errors": false,
+    //  "items": [
+    //      {"index": {
+    //          "_index": string,
+    //          "_type": string,
+    //          "_id": string,
+    //          "_version": int,
+    //          "_shards": {"total": int, "successful": int, "failed": int},
+    //          "status": 201}}
+    //  ]}
+    // Response is scanned without building a document tree, only fields of
+    // BulkItemResponse are read.
+    BulkResponseScanner scanner(response);
+
+    // if errors flag is false, do not read single responses
+    // unless their results are collected
+    const BulkResponseScanner::Start start = scanner.start(!collectResult);
+    if (scanner.took() > 0) {
+        statistics.took += std::chrono::milliseconds(scanner.took());
+    }
+    switch (start) {
+        case BulkResponseScanner::Start::INVALID:
+            return false;
+        case BulkResponseScanner::Start::NO_ERRORS:
+            // everything is alright, errors==false.
+            return true;
+        case BulkResponseScanner::Start::NO_ITEMS:
+            LOG(LogLevel::WARNING, "Bulk ran with errors, but no items are present "
+                                   "at the response! Counting all items as failed.");
+            setUnanswered(0, size, positions, failures);
+            return true;
+        case BulkResponseScanner::Start::ITEMS_NOT_ARRAY:
+            LOG(LogLevel::WARNING, "Failed to read elastic response field 'items', because "
+                                   "it is not an array! Counting all items as failed.");
+            setUnanswered(0, size, positions, failures);
+            return true;
+        case BulkResponseScanner::Start::ITEMS:
+            break;
+    }
+
+    // process items responses, they are in the same order as bulk items
+    std::size_t position = 0;
+    for (; position < size && scanner.nextItem(item); ++position) {
+        // check response of the action (index, create, update, delete)
+        if (item.action.empty()) {
+            LOG(LogLevel::WARNING, "Bulk items responses have to be objects with action "
+                                   "result object!");
+            setUnanswered(position, position + 1, positions, failures);
+            continue;
+        }
+        if (!item.statusValid) {
+            LOG(LogLevel::WARNING, "Bulk response was expected to have numeric status. "
+                                   "Counting the item as failed.");
+            setUnanswered(position, position + 1, positions, failures);
+            continue;
+        }
+
+        // if status code is not 2xx family, consider it as error,
+        // except delete of already missing document
+        const BulkResult::Action action = BulkResult::Implementation::parseAction(item.action);
+        if (BulkResult::Implementation::isFailure(item.status, action)) {
+            failures.emplace_back(position, item.status, item.errorType);
+        }
+
+        if (collectResult) {
+            result.impl->set(positions.empty() ? position : positions[position], action,
+                             item.id, item.status, item.errorType, item.errorReason);
+        }
+    }
+    if (!scanner.valid()) {
+        return false;
+    }
+
+    // complain if not all items of the bulk were covered by responses
+    if (position < size) {
+        LOG(LogLevel::INFO, "Bulk has more items than responses received. Cannot tell "
+                            "whether %lu items succeeded, counting them as failed.",
+            size - position);
+        setUnanswered(position, size, positions, failures);
+    }
+    return true;
+}
+
+
+void Bulk::Implementation::setFailed(std::size_t size,
+                                     const std::vector<std::size_t> &positions,
+                                     int status)
+{
+    if (!collectResult) {
+        return;
+    }
+    for (std::size_t position = 0; position < size; ++position) {
+        result.impl->set(positions.empty() ? position : positions[position],
+                         BulkResult::Action::UNKNOWN, std::string(), status,
+                         std::string(), std::string());
+    }
+}
+
+
+void Bulk::Implementation::setUnanswered(std::size_t first, std::size_t size,
+                                         const std::vector<std::size_t> &positions,
+                                         std::vector<ItemFailure> &failures)
+{
+    for (std::size_t position = first; position < size; ++position) {
+        failures.emplace_back(position, 0, std::string());
+        if (collectResult) {
+            result.impl->set(positions.empty() ? position : positions[position],
+                             BulkResult::Action::UNKNOWN, std::string(), 0,
+                             std::string(), std::string());
+        }
+    }
+}
+
+
+void Bulk::setSpillQueue(const std::shared_ptr<BulkSpillQueue> &queue) {
+    impl->spillQueue = queue;
+}
+
+
+const Bulk::Statistics &Bulk::getStatistics() const {
+    return impl->statistics;
+}
+
+
+void Bulk::setParallelism(std::size_t parallelism) {
+    impl->parallelism = parallelism;
+}
+
+
+void Bulk::setResultCollection(bool enabled) {
+    impl->collectResult = enabled;
+}
+
+
+const BulkResult &Bulk::getResult() const {
+    return impl->result;
+}
+
+
+void Bulk::setRequestPriority(Client::RequestPriority priority) {
+    impl->priority = priority;
+}
+
+
+std::size_t Bulk::getErrorCount() const {
+    return impl->errCount;
+}
+
+
+const std::vector<Bulk::FailedItem> &Bulk::getFailedItems() const {
+    return impl->failedItems;
+}
+
+
+void Bulk::setRetryPolicy(const RetryPolicy &policy) {
+    impl->retryPolicy = policy;
 }
 
 
@@ -13,7 +13,11 @@
 #include <cstdint>
 #include <random>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
 #include <time.h>
+#include <curl/curl.h>
 #include <cpr/session.h>
 #include <cpr/proxies.h>
 #include "logging-impl.h"
@@ -37,10 +41,219 @@ class RandomUIntGenerator {
 };
 
 
+class ConnectionShare::Implementation {
+    /// Curl share handle.
+    CURLSH *share;
+    /// Locks for data shared via curl share handle, one per curl_lock_data.
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+    /// True if connection cache is shared too.
+    const bool shareConnections;
+
+    friend class ConnectionShare;
+
+  public:
+    explicit Implementation(bool shareConnections);
+    ~Implementation();
+
+    /// Attach curl easy \p handle to the share.
+    void attach(CURL *handle) {
+        curl_easy_setopt(handle, CURLOPT_SHARE, share);
+    }
+
+  private:
+    /// Curl lock callback.
+    static void lock(CURL *, curl_lock_data data, curl_lock_access, void *userptr);
+    /// Curl unlock callback.
+    static void unlock(CURL *, curl_lock_data data, void *userptr);
+};
+
+
+/**
+ * Elasticsearch node address parsed from host URL.
+ *
+ * Host URL in form "unix:///path/to/socket" (optionally ending by "/") means node
+ * (or local proxy) reachable over Unix domain socket.
+ */
+struct HostAddress {
+    /// URL the urlPath of the request is appended to.
+    std::string url;
+    /// Path to Unix domain socket, empty for TCP.
+    std::string unixSocketPath;
+
+    explicit HostAddress(const std::string &hostUrl);
+};
+
+
+/**
+ * Request body pulled from Client::BodyProducer by curl read callback.
+ * Keeps only the last produced part of the body.
+ */
+class StreamedBody {
+    const Client::BodyProducer &producer;
+    /// Last produced part of the body.
+    std::string window;
+    /// Number of window bytes already passed to curl.
+    std::size_t offset;
+    bool started;
+    bool finished;
+
+  public:
+    explicit StreamedBody(const Client::BodyProducer &producer)
+      : producer(producer), window(), offset(0), started(false), finished(false)
+    {}
+
+    /// Return true if any part of the body has been pulled from producer.
+    bool isStarted() const {
+        return started;
+    }
+
+    /// Curl read callback, \p userdata is StreamedBody.
+    static std::size_t read(char *buffer, std::size_t size, std::size_t nitems,
+                            void *userdata);
+};
+
+
+/**
+ * Curl multi handle performing transfers of all sessions of the client. The sessions
+ * share its connection cache, so HTTP/2 requests are multiplexed over one connection
+ * per node and number of connections per node can be limited.
+ *
+ * The multi handle is driven by one of the threads waiting for their transfers at
+ * a time, the others sleep until their transfer is done or until they have to take
+ * the driving over. Curl older than 7.68 performs each transfer on its own.
+ */
+class TransferMultiplexer {
+    /// Transfer of one session.
+    struct Transfer {
+        CURL *handle;
+        bool done;
+        CURLcode result;
+    };
+
+    CURLM *multi;
+    /// Guards all members below.
+    std::mutex mutex;
+    /// Signalled when a transfer is done or a thread stops driving the multi handle.
+    std::condition_variable transferDone;
+    /// Transfers to be added to the multi handle by the driving thread.
+    std::vector<Transfer *> pending;
+    /// Transfers added to the multi handle.
+    std::vector<Transfer *> running;
+    /// True while a thread drives the multi handle.
+    bool driving;
+    /// Connection limit per host to be applied by the driving thread.
+    std::size_t maxHostConnections;
+    bool optionsChanged;
+
+  public:
+    TransferMultiplexer();
+    ~TransferMultiplexer();
+    TransferMultiplexer(const TransferMultiplexer &) = delete;
+    TransferMultiplexer &operator=(const TransferMultiplexer &) = delete;
+
+    /// Set maximal number of connections per host, 0 for unlimited.
+    void setMaxHostConnections(std::size_t maxConnections);
+
+    /// Perform transfer of curl easy \p handle, return its result.
+    CURLcode perform(CURL *handle);
+
+  private:
+    /// Drive the multi handle until \p own transfer is done (mutex locked by \p lock).
+    void drive(Transfer &own, std::unique_lock<std::mutex> &lock);
+};
+
+
 class Client::Implementation {
+    /// Options applied to every session of the pool.
+    struct SessionConfig {
+        /// Request timeout [ms].
+        std::int32_t timeout;
+        /// Connection timeout [ms], negative if not set.
+        std::int32_t connectTimeout;
+        /// Proxies, applied only if hasProxies is set.
+        cpr::Proxies proxies;
+        bool hasProxies;
+        /// SSL options, applied only if hasSslOptions is set.
+        cpr::SslOptions sslOptions;
+        bool hasSslOptions;
+        /// Shared state sessions are attached to - must outlive the sessions.
+        std::shared_ptr<ConnectionShare> connectionShare;
+        /// Negotiate HTTP/2 if true.
+        bool http2;
+
+        explicit SessionConfig(std::int32_t timeout)
+          : timeout(timeout), connectTimeout(-1), proxies(), hasProxies(false),
+            sslOptions(), hasSslOptions(false), connectionShare(), http2(false)
+        {}
+    };
+
+    /// Session of the pool and generation of config it has been set up with.
+    struct PooledSession {
+        cpr::Session session;
+        std::size_t configGeneration;
+
+        PooledSession(): session(), configGeneration(0) {}
+    };
+
+    /// Requests of one priority class waiting for a session.
+    struct WaitQueue {
+        /// Number of waiting requests.
+        std::size_t count;
+        /// Ticket to be given to next waiting request.
+        std::size_t nextTicket;
+        /// Ticket of request to be served next.
+        std::size_t servedTicket;
+
+        WaitQueue(): count(0), nextTicket(0), servedTicket(0) {}
+    };
+
+    /// Number of RequestPriority classes.
+    static const std::size_t priorityClasses = 3;
+
+    /// Borrows session from the pool and returns it back when destroyed.
+    class SessionLease {
+        Implementation &impl;
+        PooledSession *pooled;
+      public:
+        SessionLease(Implementation &impl, RequestPriority priority)
+          : impl(impl), pooled(impl.acquireSession(priority))
+        {}
+        ~SessionLease() {
+            impl.releaseSession(pooled);
+        }
+        SessionLease(const SessionLease &) = delete;
+        SessionLease &operator=(const SessionLease &) = delete;
+
+        cpr::Session &session() {
+            return pooled->session;
+        }
+    };
+
     const std::vector<std::string> hostUrlList;
-    cpr::Session session;
-    uint32_t currentHostIndex, failCounter;
+    /// Parsed hostUrlList.
+    const std::vector<HostAddress> hosts;
+    /// Performs transfers of all sessions - outlives them.
+    TransferMultiplexer transfers;
+    /// Guards session pool, config and current host selection.
+    std::mutex mutex;
+    /// Signalled when a session is returned to the pool.
+    std::condition_variable sessionReleased;
+    SessionConfig config;
+    /// Incremented on each config change, so sessions are set up again.
+    std::size_t configGeneration;
+    /// Maximal number of sessions (connections to cluster), 0 for unlimited.
+    std::size_t maxSessions;
+    /// Number of sessions LOW priority requests can not use.
+    std::size_t reservedSessions;
+    /// Requests waiting for a session, indexed by RequestPriority.
+    WaitQueue waiting[priorityClasses];
+    /// All sessions of the pool.
+    std::vector<std::unique_ptr<PooledSession>> sessions;
+    /// Sessions not currently used by any request.
+    std::vector<PooledSession *> idleSessions;
+    uint32_t currentHostIndex;
+    /// True if requests start on hosts in round robin order.
+    bool loadBalancing;
     RandomUIntGenerator uintGenerator;
 
     friend class Client;
@@ -49,57 +262,94 @@ class Client::Implementation {
     Implementation(const std::vector<std::string> &hostUrlList,
             std::int32_t timeout,
             const std::initializer_list<std::pair<const std::string, std::string>>& proxyUrlList = {})
-      : hostUrlList(hostUrlList), session(), currentHostIndex(0), failCounter(0), uintGenerator()
+      : hostUrlList(hostUrlList), hosts(hostUrlList.begin(), hostUrlList.end()), transfers(),
+        mutex(),
+        sessionReleased(), config(timeout),
+        configGeneration(1), maxSessions(0), reservedSessions(0), waiting(), sessions(),
+        idleSessions(), currentHostIndex(0), loadBalancing(false),
+        uintGenerator()
     {
         if (hostUrlList.empty()) {
             throw std::runtime_error("Hosts URL list can not be empty.");
         }
 
         if (proxyUrlList.size()) {
-            session.SetProxies(cpr::Proxies(proxyUrlList));
+            config.proxies = cpr::Proxies(proxyUrlList);
+            config.hasProxies = true;
         }
-        session.SetTimeout(timeout);
         resetCurrentHostInfo();
     }
 
   private:
-    /// Reset currentHostIndex and failCounter.
+    /// Reset currentHostIndex to random host.
     void resetCurrentHostInfo() {
         currentHostIndex = uintGenerator.getRandom(0, hostUrlList.size()-1);
-        failCounter = 0;
     }
 
-    /// If it is possible to increment currentHostIndex - return true, return false otherwise.
-    bool failCurrentHostAndIterateNext() {
-        if (++failCounter >= hostUrlList.size()) {
-            resetCurrentHostInfo();
-            return false;
-        }
-        if (++currentHostIndex >= hostUrlList.size()) {
-            currentHostIndex = 0;
-        }
-        return true;
+    /**
+     * Borrow session from the pool. Creates new session if there is no idle one
+     * and the pool is not full, waits for another request to finish otherwise.
+     * Waiting requests of higher \p priority are served first.
+     */
+    PooledSession *acquireSession(RequestPriority priority);
+
+    /// Return true if request of \p priority may take a session now (mutex locked).
+    bool isSessionAvailable(RequestPriority priority) const;
+
+    /// Return true if request of higher than \p priority is waiting (mutex locked).
+    bool hasHigherPriorityWaiting(RequestPriority priority) const;
+
+    /// Return session borrowed by acquireSession() to the pool.
+    void releaseSession(PooledSession *pooled);
+
+    /// Set up \p session according to current config (called with mutex locked).
+    void configureSession(cpr::Session &session) const;
+
+    /// Apply \p modifier on config and let sessions to be set up again.
+    template <typename Modifier>
+    void modifyConfig(Modifier modifier) {
+        std::lock_guard<std::mutex> lock(mutex);
+        modifier(config);
+        ++configGeneration;
     }
 
     /**
-     * Perform request on current Elastic node.
+     * Perform request set up in \p session by the multiplexer, fill \p response.
+     * \param url URL of the request reported in the response.
+     */
+    void performTransfer(cpr::Session &session, const std::string &url,
+                         cpr::Response &response);
+
+    /**
+     * Perform request on given Elastic node.
+     * \param session Session (connection) to be used.
+     * \param host    Address of the node.
      * \param method  One of Client::HTTPMethod.
      * \param urlPath Part of URL imidiately behind "scheme://host/".
      * \param body    Request body.
+     * \param stream  Streamed request body used instead of \p body, nullptr if not used.
      * \param response cpr::Response& to be response store there.
      *
      * \return true if request was sucessfully performed.
      * \return false if host failed for this request.
      */
-    bool performRequestOnCurrentHost(Client::HTTPMethod method,
-                                     const std::string &urlPath,
-                                     const std::string &body,
-                                     cpr::Response &response);
+    bool performRequestOnHost(cpr::Session &session,
+                              const HostAddress &host,
+                              Client::HTTPMethod method,
+                              const std::string &urlPath,
+                              const std::string &body,
+                              StreamedBody *stream,
+                              cpr::Response &response);
 
-    /// \see Client::performRequest
+    /**
+     * \see Client::performRequest
+     * \see Client::performStreamedRequest if \p stream is not nullptr.
+     */
     cpr::Response performRequest(Client::HTTPMethod method,
                                  const std::string &urlPath,
-                                 const std::string &body = std::string());
+                                 const std::string &body,
+                                 RequestPriority priority,
+                                 StreamedBody *stream = nullptr);
 
     /// Set client option from ClientOption derived classes.
     void setClientOption(const ClientOption &opt) {
@@ -115,6 +365,18 @@ class Client::Implementation {
     void visit(const ProxiesOption &);
     /// Set SSL options from given instance.
     void visit(const SSLOption &);
+    /// Attach sessions to the connection share from given instance.
+    void visit(const ConnectionShareOption &);
+    /// Set HTTP/2 negotiation from given instance.
+    void visit(const HTTP2Option &);
+    /// Set maximal number of connections from given instance.
+    void visit(const MaxConnectionsOption &);
+    /// Set maximal number of connections per node from given instance.
+    void visit(const MaxHostConnectionsOption &);
+    /// Set number of connections reserved for priority requests from given instance.
+    void visit(const ReservedConnectionsOption &);
+    /// Set round robin selection of hosts from given instance.
+    void visit(const LoadBalancingOption &);
 };
 
 
@@ -8,6 +8,8 @@
 
 #include <sstream>
 #include <memory>
+#include <algorithm>
+#include <cstdio>
 #include <cpr/cpr.h>
 #include "logging-impl.h"
 
@@ -52,11 +54,244 @@ void fillRoutingInUrlPath(const std::string &routing, std::ostringstream &urlPat
 }
 
 
+/// Curl write callback appending response body to std::string \p userdata.
+std::size_t writeBody(char *data, std::size_t size, std::size_t nmemb, void *userdata) {
+    static_cast<std::string *>(userdata)->append(data, size * nmemb);
+    return size * nmemb;
+}
+
+
+/// Curl header callback storing response headers to cpr::Header \p userdata.
+std::size_t writeHeader(char *data, std::size_t size, std::size_t nmemb, void *userdata) {
+    cpr::Header &header = *static_cast<cpr::Header *>(userdata);
+    const std::string line(data, size * nmemb);
+    if (line.compare(0, 5, "HTTP/") == 0) {
+        // headers of interim response (100 Continue, 101 Switching Protocols) are dropped
+        header.clear();
+        return size * nmemb;
+    }
+    const std::size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+        const std::size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+        const std::size_t valueEnd = line.find_last_not_of(" \t\r\n");
+        header[line.substr(0, colon)] = valueStart == std::string::npos || valueEnd < valueStart
+                ? std::string() : line.substr(valueStart, valueEnd - valueStart + 1);
+    }
+    return size * nmemb;
+}
+
+
 } // anonymous namespace
 
 
 namespace elasticlient {
 
+
+HostAddress::HostAddress(const std::string &hostUrl)
+  : url(hostUrl), unixSocketPath()
+{
+    static const std::string unixScheme = "unix://";
+    if (hostUrl.compare(0, unixScheme.size(), unixScheme) != 0) {
+        return;
+    }
+    unixSocketPath = hostUrl.substr(unixScheme.size());
+    while (unixSocketPath.size() > 1 && unixSocketPath.back() == '/') {
+        unixSocketPath.pop_back();
+    }
+    if (unixSocketPath.empty()) {
+        throw std::runtime_error("Unix socket host URL has to contain path to the socket.");
+    }
+#if LIBCURL_VERSION_NUM < 0x072800
+    throw std::runtime_error("Curl does not support Unix domain sockets.");
+#endif
+    // host part is ignored by curl when connecting over unix socket
+    url = "http://localhost/";
+}
+
+
+ConnectionShare::Implementation::Implementation(bool shareConnections)
+  : share(curl_share_init()), locks(), shareConnections(shareConnections)
+{
+    if (!share) {
+        throw std::runtime_error("Failed to initialize curl share handle.");
+    }
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, &Implementation::lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, &Implementation::unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    if (shareConnections) {
+#if LIBCURL_VERSION_NUM >= 0x073900
+        if (curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT) == CURLSHE_OK) {
+            return;
+        }
+#endif
+        LOG(LogLevel::WARNING, "Curl does not support sharing of connection cache.");
+    }
+}
+
+
+ConnectionShare::Implementation::~Implementation() {
+    if (curl_share_cleanup(share) != CURLSHE_OK) {
+        LOG(LogLevel::ERROR, "Curl share handle destroyed while still in use.");
+    }
+}
+
+
+void ConnectionShare::Implementation::lock(
+        CURL *, curl_lock_data data, curl_lock_access, void *userptr)
+{
+    static_cast<Implementation *>(userptr)->locks[data].lock();
+}
+
+
+void ConnectionShare::Implementation::unlock(CURL *, curl_lock_data data, void *userptr) {
+    static_cast<Implementation *>(userptr)->locks[data].unlock();
+}
+
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+TransferMultiplexer::TransferMultiplexer()
+  : multi(curl_multi_init()), mutex(), transferDone(), pending(), running(), driving(false),
+    maxHostConnections(0), optionsChanged(false)
+{
+    if (!multi) {
+        throw std::runtime_error("Failed to initialize curl multi handle.");
+    }
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+}
+
+
+TransferMultiplexer::~TransferMultiplexer() {
+    curl_multi_cleanup(multi);
+}
+
+
+void TransferMultiplexer::setMaxHostConnections(std::size_t maxConnections) {
+    std::lock_guard<std::mutex> lock(mutex);
+    maxHostConnections = maxConnections;
+    optionsChanged = true;
+}
+
+
+CURLcode TransferMultiplexer::perform(CURL *handle) {
+    Transfer transfer = {handle, false, CURLE_OK};
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.push_back(&transfer);
+    if (driving) {
+        // interrupt the driving thread waiting for sockets, so it adds the transfer
+        curl_multi_wakeup(multi);
+    }
+    while (!transfer.done) {
+        if (driving) {
+            transferDone.wait(lock);
+            continue;
+        }
+        drive(transfer, lock);
+    }
+    return transfer.result;
+}
+
+
+void TransferMultiplexer::drive(Transfer &own, std::unique_lock<std::mutex> &lock) {
+    driving = true;
+    while (!own.done) {
+        if (optionsChanged) {
+            curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+                              static_cast<long>(maxHostConnections));
+            optionsChanged = false;
+        }
+        for (Transfer *transfer: pending) {
+            const CURLMcode code = curl_multi_add_handle(multi, transfer->handle);
+            if (code != CURLM_OK) {
+                transfer->result = CURLE_FAILED_INIT;
+                transfer->done = true;
+                transferDone.notify_all();
+                LOG(LogLevel::ERROR, "Failed to add transfer: %s", curl_multi_strerror(code));
+            } else {
+                running.push_back(transfer);
+            }
+        }
+        pending.clear();
+        lock.unlock();
+
+        // only the driving thread touches the multi handle, so it works without lock
+        int stillRunning = 0;
+        curl_multi_perform(multi, &stillRunning);
+        std::vector<std::pair<CURL *, CURLcode>> finished;
+        int queued = 0;
+        while (CURLMsg *message = curl_multi_info_read(multi, &queued)) {
+            if (message->msg == CURLMSG_DONE) {
+                finished.emplace_back(message->easy_handle, message->data.result);
+            }
+        }
+        for (const std::pair<CURL *, CURLcode> &transfer: finished) {
+            curl_multi_remove_handle(multi, transfer.first);
+        }
+
+        lock.lock();
+        for (const std::pair<CURL *, CURLcode> &done: finished) {
+            for (std::size_t i = 0; i < running.size(); ++i) {
+                if (running[i]->handle == done.first) {
+                    running[i]->result = done.second;
+                    running[i]->done = true;
+                    running[i] = running.back();
+                    running.pop_back();
+                    break;
+                }
+            }
+        }
+        if (!finished.empty()) {
+            transferDone.notify_all();
+        }
+        if (own.done || !pending.empty()) {
+            continue;
+        }
+        lock.unlock();
+        curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        lock.lock();
+    }
+    driving = false;
+    // one of the threads still waiting has to take the driving over
+    transferDone.notify_all();
+}
+#else
+TransferMultiplexer::TransferMultiplexer()
+  : multi(nullptr), mutex(), transferDone(), pending(), running(), driving(false),
+    maxHostConnections(0), optionsChanged(false)
+{}
+
+
+TransferMultiplexer::~TransferMultiplexer() {}
+
+
+void TransferMultiplexer::setMaxHostConnections(std::size_t) {
+    LOG(LogLevel::WARNING, "Curl does not support limiting connections per host.");
+}
+
+
+CURLcode TransferMultiplexer::perform(CURL *handle) {
+    return curl_easy_perform(handle);
+}
+
+
+void TransferMultiplexer::drive(Transfer &, std::unique_lock<std::mutex> &) {}
+#endif
+
+
+ConnectionShare::ConnectionShare(bool shareConnections)
+  : impl(new Implementation(shareConnections))
+{}
+
+
+ConnectionShare::~ConnectionShare() = default;
+
+
+bool ConnectionShare::sharesConnections() const {
+    return impl->shareConnections;
+}
+
+
 void Client::TimeoutOption::accept(Implementation &impl) const {
     impl.visit(*this);
 }
@@ -65,6 +300,30 @@ void Client::ConnectTimeoutOption::accept(Implementation &impl) const {
     impl.visit(*this);
 }
 
+void Client::ConnectionShareOption::accept(Implementation &impl) const {
+    impl.visit(*this);
+}
+
+void Client::HTTP2Option::accept(Implementation &impl) const {
+    impl.visit(*this);
+}
+
+void Client::MaxConnectionsOption::accept(Implementation &impl) const {
+    impl.visit(*this);
+}
+
+void Client::MaxHostConnectionsOption::accept(Implementation &impl) const {
+    impl.visit(*this);
+}
+
+void Client::ReservedConnectionsOption::accept(Implementation &impl) const {
+    impl.visit(*this);
+}
+
+void Client::LoadBalancingOption::accept(Implementation &impl) const {
+    impl.visit(*this);
+}
+
 
 class Client::ProxiesOption::ProxiesOptionImplementation {
     cpr::Proxies proxies;
@@ -148,48 +407,268 @@ void Client::setClientOption(const ClientOption &opt) {
 cpr::Response Client::performRequest(
         HTTPMethod method, const std::string &urlPath, const std::string &body)
 {
-   return impl->performRequest(method, urlPath, body);
+   return impl->performRequest(method, urlPath, body, RequestPriority::NORMAL);
+}
+
+
+cpr::Response Client::performRequest(HTTPMethod method,
+                                     const std::string &urlPath,
+                                     const std::string &body,
+                                     RequestPriority priority)
+{
+   return impl->performRequest(method, urlPath, body, priority);
+}
+
+
+cpr::Response Client::performStreamedRequest(HTTPMethod method,
+                                             const std::string &urlPath,
+                                             const BodyProducer &producer,
+                                             RequestPriority priority)
+{
+    if (method != HTTPMethod::POST && method != HTTPMethod::PUT) {
+        throw std::runtime_error("Only POST and PUT requests can have streamed body.");
+    }
+    StreamedBody stream(producer);
+    return impl->performRequest(method, urlPath, std::string(), priority, &stream);
+}
+
+
+std::size_t StreamedBody::read(char *buffer, std::size_t size, std::size_t nitems,
+                               void *userdata)
+{
+    StreamedBody &body = *static_cast<StreamedBody *>(userdata);
+    const std::size_t capacity = size * nitems;
+    std::size_t written = 0;
+    while (written < capacity) {
+        if (body.offset == body.window.size()) {
+            if (body.finished) {
+                break;
+            }
+            // reuse window memory for next part of the body
+            body.window.clear();
+            body.offset = 0;
+            body.started = true;
+            try {
+                body.finished = !body.producer(body.window);
+            } catch (const std::exception &ex) {
+                LOG(LogLevel::ERROR, "Producer of streamed body failed: %s", ex.what());
+                return CURL_READFUNC_ABORT;
+            }
+            continue;
+        }
+        const std::size_t n = std::min(capacity - written, body.window.size() - body.offset);
+        body.window.copy(buffer + written, n, body.offset);
+        body.offset += n;
+        written += n;
+    }
+    return written;
+}
+
+
+bool Client::Implementation::isSessionAvailable(RequestPriority priority) const {
+    if (!maxSessions) {
+        return true;
+    }
+    std::size_t limit = maxSessions;
+    if (priority == RequestPriority::LOW) {
+        limit = reservedSessions < maxSessions ? maxSessions - reservedSessions : 1;
+    }
+    return sessions.size() - idleSessions.size() < limit;
+}
+
+
+bool Client::Implementation::hasHigherPriorityWaiting(RequestPriority priority) const {
+    for (std::size_t p = std::size_t(priority) + 1; p < priorityClasses; ++p) {
+        if (waiting[p].count) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+Client::Implementation::PooledSession *Client::Implementation::acquireSession(
+        RequestPriority priority)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    WaitQueue &queue = waiting[std::size_t(priority)];
+    const std::size_t ticket = queue.nextTicket++;
+    ++queue.count;
+    // requests of same priority are served in FIFO order, after all higher priority ones
+    auto isServed = [this, &queue, ticket, priority]() {
+        return queue.servedTicket == ticket
+               && !hasHigherPriorityWaiting(priority)
+               && isSessionAvailable(priority);
+    };
+    if (!isServed()) {
+        LOG(LogLevel::DEBUG, "Request of priority %d waits for a free session.",
+            static_cast<int>(priority));
+        sessionReleased.wait(lock, isServed);
+    }
+    --queue.count;
+    ++queue.servedTicket;
+
+    PooledSession *pooled;
+    if (!idleSessions.empty()) {
+        pooled = idleSessions.back();
+        idleSessions.pop_back();
+    } else {
+        sessions.emplace_back(new PooledSession());
+        pooled = sessions.back().get();
+        LOG(LogLevel::DEBUG, "Created session %lu of the client.", sessions.size());
+    }
+
+    if (pooled->configGeneration != configGeneration) {
+        configureSession(pooled->session);
+        pooled->configGeneration = configGeneration;
+    }
+    lock.unlock();
+    // let the next waiting request check whether it can go
+    sessionReleased.notify_all();
+    return pooled;
+}
+
+
+void Client::Implementation::releaseSession(PooledSession *pooled) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idleSessions.push_back(pooled);
+    }
+    sessionReleased.notify_all();
+}
+
+
+void Client::Implementation::configureSession(cpr::Session &session) const {
+    session.SetTimeout(cpr::Timeout{config.timeout});
+    if (config.connectTimeout >= 0) {
+        session.SetConnectTimeout(cpr::ConnectTimeout{config.connectTimeout});
+    }
+    if (config.hasProxies) {
+        session.SetProxies(config.proxies);
+    }
+    if (config.hasSslOptions) {
+        session.SetSslOptions(config.sslOptions);
+    }
+
+    CURL *handle = session.GetCurlHolder()->handle;
+    if (config.connectionShare) {
+        config.connectionShare->impl->attach(handle);
+    } else {
+        curl_easy_setopt(handle, CURLOPT_SHARE, nullptr);
+    }
+    // CURL_HTTP_VERSION_2_0 uses ALPN for https and h2c upgrade for http, falling back to 1.1
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION,
+                     config.http2 ? CURL_HTTP_VERSION_2_0 : CURL_HTTP_VERSION_NONE);
+    // wait for connection being set up to learn whether it multiplexes, not to open another
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, config.http2 ? 1L : 0L);
 }
 
 
-bool Client::Implementation::performRequestOnCurrentHost(Client::HTTPMethod method,
-                                                         const std::string &urlPath,
-                                                         const std::string &body,
-                                                         cpr::Response &response)
+void Client::Implementation::performTransfer(cpr::Session &session,
+                                             const std::string &url,
+                                             cpr::Response &response)
 {
-    const std::string entireUrl = hostUrlList[currentHostIndex] + urlPath;
+    CURL *handle = session.GetCurlHolder()->handle;
+    std::string text;
+    cpr::Header header;
+    char errorBuffer[CURL_ERROR_SIZE];
+    errorBuffer[0] = '\0';
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, &writeBody);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &text);
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, &writeHeader);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, &header);
+    curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, errorBuffer);
+
+    const CURLcode result = transfers.perform(handle);
+
+    // the handle must not refer to the locals above any more
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, nullptr);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, nullptr);
+    curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, nullptr);
+
+    response = cpr::Response();
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response.status_code);
+    curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME, &response.elapsed);
+    response.text = std::move(text);
+    response.header = std::move(header);
+    response.url = url;
+    if (result != CURLE_OK) {
+        response.error = cpr::Error(result, std::string(errorBuffer[0] ? errorBuffer
+                                                        : curl_easy_strerror(result)));
+    }
+}
+
+
+bool Client::Implementation::performRequestOnHost(cpr::Session &session,
+                                                  const HostAddress &host,
+                                                  Client::HTTPMethod method,
+                                                  const std::string &urlPath,
+                                                  const std::string &body,
+                                                  StreamedBody *stream,
+                                                  cpr::Response &response)
+{
+    const std::string entireUrl = host.url + urlPath;
+    CURL *handle = session.GetCurlHolder()->handle;
+#if LIBCURL_VERSION_NUM >= 0x072800
+    curl_easy_setopt(handle, CURLOPT_UNIX_SOCKET_PATH,
+                     host.unixSocketPath.empty() ? nullptr : host.unixSocketPath.c_str());
+#endif
     session.SetUrl(cpr::Url(entireUrl));
     cpr::Header header;
-    if (!body.empty()) {
+    if (!body.empty() || stream) {
         header["Content-Type"] = "application/json; charset=utf-8";
     }
     session.SetHeader(header);
-    session.SetBody(cpr::Body(body));
+    if (stream) {
+        // body of unknown size is sent by chunked transfer encoding on HTTP/1.1
+        curl_easy_setopt(handle, CURLOPT_POST, 1L);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, nullptr);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(-1));
+        curl_easy_setopt(handle, CURLOPT_READFUNCTION, &StreamedBody::read);
+        curl_easy_setopt(handle, CURLOPT_READDATA, stream);
+    } else {
+        session.SetBody(cpr::Body(body));
+    }
 
+    // method is set up the same way as cpr::Session does, the transfer is performed by
+    // the multiplexer so the sessions share connections
     switch (method) {
         case Client::HTTPMethod::GET:
             LOG(LogLevel::DEBUG, "Called GET: %s", urlPath.c_str());
-            response = session.Get();
+            curl_easy_setopt(handle, CURLOPT_NOBODY, 0L);
+            curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, nullptr);
+            curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
             break;
         case Client::HTTPMethod::POST:
             LOG(LogLevel::DEBUG, "Called POST: %s", urlPath.c_str());
-            response = session.Post();
+            curl_easy_setopt(handle, CURLOPT_NOBODY, 0L);
+            curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, "POST");
             break;
         case Client::HTTPMethod::PUT:
             LOG(LogLevel::DEBUG, "Called PUT: %s", urlPath.c_str());
-            response = session.Put();
+            curl_easy_setopt(handle, CURLOPT_NOBODY, 0L);
+            curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, "PUT");
             break;
         case Client::HTTPMethod::DELETE:
             LOG(LogLevel::DEBUG, "Called DELETE: %s", urlPath.c_str());
-            response = session.Delete();
+            curl_easy_setopt(handle, CURLOPT_NOBODY, 0L);
+            curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, "DELETE");
             break;
         case Client::HTTPMethod::HEAD:
             LOG(LogLevel::DEBUG, "Called HEAD: %s", urlPath.c_str());
-            response = session.Head();
+            curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+            curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, nullptr);
             break;
         default:
             throw std::runtime_error("This HTTP method is not implemented yet.");
     }
+    performTransfer(session, entireUrl, response);
+
+    if (stream) {
+        // restore curl defaults, so the session does not refer to the stream
+        curl_easy_setopt(handle, CURLOPT_READFUNCTION, nullptr);
+        curl_easy_setopt(handle, CURLOPT_READDATA, stdin);
+    }
 
     LOG(LogLevel::INFO, "Host returned %ld in %lf s for %s.", response.status_code,
         response.elapsed, entireUrl.c_str());
@@ -207,26 +686,58 @@ bool Client::Implementation::performRequestOnCurrentHost(Client::HTTPMethod meth
     // Status code = 503 means that Elastic node is temporarily unavailable, maybe because of queue
     // capacity of node is full filled.
     if (response.status_code == 0 || response.status_code == 503) {
-        LOG(LogLevel::WARNING, "Host on URL '%s' is unavailable.", entireUrl.c_str());
+        if (host.unixSocketPath.empty()) {
+            LOG(LogLevel::WARNING, "Host on URL '%s' is unavailable.", entireUrl.c_str());
+        } else {
+            LOG(LogLevel::WARNING, "Host on unix socket '%s' is unavailable.",
+                host.unixSocketPath.c_str());
+        }
         return false;
     }
     return true;
 }
 
 
-cpr::Response Client::Implementation::performRequest(
-        Client::HTTPMethod method, const std::string &urlPath, const std::string &body)
+cpr::Response Client::Implementation::performRequest(Client::HTTPMethod method,
+                                                     const std::string &urlPath,
+                                                     const std::string &body,
+                                                     RequestPriority priority,
+                                                     StreamedBody *stream)
 {
-    bool isSuccessful = false;
+    SessionLease lease(*this, priority);
+    std::uint32_t hostIndex;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        hostIndex = currentHostIndex;
+        if (loadBalancing && ++currentHostIndex >= hosts.size()) {
+            currentHostIndex = 0;
+        }
+    }
+
     cpr::Response response;
-    while (!isSuccessful) {
-        isSuccessful = performRequestOnCurrentHost(method, urlPath, body, response);
-        if (!isSuccessful && !failCurrentHostAndIterateNext()) {
+    std::size_t failCounter = 0;
+    while (!performRequestOnHost(lease.session(), hosts[hostIndex],
+                                 method, urlPath, body, stream, response))
+    {
+        if (stream && stream->isStarted()) {
+            // already pulled parts of the body can not be sent again
+            throw ConnectionException("Host failed for request with partially sent body.");
+        }
+        if (++failCounter >= hosts.size()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            resetCurrentHostInfo();
             throw ConnectionException("All hosts failed for request.");
         }
+        if (++hostIndex >= hosts.size()) {
+            hostIndex = 0;
+        }
+    }
+
+    // Stay on the host which successfuly responds.
+    if (failCounter) {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentHostIndex = hostIndex;
     }
-    // Reset failCounter if any host successfuly responds.
-    failCounter = 0;
     return response;
 }
 
@@ -235,12 +746,22 @@ cpr::Response Client::search(const std::string &indexName,
                              const std::string &docType,
                              const std::string &body,
                              const std::string &routing)
+{
+    return search(indexName, docType, body, routing, RequestPriority::NORMAL);
+}
+
+
+cpr::Response Client::search(const std::string &indexName,
+                             const std::string &docType,
+                             const std::string &body,
+                             const std::string &routing,
+                             RequestPriority priority)
 {
     std::ostringstream urlPath;
     fillIndexAndTypeInUrlPath(indexName, false, docType, false, urlPath);
     urlPath << "_search";
     fillRoutingInUrlPath(routing, urlPath);
-    return impl->performRequest(HTTPMethod::POST, urlPath.str(), body);
+    return impl->performRequest(HTTPMethod::POST, urlPath.str(), body, priority);
 }
 
 
@@ -248,6 +769,16 @@ cpr::Response Client::get(const std::string &indexName,
                           const std::string &docType,
                           const std::string &id,
                           const std::string &routing)
+{
+    return get(indexName, docType, id, routing, RequestPriority::NORMAL);
+}
+
+
+cpr::Response Client::get(const std::string &indexName,
+                          const std::string &docType,
+                          const std::string &id,
+                          const std::string &routing,
+                          RequestPriority priority)
 {
     std::ostringstream urlPath;
     fillIndexAndTypeInUrlPath(indexName, true, docType, true, urlPath);
@@ -256,7 +787,7 @@ cpr::Response Client::get(const std::string &indexName,
     }
     urlPath << id;
     fillRoutingInUrlPath(routing, urlPath);
-    return impl->performRequest(HTTPMethod::GET, urlPath.str());
+    return impl->performRequest(HTTPMethod::GET, urlPath.str(), std::string(), priority);
 }
 
 
@@ -265,6 +796,17 @@ cpr::Response Client::index(const std::string &indexName,
                             const std::string &id,
                             const std::string &body,
                             const std::string &routing)
+{
+    return index(indexName, docType, id, body, routing, RequestPriority::NORMAL);
+}
+
+
+cpr::Response Client::index(const std::string &indexName,
+                            const std::string &docType,
+                            const std::string &id,
+                            const std::string &body,
+                            const std::string &routing,
+                            RequestPriority priority)
 {
     std::ostringstream urlPath;
     fillIndexAndTypeInUrlPath(indexName, true, docType, true, urlPath);
@@ -272,7 +814,7 @@ cpr::Response Client::index(const std::string &indexName,
         urlPath << id;
     }
     fillRoutingInUrlPath(routing, urlPath);
-    return impl->performRequest(HTTPMethod::POST, urlPath.str(), body);
+    return impl->performRequest(HTTPMethod::POST, urlPath.str(), body, priority);
 }
 
 
@@ -280,6 +822,16 @@ cpr::Response Client::remove(const std::string &indexName,
                              const std::string &docType,
                              const std::string &id,
                              const std::string &routing)
+{
+    return remove(indexName, docType, id, routing, RequestPriority::NORMAL);
+}
+
+
+cpr::Response Client::remove(const std::string &indexName,
+                             const std::string &docType,
+                             const std::string &id,
+                             const std::string &routing,
+                             RequestPriority priority)
 {
     std::ostringstream urlPath;
     fillIndexAndTypeInUrlPath(indexName, true, docType, true, urlPath);
@@ -288,24 +840,74 @@ cpr::Response Client::remove(const std::string &indexName,
     }
     urlPath << id;
     fillRoutingInUrlPath(routing, urlPath);
-    return impl->performRequest(HTTPMethod::DELETE, urlPath.str());
+    return impl->performRequest(HTTPMethod::DELETE, urlPath.str(), std::string(), priority);
 }
 
 
 void Client::Implementation::visit(const TimeoutOption &opt) {
-    session.SetTimeout(cpr::Timeout{opt.getValue()});
+    modifyConfig([&opt](SessionConfig &config) {
+        config.timeout = opt.getValue();
+    });
 }
 
 void Client::Implementation::visit(const ConnectTimeoutOption &opt) {
-    session.SetConnectTimeout(cpr::ConnectTimeout{opt.getValue()});
+    modifyConfig([&opt](SessionConfig &config) {
+        config.connectTimeout = opt.getValue();
+    });
 }
 
 void Client::Implementation::visit(const ProxiesOption &opt) {
-    session.SetProxies(opt.impl->getProxies());
+    modifyConfig([&opt](SessionConfig &config) {
+        config.proxies = opt.impl->getProxies();
+        config.hasProxies = true;
+    });
 }
 
 void Client::Implementation::visit(const SSLOption &opt) {
-    session.SetSslOptions(opt.impl->getOptions());
+    modifyConfig([&opt](SessionConfig &config) {
+        config.sslOptions = opt.impl->getOptions();
+        config.hasSslOptions = true;
+    });
+}
+
+void Client::Implementation::visit(const ConnectionShareOption &opt) {
+    if (!opt.getValue()) {
+        throw std::runtime_error("Valid ConnectionShare instance is required.");
+    }
+    modifyConfig([&opt](SessionConfig &config) {
+        config.connectionShare = opt.getValue();
+    });
+}
+
+void Client::Implementation::visit(const HTTP2Option &opt) {
+    modifyConfig([&opt](SessionConfig &config) {
+        config.http2 = opt.getValue();
+    });
+}
+
+void Client::Implementation::visit(const MaxConnectionsOption &opt) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        maxSessions = opt.getValue();
+    }
+    sessionReleased.notify_all();
+}
+
+void Client::Implementation::visit(const MaxHostConnectionsOption &opt) {
+    transfers.setMaxHostConnections(opt.getValue());
+}
+
+void Client::Implementation::visit(const ReservedConnectionsOption &opt) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reservedSessions = opt.getValue();
+    }
+    sessionReleased.notify_all();
+}
+
+void Client::Implementation::visit(const LoadBalancingOption &opt) {
+    std::lock_guard<std::mutex> lock(mutex);
+    loadBalancing = opt.getValue();
 }
 
 void Client::SSLOption::SSLOptionImplementation::visit(const CertFile &certFile) {
@@ -28,10 +28,21 @@ namespace elasticlient {
 bool isLoggingEnabled();
 
 
-/// Will call specified log callback function with \p logLevel and \p message
+/**
+ * Will call specified log callback function with \p logLevel and \p message.
+ * When asynchronous logging is enabled, the message is only queued.
+ */
 void dbgLog(LogLevel logLevel, const std::string &message);
 
 
+/// \see dbgLog(), takes ownership of \p message when it is queued.
+void dbgLog(LogLevel logLevel, std::string &&message);
+
+
+/// Call log callback function right away from the calling thread.
+void dbgLogSync(LogLevel logLevel, const std::string &message);
+
+
 inline void propagateLogMessage(
         LogLevel logLevel, const char* message, ...) __attribute__ ((format (printf, 2, 3)));
 
@@ -5,15 +5,208 @@
 
 #include "elasticlient/logging.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include "logging-impl.h"
 
 
+namespace {
+
+
+/**
+ * Bounded multi-producer single-consumer ring buffer of formatted log records
+ * drained by a background thread which calls the LogCallback.
+ *
+ * Producers never block - they claim a slot with a single CAS and if the
+ * buffer is full, the record is dropped and counted.
+ */
+class AsyncLogSink {
+    /// One slot of the ring buffer.
+    struct Cell {
+        /// Sequence number telling whether the slot is free or filled.
+        std::atomic<std::size_t> sequence;
+        elasticlient::LogLevel logLevel;
+        std::string message;
+    };
+
+    /// Ring buffer slots, count is power of two.
+    std::unique_ptr<Cell[]> cells;
+    /// Mask to compute slot index from position.
+    const std::size_t mask;
+    /// Position of next record to be written (shared by producers).
+    std::atomic<std::size_t> enqueuePos;
+    /// Position of next record to be read (owned by consumer).
+    std::atomic<std::size_t> dequeuePos;
+    /// Number of records dropped because the buffer was full.
+    std::atomic<std::size_t> dropped;
+    /// True when consumer is going to sleep and needs to be woken up.
+    std::atomic<bool> consumerSleeping;
+    /// Set to stop the consumer once the buffer is drained.
+    std::atomic<bool> stopRequested;
+
+    /// Guards sleeping of consumer and flush() waiters.
+    std::mutex mutex;
+    /// Wakes the consumer.
+    std::condition_variable consumerCond;
+    /// Wakes threads waiting in flush().
+    std::condition_variable flushCond;
+    /// Consumer thread.
+    std::thread consumer;
+
+  public:
+    explicit AsyncLogSink(std::size_t capacity)
+      : cells(), mask(roundUpPowerOfTwo(capacity) - 1), enqueuePos(0), dequeuePos(0),
+        dropped(0), consumerSleeping(false), stopRequested(false), mutex(),
+        consumerCond(), flushCond(), consumer()
+    {
+        cells.reset(new Cell[mask + 1]);
+        for (std::size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        consumer = std::thread(&AsyncLogSink::drain, this);
+    }
+
+    /// Pass all pending records to the callback and stop the consumer thread.
+    ~AsyncLogSink() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopRequested = true;
+        }
+        consumerCond.notify_one();
+        consumer.join();
+    }
+
+    /// Enqueue record, return false if it was dropped.
+    bool push(elasticlient::LogLevel logLevel, std::string &&message) {
+        Cell *cell;
+        std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells[pos & mask];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const std::intptr_t diff = std::intptr_t(seq) - std::intptr_t(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                     std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // buffer is full
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->logLevel = logLevel;
+        cell->message = std::move(message);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumerSleeping.load()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            consumerCond.notify_one();
+        }
+        return true;
+    }
+
+    /// Block until records enqueued before this call were passed to the callback.
+    void flush() {
+        const std::size_t target = enqueuePos.load();
+        std::unique_lock<std::mutex> lock(mutex);
+        consumerCond.notify_one();
+        flushCond.wait(lock, [this, target]() {
+            return dequeuePos.load() >= target;
+        });
+    }
+
+    /// Return number of dropped records.
+    std::size_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static std::size_t roundUpPowerOfTwo(std::size_t value) {
+        std::size_t result = 2;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    /// Take one record from the buffer, return false when empty.
+    bool pop(elasticlient::LogLevel &logLevel, std::string &message) {
+        const std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell &cell = cells[pos & mask];
+        const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (std::intptr_t(seq) - std::intptr_t(pos + 1) < 0) {
+            return false;
+        }
+        logLevel = cell.logLevel;
+        message.swap(cell.message);
+        cell.message.clear();
+        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Consumer thread main loop.
+    void drain() {
+        elasticlient::LogLevel logLevel;
+        std::string message;
+        while (true) {
+            bool any = false;
+            while (pop(logLevel, message)) {
+                any = true;
+                elasticlient::dbgLogSync(logLevel, message);
+                dequeuePos.fetch_add(1);
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            if (any) {
+                flushCond.notify_all();
+            }
+            consumerSleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (isEmpty()) {
+                if (stopRequested) {
+                    consumerSleeping = false;
+                    return;
+                }
+                // timeout is only a safety net, producers wake us explicitly
+                consumerCond.wait_for(lock, std::chrono::milliseconds(100));
+            }
+            consumerSleeping = false;
+        }
+    }
+
+    /// Return true if there is no record published at dequeue position.
+    bool isEmpty() const {
+        const std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        const std::size_t seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+        return std::intptr_t(seq) - std::intptr_t(pos + 1) < 0;
+    }
+};
+
+
+} // anonymous namespace
+
+
 namespace elasticlient {
 
 
 /// LogCallback function
 static LogCallback logFunction = nullptr;
 
+/// Asynchronous sink, logging is synchronous when not set.
+static std::unique_ptr<AsyncLogSink> asyncSink;
+
+/// Number of records dropped by sinks already destroyed.
+static std::size_t droppedByPreviousSinks = 0;
+
 
 bool isLoggingEnabled() {
     return logFunction != nullptr;
@@ -25,11 +218,56 @@ void setLogFunction(LogCallback extLogFunction) {
 }
 
 
-void dbgLog(LogLevel logLevel, const std::string &message) {
+void setAsyncLogging(std::size_t capacity) {
+    if (asyncSink) {
+        droppedByPreviousSinks += asyncSink->droppedCount();
+        // destructor passes pending records to the callback
+        asyncSink.reset();
+    }
+    if (capacity) {
+        asyncSink.reset(new AsyncLogSink(capacity));
+    }
+}
+
+
+void flushLog() {
+    if (asyncSink) {
+        asyncSink->flush();
+    }
+}
+
+
+std::size_t getDroppedLogCount() {
+    return droppedByPreviousSinks + (asyncSink ? asyncSink->droppedCount() : 0);
+}
+
+
+void dbgLogSync(LogLevel logLevel, const std::string &message) {
     if (logFunction) {
         logFunction(logLevel, message);
     }
 }
 
 
+void dbgLog(LogLevel logLevel, const std::string &message) {
+    if (asyncSink) {
+        dbgLog(logLevel, std::string(message));
+    } else {
+        dbgLogSync(logLevel, message);
+    }
+}
+
+
+void dbgLog(LogLevel logLevel, std::string &&message) {
+    if (!logFunction) {
+        return;
+    }
+    if (asyncSink) {
+        asyncSink->push(logLevel, std::move(message));
+    } else {
+        logFunction(logLevel, message);
+    }
+}
+
+
 } // namespace elasticlient
@@ -45,6 +45,8 @@ class Scroll::Implementation {
     std::string scrollTimeout;
     /// Elastic current scroll parameters
     ScrollParams scrollParameters;
+    /// Priority of scroll requests.
+    Client::RequestPriority priority;
 
     friend class Scroll;
     friend class ScrollByScan;
@@ -53,7 +55,7 @@ class Scroll::Implementation {
                    std::size_t scrollSize,
                    const std::string &scrollTimeout)
       : client(std::move(elasticClient)), scrollSize(scrollSize), scrollTimeout(scrollTimeout),
-        scrollParameters()
+        scrollParameters(), priority(Client::RequestPriority::LOW)
     {
         if (!client) {
             throw std::runtime_error("Valid Client instance is required.");
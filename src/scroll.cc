@@ -31,6 +31,19 @@ Scroll::Scroll(const std::vector<std::string> &hostUrlList,
 {}
 
 
+Scroll::Scroll(const std::vector<std::string> &hostUrlList,
+               std::size_t scrollSize,
+               const std::string &scrollTimeout,
+               std::int32_t connectionTimeout,
+               const std::shared_ptr<ConnectionShare> &connectionShare)
+  : impl(new Implementation(
+      std::make_shared<Client>(hostUrlList,
+                               Client::TimeoutOption(connectionTimeout),
+                               Client::ConnectionShareOption(connectionShare)),
+      scrollSize, scrollTimeout))
+{}
+
+
 Scroll::Scroll(Scroll &&) = default;
 
 
@@ -126,7 +139,7 @@ bool Scroll::Implementation::run(
 {
     try {
         const cpr::Response r = client->performRequest(Client::HTTPMethod::POST,
-                                                       commonUrlPart, body);
+                                                       commonUrlPart, body, priority);
         if (r.status_code / 100 == 2 or r.status_code == 404) {
             return parseResult(r.text, parsedResult);
         }
@@ -204,7 +217,7 @@ void Scroll::clear() {
         const std::string requestBody{"{\"scroll_id\": [\"" + scrollParameters.scrollId + "\"]}"};
         try {
             const cpr::Response r = impl->client->performRequest(
-                Client::HTTPMethod::DELETE, "_search/scroll/", requestBody);
+                Client::HTTPMethod::DELETE, "_search/scroll/", requestBody, impl->priority);
             if (r.status_code / 100 != 2) {
                 LOG(LogLevel::WARNING, "Scroll delete failed response text: %s", r.text.c_str());
             }
@@ -218,6 +231,11 @@ void Scroll::clear() {
 }
 
 
+void Scroll::setRequestPriority(Client::RequestPriority priority) {
+    impl->priority = priority;
+}
+
+
 const std::shared_ptr<Client> &Scroll::getClient() const {
     return impl->client;
 }
@@ -4,9 +4,29 @@
  */
 #include <gtest/gtest.h>
 #include <sstream>
+#include <fstream>
 #include <iostream>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <atomic>
+#include <random>
+#include <new>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <climits>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <curl/curl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
 #include <json/json.h>
 #include <cpr/cpr.h>
 #include <httpmockserver/mock_server.h>
@@ -15,10 +35,20 @@
 #include "elasticlient/logging.h"
 #include "elasticlient/client.h"
 #include "elasticlient/bulk.h"
+#include "elasticlient/bulk-processor.h"
+#include "elasticlient/bulk-spill.h"
+#include "elasticlient/bulk-loader.h"
+#include "elasticlient/bulk-router.h"
+#include "elasticlient/bulk-pipeline.h"
 #include "elasticlient/scroll.h"
 
 /// Let test to access internal bulk functions.
 #include "bulk-impl.h"
+#include "bulk-processor-impl.h"
+#include "bulk-loader-impl.h"
+#include "bulk-validate-impl.h"
+#include "bulk-router-impl.h"
+#include "bulk-response-impl.h"
 /// Let test to re-use logging feature.
 #include "logging-impl.h"
 
@@ -35,9 +65,67 @@ void logCallback(elasticlient::LogLevel logLevel, const std::string &msg) {
 httpmock::TestEnvironment<httpmock::MockServerHolder>* mock_server_env = nullptr;
 
 
+/// Messages collected by recordingLogCallback.
+std::vector<std::string> recordedMessages;
+/// Set when recordingLogCallback should wait for releaseRecording.
+std::atomic<bool> blockRecording(false);
+/// Set by recordingLogCallback when it is blocked.
+std::atomic<bool> recordingBlocked(false);
+/// Releases blocked recordingLogCallback.
+std::atomic<bool> releaseRecording(false);
+
+
+/// Log callback storing messages for later inspection (called by async log thread).
+void recordingLogCallback(elasticlient::LogLevel, const std::string &msg) {
+    if (blockRecording) {
+        recordingBlocked = true;
+        while (!releaseRecording) {
+            std::this_thread::yield();
+        }
+    }
+    recordedMessages.push_back(msg);
+}
+
+
+/// Number of requests which had to wait for a free session, see countingLogCallback.
+std::atomic<int> waitingRequests(0);
+
+
+/// Log callback counting requests waiting for a free session.
+void countingLogCallback(elasticlient::LogLevel logLevel, const std::string &msg) {
+    if (msg.find("waits for a free session") != std::string::npos) {
+        ++waitingRequests;
+    }
+    logCallback(logLevel, msg);
+}
+
+
+/// Number of heap allocations made by the current thread, counted by operator new.
+thread_local std::size_t threadAllocations = 0;
+
+
 } // anonymous namespace
 
 
+void *operator new(std::size_t size) {
+    ++threadAllocations;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+
 namespace elasticlient {
 
 
@@ -57,7 +145,9 @@ class HTTPMock: public httpmock::MockServer {
     };
 
     explicit HTTPMock(unsigned port)
-      : httpmock::MockServer(port), lastCallData(), lastCallDataMutex()
+      : httpmock::MockServer(port), lastCallData(), lastCallDataMutex(), bulkAttempts(),
+        bulkAttemptsMutex(), orderedArrivals(), orderedBlocked(false), orderedMutex(),
+        orderedChanged()
     {}
 
     /// Safely return `lastCallData`
@@ -66,11 +156,76 @@ class HTTPMock: public httpmock::MockServer {
         return lastCallData;
     }
 
+    /// Forget arrived /ordered/ requests and hold /ordered/first until unblockOrdered().
+    void blockOrdered() {
+        std::lock_guard<std::mutex> guard(orderedMutex);
+        orderedArrivals.clear();
+        orderedBlocked = true;
+    }
+
+    /// Let held /ordered/first request finish.
+    void unblockOrdered() {
+        std::lock_guard<std::mutex> guard(orderedMutex);
+        orderedBlocked = false;
+        orderedChanged.notify_all();
+    }
+
+    /// Wait (at most five seconds) until \p count /ordered/ requests arrive, return them.
+    std::vector<std::string> waitForOrdered(std::size_t count) {
+        std::unique_lock<std::mutex> lock(orderedMutex);
+        orderedChanged.wait_for(lock, std::chrono::seconds(5), [this, count]() {
+            return orderedArrivals.size() >= count;
+        });
+        return orderedArrivals;
+    }
+
   private:
     /// Stored data from last call to the server
     CallData lastCallData;
     /// Mutex for lastCallData
     std::mutex lastCallDataMutex;
+    /// Number of times each document was sent to /bulk_retry
+    std::map<std::string, int> bulkAttempts;
+    /// Mutex for bulkAttempts
+    std::mutex bulkAttemptsMutex;
+    /// Names of /ordered/<name> requests in order of arrival
+    std::vector<std::string> orderedArrivals;
+    /// True if /ordered/first request is held
+    bool orderedBlocked;
+    /// Mutex for orderedArrivals and orderedBlocked
+    std::mutex orderedMutex;
+    /// Signalled when /ordered/ request arrives or it is unblocked
+    std::condition_variable orderedChanged;
+
+    /**
+     * Respond to /bulk_retry item by its id: "reject*" is rejected (429) once,
+     * "always*" always, "bad*" fails on mapping (400), "conflict*" on version (409).
+     */
+    std::string bulkRetryItem(const std::string &controlLine) {
+        const std::size_t idStart = controlLine.find("\"_id\": \"") + 8;
+        const std::string id = controlLine.substr(
+                idStart, controlLine.find('"', idStart) - idStart);
+        int attempt;
+        {
+            std::lock_guard<std::mutex> guard(bulkAttemptsMutex);
+            attempt = ++bulkAttempts[id];
+        }
+        std::string status = "201";
+        std::string error;
+        if (matchesPrefix(id, "always") || (matchesPrefix(id, "reject") && attempt == 1)) {
+            status = "429";
+            error = "es_rejected_execution_exception";
+        } else if (matchesPrefix(id, "bad")) {
+            status = "400";
+            error = "mapper_parsing_exception";
+        } else if (matchesPrefix(id, "conflict")) {
+            status = "409";
+            error = "version_conflict_engine_exception";
+        }
+        return "{\"index\": {\"_id\": \"" + id + "\", \"status\": " + status
+             + (error.empty() ? "" : ", \"error\": {\"type\": \"" + error + "\", "
+                                     "\"reason\": \"failed " + id + "\"}") + "}}";
+    }
 
     Response responseHandler(
             const std::string &url,
@@ -104,6 +259,16 @@ class HTTPMock: public httpmock::MockServer {
             }
         }
 
+        // Mocked request recording order of arrival, the first one held until unblocked
+        if (method == "GET" && matchesPrefix(url, "/ordered/")) {
+            std::unique_lock<std::mutex> lock(orderedMutex);
+            orderedArrivals.push_back(url.substr(9));
+            orderedChanged.notify_all();
+            if (url == "/ordered/first") {
+                orderedChanged.wait(lock, [this]() { return !orderedBlocked; });
+            }
+            return Response(200, "ORDERED_OK");
+        }
         // Mocked basic search
         if (method =="POST" && matchesPrefix(url, "/indexA/typeA/_search")) {
             return Response(201, data);
@@ -124,6 +289,71 @@ class HTTPMock: public httpmock::MockServer {
         if (method =="DELETE" && url == "/indexA/typeA/321") {
             return Response(200, "REMOVE_OK");
         }
+        // Mocked cluster state of index with two shards on node1 and node2
+        if (method == "GET" && url == "/_cluster/state/metadata,routing_table/bulk_stream") {
+            return Response(200,
+                "{\"metadata\": {\"indices\": {\"bulk_stream-1\": {\"routing_num_shards\": 4,"
+                " \"settings\": {\"index\": {\"number_of_shards\": \"2\"}}}}},"
+                " \"routing_table\": {\"indices\": {\"bulk_stream-1\": {\"shards\": {"
+                "\"0\": [{\"state\": \"STARTED\", \"primary\": false, \"node\": \"node2\"},"
+                " {\"state\": \"STARTED\", \"primary\": true, \"node\": \"node1\"}],"
+                " \"1\": [{\"state\": \"STARTED\", \"primary\": true, \"node\": \"node2\"}]"
+                "}}}}}");
+        }
+        // Mocked addresses of nodes, node2 does not listen
+        if (method == "GET" && url == "/_nodes/http") {
+            return Response(200,
+                "{\"nodes\": {\"node1\": {\"http\": {\"publish_address\": \"localhost/127.0.0.1:"
+                + std::to_string(getPort()) + "\"}}, \"node2\": {\"http\": "
+                "{\"publish_address\": \"127.0.0.1:1\"}}}}");
+        }
+        // Mocked successful bulk, optionally slow
+        if (matchesPrefix(url, "/bulk_ok/_bulk") || matchesPrefix(url, "/bulk_slow/_bulk")) {
+            if (matchesPrefix(url, "/bulk_slow")) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+            return Response(200, "{\"took\": 1, \"errors\": false, \"items\": []}");
+        }
+        // Mocked bulk failing items with "fail" in control line, also for more indices
+        if (matchesPrefix(url, "/bulk_stream/_bulk") || matchesPrefix(url, "/_bulk")) {
+            std::istringstream lines(data);
+            std::string line;
+            std::string items;
+            while (std::getline(lines, line)) {
+                if (line.compare(0, 10, "{\"index\": ") == 0
+                    || line.compare(0, 11, "{\"create\": ") == 0
+                    || line.compare(0, 11, "{\"delete\": ") == 0)
+                {
+                    const bool fail = line.find("fail") != std::string::npos;
+                    if (line.find("missing") != std::string::npos) {
+                        items += std::string(items.empty() ? "" : ", ")
+                               + "{\"delete\": {\"status\": 404, \"result\": \"not_found\"}}";
+                        continue;
+                    }
+                    items += std::string(items.empty() ? "" : ", ")
+                           + "{\"index\": {\"status\": " + (fail ? "400" : "201") + "}}";
+                }
+            }
+            return Response(200, "{\"took\": 1, \"errors\": true, \"items\": [" + items + "]}");
+        }
+        // Mocked bulk rejecting items, see bulkRetryItem()
+        if (matchesPrefix(url, "/bulk_retry/_bulk")) {
+            std::istringstream lines(data);
+            std::string line;
+            std::string items;
+            while (std::getline(lines, line)) {
+                if (line.compare(0, 10, "{\"index\": ") == 0) {
+                    items += (items.empty() ? "" : ", ") + bulkRetryItem(line);
+                }
+            }
+            return Response(200, "{\"took\": 1, \"errors\": true, \"items\": [" + items + "]}");
+        }
+        // Mocked bulk with response of the second item malformed and the last one missing
+        if (matchesPrefix(url, "/bulk_partial/_bulk")) {
+            return Response(200, "{\"took\": 1, \"errors\": true, \"items\": ["
+                                 "{\"index\": {\"_id\": \"1\", \"status\": 201}}, "
+                                 "{\"index\": {\"_id\": \"2\", \"status\": \"?\"}}]}");
+        }
         // Always return status 500 for /bulk_basics testcase
         if (matchesPrefix(url, "/bulk_basics/_bulk")) {
             return Response(500, "Internal error");
@@ -198,6 +428,352 @@ class HTTPMock: public httpmock::MockServer {
 };
 
 
+/**
+ * Minimal plain HTTP server for tests of HTTP/2 negotiation. Connections offering h2c
+ * upgrade are switched to HTTP/2 (unless created with http2 false), GET requests are
+ * answered by "H2_OK" over HTTP/2 and by "H1_OK" over HTTP/1.1. HTTP/2 responses are
+ * held until holdStreams requests are open on the connection (at most a second),
+ * so requests multiplexed over the connection can be observed.
+ */
+class H2cServer {
+  public:
+    H2cServer(bool http2, std::size_t holdStreams)
+      : http2(http2), holdStreams(holdStreams), listenFd(::socket(AF_INET, SOCK_STREAM, 0)),
+        port(0), stopped(false), connections(0), upgradeOffers(0), maxOpenStreams(0),
+        acceptor(), connectionThreads(), threadsMutex()
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))
+            || ::listen(listenFd, 16)
+            || ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &length))
+        {
+            throw std::runtime_error("H2cServer can not listen");
+        }
+        port = ntohs(addr.sin_port);
+        acceptor = std::thread(&H2cServer::run, this);
+    }
+
+    ~H2cServer() {
+        stopped = true;
+        acceptor.join();
+        std::lock_guard<std::mutex> guard(threadsMutex);
+        for (std::thread &thread: connectionThreads) {
+            thread.join();
+        }
+        ::close(listenFd);
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(port) + "/";
+    }
+
+    /// Number of accepted connections.
+    std::size_t getConnections() const {
+        return connections;
+    }
+
+    /// Number of HTTP/1.1 requests offering h2c upgrade.
+    std::size_t getUpgradeOffers() const {
+        return upgradeOffers;
+    }
+
+    /// Maximal number of requests open at once on one HTTP/2 connection.
+    std::size_t getMaxOpenStreams() const {
+        return maxOpenStreams;
+    }
+
+  private:
+    /// Accept connections until stopped.
+    void run() {
+        while (!stopped) {
+            pollfd pfd = {listenFd, POLLIN, 0};
+            if (::poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            const int fd = ::accept(listenFd, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            ++connections;
+            std::lock_guard<std::mutex> guard(threadsMutex);
+            connectionThreads.emplace_back(&H2cServer::serve, this, fd);
+        }
+    }
+
+    /// Read available bytes into \p in, return -1 if closed or stopped, 0 on timeout.
+    int receive(int fd, std::string &in) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (stopped) {
+            return -1;
+        }
+        if (::poll(&pfd, 1, 50) <= 0) {
+            return 0;
+        }
+        char buffer[16384];
+        const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        in.append(buffer, n);
+        return 1;
+    }
+
+    static void sendAll(int fd, const std::string &data) {
+        ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    }
+
+    /// Return HTTP/2 frame.
+    static std::string frame(unsigned type, unsigned flags, std::uint32_t stream,
+                             const std::string &payload)
+    {
+        std::string out;
+        out += static_cast<char>(payload.size() >> 16);
+        out += static_cast<char>(payload.size() >> 8);
+        out += static_cast<char>(payload.size());
+        out += static_cast<char>(type);
+        out += static_cast<char>(flags);
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out += static_cast<char>(stream >> shift);
+        }
+        return out + payload;
+    }
+
+    void serve(int fd) {
+        std::string in;
+        while (true) {
+            const std::size_t headEnd = in.find("\r\n\r\n");
+            if (headEnd == std::string::npos) {
+                if (receive(fd, in) < 0) {
+                    break;
+                }
+                continue;
+            }
+            std::string head = in.substr(0, headEnd);
+            in.erase(0, headEnd + 4);
+            std::transform(head.begin(), head.end(), head.begin(), ::tolower);
+            if (head.find("\r\nupgrade: h2c") == std::string::npos || !http2) {
+                if (head.find("\r\nupgrade: h2c") != std::string::npos) {
+                    ++upgradeOffers;
+                }
+                sendAll(fd, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nH1_OK");
+                continue;
+            }
+            ++upgradeOffers;
+            sendAll(fd, "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\n"
+                        "Upgrade: h2c\r\n\r\n" + frame(4, 0, 0, ""));
+            serveHttp2(fd, in);
+            break;
+        }
+        ::close(fd);
+    }
+
+    /// Serve upgraded connection, upgrading request is stream 1.
+    void serveHttp2(int fd, std::string &in) {
+        static const std::string preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+        std::vector<std::uint32_t> complete = {1};
+        std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        bool prefaceRead = false;
+        while (true) {
+            if (!complete.empty() && (complete.size() >= holdStreams
+                                      || std::chrono::steady_clock::now() >= deadline))
+            {
+                maxOpenStreams = std::max<std::size_t>(maxOpenStreams, complete.size());
+                for (const std::uint32_t stream: complete) {
+                    // 0x88 is HPACK indexed ":status: 200"
+                    sendAll(fd, frame(1, 0x4, stream, "\x88")
+                                + frame(0, 0x1, stream, "H2_OK"));
+                }
+                complete.clear();
+            }
+            if (!prefaceRead && in.size() >= preface.size()) {
+                if (in.compare(0, preface.size(), preface) != 0) {
+                    return;
+                }
+                in.erase(0, preface.size());
+                prefaceRead = true;
+                continue;
+            }
+            const std::size_t length = in.size() < 9 ? 0
+                    : (std::size_t(std::uint8_t(in[0])) << 16)
+                      | (std::size_t(std::uint8_t(in[1])) << 8) | std::uint8_t(in[2]);
+            if (!prefaceRead || in.size() < 9 || in.size() < 9 + length) {
+                if (receive(fd, in) < 0) {
+                    return;
+                }
+                continue;
+            }
+            const unsigned type = std::uint8_t(in[3]);
+            const unsigned flags = std::uint8_t(in[4]);
+            const std::uint32_t stream = (std::uint32_t(std::uint8_t(in[5]) & 0x7f) << 24)
+                    | (std::uint32_t(std::uint8_t(in[6])) << 16)
+                    | (std::uint32_t(std::uint8_t(in[7])) << 8) | std::uint8_t(in[8]);
+            const std::string payload = in.substr(9, length);
+            in.erase(0, 9 + length);
+            if (type == 4 && !(flags & 0x1)) {
+                // acknowledge client settings
+                sendAll(fd, frame(4, 0x1, 0, ""));
+            } else if (type == 6 && !(flags & 0x1)) {
+                sendAll(fd, frame(6, 0x1, 0, payload));
+            } else if (type == 7) {
+                return;
+            } else if ((type == 0 || type == 1) && (flags & 0x1)) {
+                // request (HEADERS or DATA frame) ends the stream
+                if (complete.empty()) {
+                    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                }
+                complete.push_back(stream);
+            }
+        }
+    }
+
+    const bool http2;
+    const std::size_t holdStreams;
+    const int listenFd;
+    unsigned short port;
+    std::atomic<bool> stopped;
+    std::atomic<std::size_t> connections;
+    std::atomic<std::size_t> upgradeOffers;
+    std::atomic<std::size_t> maxOpenStreams;
+    std::thread acceptor;
+    std::vector<std::thread> connectionThreads;
+    std::mutex threadsMutex;
+};
+
+
+/**
+ * HTTP/1.1 server answering first \p answered bulk requests, items with "fail" in control
+ * line fail on mapping (400) and the rest is rejected (429). Connection of later requests
+ * is reset without response.
+ */
+class FlakyBulkServer {
+  public:
+    explicit FlakyBulkServer(std::size_t answered)
+      : answered(answered), listenFd(::socket(AF_INET, SOCK_STREAM, 0)), port(0),
+        stopped(false), requests(0), acceptor()
+    {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        if (::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))
+            || ::listen(listenFd, 16)
+            || ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &length))
+        {
+            throw std::runtime_error("FlakyBulkServer can not listen");
+        }
+        port = ntohs(addr.sin_port);
+        acceptor = std::thread(&FlakyBulkServer::run, this);
+    }
+
+    ~FlakyBulkServer() {
+        stopped = true;
+        acceptor.join();
+        ::close(listenFd);
+    }
+
+    std::string url() const {
+        return "http://127.0.0.1:" + std::to_string(port) + "/";
+    }
+
+    /// Number of received requests.
+    std::size_t getRequests() const {
+        return requests;
+    }
+
+  private:
+    /// Serve connections one by one until stopped.
+    void run() {
+        while (!stopped) {
+            pollfd pfd = {listenFd, POLLIN, 0};
+            if (::poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            const int fd = ::accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                serve(fd);
+            }
+        }
+    }
+
+    /// Read bytes until \p in has at least \p size of them, return false on failure.
+    static bool receive(int fd, std::string &in, std::size_t size) {
+        char buffer[16384];
+        pollfd pfd = {fd, POLLIN, 0};
+        while (in.size() < size) {
+            if (::poll(&pfd, 1, 5000) <= 0) {
+                return false;
+            }
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                return false;
+            }
+            in.append(buffer, n);
+        }
+        return true;
+    }
+
+    static void sendAll(int fd, const std::string &data) {
+        ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    }
+
+    void serve(int fd) {
+        std::string in;
+        std::size_t headEnd;
+        while ((headEnd = in.find("\r\n\r\n")) == std::string::npos) {
+            if (!receive(fd, in, in.size() + 1)) {
+                ::close(fd);
+                return;
+            }
+        }
+        std::string head = in.substr(0, headEnd);
+        in.erase(0, headEnd + 4);
+        std::transform(head.begin(), head.end(), head.begin(), ::tolower);
+        const std::size_t lengthField = head.find("\r\ncontent-length: ");
+        const std::size_t length = lengthField == std::string::npos ? 0
+                : std::stoul(head.substr(lengthField + 18));
+        if (head.find("\r\nexpect: 100-continue") != std::string::npos) {
+            sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        if (!receive(fd, in, length)) {
+            ::close(fd);
+            return;
+        }
+
+        if (++requests > answered) {
+            linger reset = {1, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+            ::close(fd);
+            return;
+        }
+        std::istringstream lines(in);
+        std::string line;
+        std::string items;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, 10, "{\"index\": ") == 0) {
+                const bool fail = line.find("fail") != std::string::npos;
+                items += std::string(items.empty() ? "" : ", ")
+                       + "{\"index\": {\"status\": " + (fail ? "400" : "429") + "}}";
+            }
+        }
+        const std::string body = "{\"took\": 1, \"errors\": true, \"items\": [" + items + "]}";
+        sendAll(fd, "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Type: application/json\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+        ::close(fd);
+    }
+
+    const std::size_t answered;
+    const int listenFd;
+    unsigned short port;
+    std::atomic<bool> stopped;
+    std::atomic<std::size_t> requests;
+    std::thread acceptor;
+};
+
+
 class ElasticlientTest: public ::testing::Test {
     std::vector<std::string> mockedHosts;
 
@@ -212,6 +788,46 @@ class ElasticlientTest: public ::testing::Test {
 };
 
 
+TEST_F(ElasticlientTest, asyncLogging) {
+    recordedMessages.clear();
+    setLogFunction(recordingLogCallback);
+    setAsyncLogging(16);
+    for (int i = 0; i < 100; ++i) {
+        LOG(LogLevel::INFO, "message %d", i);
+        if (i % 10 == 0) {
+            // give the consumer a chance so the buffer does not overflow
+            flushLog();
+        }
+    }
+    flushLog();
+    ASSERT_EQ(0, getDroppedLogCount());
+    ASSERT_EQ(100, recordedMessages.size());
+    ASSERT_EQ("message 0", recordedMessages.front());
+    ASSERT_EQ("message 99", recordedMessages.back());
+
+    // block the consumer on the first message, then overflow the buffer
+    recordedMessages.clear();
+    blockRecording = true;
+    setAsyncLogging(2);
+    LOG(LogLevel::INFO, "first");
+    while (!recordingBlocked) {
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < 9; ++i) {
+        LOG(LogLevel::INFO, "overflow %d", i);
+    }
+    ASSERT_EQ(7, getDroppedLogCount());
+    releaseRecording = true;
+    flushLog();
+    ASSERT_EQ(3, recordedMessages.size());
+    ASSERT_EQ("overflow 1", recordedMessages.back());
+
+    blockRecording = false;
+    setAsyncLogging(0);
+    setLogFunction(logCallback);
+}
+
+
 TEST_F(ElasticlientTest, hostsFailed) {
     Client elasticClient({"http://fake.fake123:45100/", "http://fake.fake123:45101/"});
     ASSERT_THROW(elasticClient.search("fake", "fake", "{}"), ConnectionException);
@@ -256,6 +872,216 @@ TEST_F(ElasticlientTest, remove) {
 }
 
 
+TEST_F(ElasticlientTest, connectionShare) {
+    std::shared_ptr<ConnectionShare> share = std::make_shared<ConnectionShare>(true);
+    ASSERT_TRUE(share->sharesConnections());
+    ASSERT_FALSE(ConnectionShare().sharesConnections());
+
+    // short-lived clients attached to the same share
+    for (int i = 0; i < 3; ++i) {
+        Client elasticClient(getMockedHosts(), Client::ConnectionShareOption(share));
+        cpr::Response r = elasticClient.get("indexA", "typeA", "123");
+        ASSERT_EQ(200, r.status_code);
+        ASSERT_EQ("GET_OK", r.text);
+    }
+
+    Bulk indexer(getMockedHosts(), 6000, share);
+    SameIndexBulkData bulk("bulk_basics");
+    bulk.indexDocument("typeX", "id1", "{data1}");
+    ASSERT_EQ(1, indexer.perform(bulk));
+
+    Scroll scrollInstance(getMockedHosts(), 100, "1m", 6000, share);
+    Json::Value hits;
+    scrollInstance.init("test_scroll_ok*", "fake_index", "{}");
+    ASSERT_TRUE(scrollInstance.next(hits));
+    ASSERT_EQ(2, hits["hits"].size());
+    scrollInstance.clear();
+
+    ASSERT_THROW(Client(getMockedHosts(), Client::ConnectionShareOption(nullptr)),
+                 std::runtime_error);
+}
+
+
+TEST_F(ElasticlientTest, concurrentRequests) {
+    // mock server does not speak HTTP/2, so the client has to fall back to HTTP/1.1
+    Client elasticClient(getMockedHosts(),
+                         Client::HTTP2Option(true),
+                         Client::MaxConnectionsOption(2));
+    std::atomic<int> succeeded(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&elasticClient, &succeeded]() {
+            for (int j = 0; j < 20; ++j) {
+                cpr::Response r = elasticClient.get("indexA", "typeA", "123");
+                if (r.status_code == 200 && r.text == "GET_OK") {
+                    ++succeeded;
+                }
+            }
+        });
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    ASSERT_EQ(160, succeeded);
+}
+
+
+TEST_F(ElasticlientTest, http2Multiplexing) {
+    if (!(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2)) {
+        GTEST_SKIP() << "Curl is built without HTTP/2 support.";
+    }
+    // server answers only when all four requests are open on one connection
+    H2cServer server(true, 4);
+    Client elasticClient({server.url()}, Client::HTTP2Option(true));
+    std::atomic<int> succeeded(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&elasticClient, &succeeded]() {
+            cpr::Response r = elasticClient.get("indexA", "typeA", "123");
+            if (r.status_code == 200 && r.text == "H2_OK") {
+                ++succeeded;
+            }
+        });
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    ASSERT_EQ(4, succeeded);
+    ASSERT_EQ(1U, server.getConnections());
+    ASSERT_EQ(4U, server.getMaxOpenStreams());
+}
+
+
+TEST_F(ElasticlientTest, http2Fallback) {
+    // server ignores h2c upgrade, requests continue over HTTP/1.1 on one connection
+    H2cServer server(false, 1);
+    Client elasticClient({server.url()},
+                         Client::HTTP2Option(true),
+                         Client::MaxHostConnectionsOption(1));
+    std::atomic<int> succeeded(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&elasticClient, &succeeded]() {
+            for (int j = 0; j < 5; ++j) {
+                cpr::Response r = elasticClient.get("indexA", "typeA", "123");
+                if (r.status_code == 200 && r.text == "H1_OK") {
+                    ++succeeded;
+                }
+            }
+        });
+    }
+    for (std::thread &thread: threads) {
+        thread.join();
+    }
+    ASSERT_EQ(20, succeeded);
+    ASSERT_LT(0U, server.getUpgradeOffers());
+    ASSERT_EQ(1U, server.getConnections());
+}
+
+
+TEST_F(ElasticlientTest, unixSocketHost) {
+    const std::string socketPath = "/tmp/elasticlient-test-" + std::to_string(getpid()) + ".sock";
+    ::unlink(socketPath.c_str());
+    const int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_LE(0, listenFd);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    socketPath.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(0, ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listenFd, 1));
+
+    // serve single GET request over the unix socket, give up after a few seconds
+    // so a client not connecting fails the test instead of hanging it
+    std::string receivedRequest;
+    std::thread server([listenFd, &receivedRequest]() {
+        pollfd listening = {listenFd, POLLIN, 0};
+        if (::poll(&listening, 1, 5000) <= 0) {
+            return;
+        }
+        const int fd = ::accept(listenFd, nullptr, nullptr);
+        char buffer[4096];
+        pollfd connection = {fd, POLLIN, 0};
+        while (receivedRequest.find("\r\n\r\n") == std::string::npos
+               && ::poll(&connection, 1, 5000) > 0)
+        {
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                break;
+            }
+            receivedRequest.append(buffer, n);
+        }
+        const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\nUDS_OK";
+        ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        ::close(fd);
+    });
+
+    // the first (dead) unix host fails over to the second one
+    Client elasticClient({"unix:///tmp/elasticlient-nonexistent.sock/", "unix://" + socketPath});
+    cpr::Response r = elasticClient.get("indexA", "typeA", "123");
+    server.join();
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+    ASSERT_EQ(200, r.status_code);
+    ASSERT_EQ("UDS_OK", r.text);
+    ASSERT_EQ(0, receivedRequest.find("GET /indexA/typeA/123 HTTP/1.1\r\n"));
+
+    // dead unix host fails over to TCP host
+    Client mixedClient({"unix:///tmp/elasticlient-nonexistent.sock", getMockedHosts()[0]});
+    for (int i = 0; i < 2; ++i) {
+        r = mixedClient.get("indexA", "typeA", "123");
+        ASSERT_EQ(200, r.status_code);
+        ASSERT_EQ("GET_OK", r.text);
+    }
+
+    ASSERT_THROW(Client({"unix://"}), std::runtime_error);
+}
+
+
+TEST_F(ElasticlientTest, requestPriority) {
+    typedef Client::RequestPriority Priority;
+    HTTPMock &mock = *dynamic_cast<HTTPMock*>(mock_server_env->getMock().operator->().get());
+
+    // Hold LOW request on the mock, then queue LOW and HIGH request and let the first
+    // one finish once \p waiting requests wait for session and \p arrived requests
+    // reached the mock. Return order the requests reached the mock.
+    auto run = [&mock](Client &elasticClient, int waiting, std::size_t arrived) {
+        auto request = [&elasticClient](const std::string &name, Priority priority) {
+            elasticClient.performRequest(Client::HTTPMethod::GET, "ordered/" + name, "",
+                                         priority);
+        };
+        mock.blockOrdered();
+        waitingRequests = 0;
+        setLogFunction(countingLogCallback);
+        std::thread first(request, "first", Priority::LOW);
+        mock.waitForOrdered(1);
+        std::thread low(request, "low", Priority::LOW);
+        std::thread high(request, "high", Priority::HIGH);
+        for (int i = 0; i < 500 && waitingRequests < waiting; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        mock.waitForOrdered(arrived);
+        mock.unblockOrdered();
+        first.join();
+        low.join();
+        high.join();
+        setLogFunction(logCallback);
+        EXPECT_EQ(waiting, waitingRequests);
+        return mock.waitForOrdered(3);
+    };
+    const std::vector<std::string> expected = {"first", "high", "low"};
+
+    // single connection - HIGH request jumps queued LOW request
+    Client singleConnection(getMockedHosts(), Client::MaxConnectionsOption(1));
+    ASSERT_EQ(expected, run(singleConnection, 2, 1));
+
+    // reserved connection - LOW request waits, HIGH request takes the reserved one
+    Client reservedConnection(getMockedHosts(),
+                              Client::MaxConnectionsOption(2),
+                              Client::ReservedConnectionsOption(1));
+    ASSERT_EQ(expected, run(reservedConnection, 1, 2));
+}
+
+
 TEST_F(ElasticlientTest, bulkInternal) {
     // check if control field is generated correctly
     ASSERT_EQ(
@@ -282,6 +1108,237 @@ TEST_F(ElasticlientTest, bulkInternal) {
         "{\"create\": {\"_type\": \"my_type\", \"_id\": \"id2\"}}\n"
         "{data2}\n";
     ASSERT_EQ(expected, bulk.body());
+    ASSERT_EQ(expected.size(), bulk.byteSize());
+    bulk.clear();
+    ASSERT_EQ(0U, bulk.byteSize());
+
+    // capacity is reached by count or by body size
+    SameIndexBulkData limited("my_index", 3, 150);
+    ASSERT_FALSE(limited.indexDocument("my_type", "id1", "{data1}"));
+    ASSERT_TRUE(limited.indexDocument("my_type", "id2", std::string(100, 'x')));
+    ASSERT_EQ(limited.body().size(), limited.byteSize());
+    limited.clear();
+    ASSERT_FALSE(limited.indexDocument("my_type", "id1", "{data1}"));
+    ASSERT_FALSE(limited.indexDocument("my_type", "id2", "{data2}"));
+    ASSERT_TRUE(limited.indexDocument("my_type", "id3", "{data3}"));
+
+    // item metadata, unset fields are omitted
+    BulkItemMetadata metadata;
+    metadata.routing = "user1";
+    metadata.version = 3;
+    metadata.versionType = "external";
+    ASSERT_EQ(
+        "{\"delete\": {\"_type\": \"type1\", \"_id\": \"1\", \"routing\": \"user1\", "
+        "\"version\": 3, \"version_type\": \"external\"}}",
+        createControl("delete", "type1", "1", metadata));
+    metadata = BulkItemMetadata();
+    metadata.ifSeqNo = 0;
+    metadata.ifPrimaryTerm = 1;
+    metadata.pipeline = "geoip";
+    ASSERT_EQ(
+        "{\"index\": {\"_type\": \"type1\", \"if_seq_no\": 0, \"if_primary_term\": 1, "
+        "\"pipeline\": \"geoip\"}}",
+        createControl("index", "type1", "", metadata));
+
+    // delete action has no source line
+    bulk.clear();
+    bulk.indexDocument("my_type", "id1", "{data1}", metadata);
+    bulk.deleteDocument("my_type", "id2");
+    ASSERT_THROW(bulk.deleteDocument("my_type", ""), std::runtime_error);
+    bulk.updateDocument("my_type", "id3", "{data3}");
+    ASSERT_EQ(3U, bulk.size());
+    const std::string withDelete =
+        "{\"index\": {\"_type\": \"my_type\", \"_id\": \"id1\", \"if_seq_no\": 0, "
+        "\"if_primary_term\": 1, \"pipeline\": \"geoip\"}}\n"
+        "{data1}\n"
+        "{\"delete\": {\"_type\": \"my_type\", \"_id\": \"id2\"}}\n"
+        "{\"update\": {\"_type\": \"my_type\", \"_id\": \"id3\"}}\n"
+        "{data3}\n";
+    ASSERT_EQ(withDelete, bulk.body());
+    ASSERT_EQ(3U, splitBulkItems(withDelete).size());
+
+    // values are escaped, also across the eight byte blocks of the scan
+    std::string escaped;
+    appendJsonString(escaped, "a\"b\\c\n\x01\xc3\xa9");
+    ASSERT_EQ("\"a\\\"b\\\\c\\n\\u0001\xc3\xa9\"", escaped);
+    escaped.clear();
+    appendJsonString(escaped, "0123456789abcde\"0123456789\t");
+    ASSERT_EQ("\"0123456789abcde\\\"0123456789\\t\"", escaped);
+    metadata = BulkItemMetadata();
+    metadata.routing = "us\"er";
+    ASSERT_EQ(
+        "{\"index\": {\"_type\": \"ty\\\\pe\", \"_id\": \"i\\\"d\", \"routing\": \"us\\\"er\"}}",
+        createControl("index", "ty\\pe", "i\"d", metadata));
+
+    // cached prefixes give the same lines as appendControl()
+    ControlLineWriter writer;
+    std::string written;
+    std::string expectedLines;
+    for (int i = 0; i < 30; ++i) {
+        const std::string action = i % 3 ? "index" : "delete";
+        const std::string type = "type" + std::to_string(i % 11);
+        writer.append(written, action.c_str(), "idx", type, std::to_string(i), nullptr);
+        appendControl(expectedLines, action, "idx", type, std::to_string(i), nullptr);
+    }
+    ASSERT_EQ(expectedLines, written);
+}
+
+
+TEST_F(ElasticlientTest, bulkResponseScanner) {
+    // errors=false stops scanning, garbage after it is not read
+    const std::string noErrors = "{\"took\": 3, \"errors\": false, \"items\": [garbage";
+    ASSERT_EQ(BulkResponseScanner::Start::NO_ERRORS, BulkResponseScanner(noErrors).start(true));
+    BulkResponseScanner allItems(noErrors);
+    ASSERT_EQ(BulkResponseScanner::Start::ITEMS, allItems.start(false));
+    BulkItemResponse item;
+    ASSERT_FALSE(allItems.nextItem(item));
+    ASSERT_FALSE(allItems.valid());
+
+    // large numbers are read whole, out of range ones saturate
+    const std::string slowResponse = "{\"took\": 12345678, \"errors\": false}";
+    BulkResponseScanner slow(slowResponse);
+    ASSERT_EQ(BulkResponseScanner::Start::NO_ERRORS, slow.start(true));
+    ASSERT_EQ(12345678, slow.took());
+    const std::string hugeResponse = "{\"took\": 123456789012345678901234, \"errors\": false}";
+    BulkResponseScanner huge(hugeResponse);
+    ASSERT_EQ(BulkResponseScanner::Start::NO_ERRORS, huge.start(true));
+    ASSERT_EQ(INT_MAX, huge.took());
+
+    const std::string response =
+        "{\"took\": {\"nested\": [1, 2.5e3, null, true]}, \"errors\": true, \"items\": [\n"
+        "  {\"index\": {\"_id\": \"a\\\"\\u00e9\\ud83d\\ude00\", \"_version\": 1, \"status\": 201}},\n"
+        "  {\"create\": {\"status\": 400, \"_id\": \"b\", \"error\": {\"type\": \"mapper_exception\","
+        "   \"caused_by\": {\"type\": \"inner\", \"reason\": \"no\"}, \"reason\": \"bad\\ndoc\"}}},\n"
+        "  {\"delete\": {\"_id\": \"c\", \"error\": \"old style error\"}},\n"
+        "  [\"not an object\"],\n"
+        "  {\"update\": {\"status\": \"201\"}}\n"
+        "]}";
+    BulkResponseScanner scanner(response);
+    ASSERT_EQ(BulkResponseScanner::Start::ITEMS, scanner.start(true));
+    ASSERT_TRUE(scanner.nextItem(item));
+    ASSERT_EQ("index", item.action);
+    ASSERT_EQ("a\"\xc3\xa9\xf0\x9f\x98\x80", item.id);
+    ASSERT_EQ(201, item.status);
+    ASSERT_TRUE(item.errorType.empty());
+
+    ASSERT_TRUE(scanner.nextItem(item));
+    ASSERT_EQ("create", item.action);
+    ASSERT_EQ(400, item.status);
+    ASSERT_EQ("mapper_exception", item.errorType);
+    ASSERT_EQ("bad\ndoc", item.errorReason);
+
+    // missing status means failure, error may be a string
+    ASSERT_TRUE(scanner.nextItem(item));
+    ASSERT_EQ("delete", item.action);
+    ASSERT_EQ(500, item.status);
+    ASSERT_EQ("old style error", item.errorReason);
+
+    ASSERT_TRUE(scanner.nextItem(item));
+    ASSERT_TRUE(item.action.empty());
+    ASSERT_TRUE(scanner.nextItem(item));
+    ASSERT_FALSE(item.statusValid);
+    ASSERT_FALSE(scanner.nextItem(item));
+    ASSERT_TRUE(scanner.valid());
+
+    // other shapes of the response
+    ASSERT_EQ(BulkResponseScanner::Start::NO_ITEMS,
+              BulkResponseScanner("{\"errors\": true}").start(true));
+    ASSERT_EQ(BulkResponseScanner::Start::ITEMS_NOT_ARRAY,
+              BulkResponseScanner("{\"errors\": true, \"items\": {}}").start(true));
+    ASSERT_EQ(BulkResponseScanner::Start::INVALID,
+              BulkResponseScanner("Internal Server Error").start(true));
+
+    // syntax error inside items
+    const std::string brokenResponse = "{\"errors\": true, \"items\": ["
+                                       "{\"index\": {\"status\": 201}} {\"index\": {}}]}";
+    BulkResponseScanner broken(brokenResponse);
+    ASSERT_EQ(BulkResponseScanner::Start::ITEMS, broken.start(true));
+    ASSERT_TRUE(broken.nextItem(item));
+    ASSERT_FALSE(broken.nextItem(item));
+    ASSERT_FALSE(broken.valid());
+}
+
+
+TEST_F(ElasticlientTest, bulkDocumentCheck) {
+    const auto check = [](const std::string &doc) {
+        return checkDocument(doc.data(), doc.size());
+    };
+    ASSERT_EQ(DocumentCheck::VALID, check(""));
+    ASSERT_EQ(DocumentCheck::VALID, check("{\"a\": [1, {\"b\": \"}]\\\"\\u00e9\"}],\t\"c\": null}\r"));
+    ASSERT_EQ(DocumentCheck::VALID, check("{\"name\": \"\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88 \xf0\x9f\x90\xb4\"}"));
+    ASSERT_EQ(DocumentCheck::NEWLINE, check("{\"a\": 1,\n\"b\": 2}"));
+    ASSERT_EQ(DocumentCheck::NEWLINE, check("{\"a\": \"long enough text to reach next block\n\"}"));
+    ASSERT_EQ(DocumentCheck::INVALID_UTF8, check("{\"a\": \"\xc3\"}"));
+    ASSERT_EQ(DocumentCheck::INVALID_UTF8, check("{\"a\": \"overlong \xc0\xaf\"}"));
+    ASSERT_EQ(DocumentCheck::INVALID_UTF8, check("{\"a\": \"surrogate \xed\xa0\x80\"}"));
+    ASSERT_EQ(DocumentCheck::INVALID_UTF8, check("{\"a\": \"truncated \xf0\x9f\x90"));
+    ASSERT_EQ(DocumentCheck::MALFORMED, check("{\"a\": [1, 2}"));
+    ASSERT_EQ(DocumentCheck::MALFORMED, check("{\"a\": 1}}"));
+    ASSERT_EQ(DocumentCheck::MALFORMED, check("{\"a\": \"unterminated}"));
+    ASSERT_EQ(DocumentCheck::MALFORMED, check("{\"a\": \"bad \\x escape\"}"));
+    ASSERT_EQ(DocumentCheck::MALFORMED, check("{\"a\": \"tab\tinside\"}"));
+    ASSERT_EQ(DocumentCheck::MALFORMED, check(std::string(300, '[') + std::string(300, ']')));
+
+    // vectorized scan agrees with byte by byte one on sequences crossing blocks
+    std::mt19937 random(42);
+    const std::string alphabet = "{}[]\"\\ua0\t\n\x01\xc3\xa9\xe2\x82\xac\xf0\x9f";
+    for (int i = 0; i < 20000; ++i) {
+        std::string doc(random() % 80, ' ');
+        for (char &c: doc) {
+            c = random() % 3 ? 'x' : alphabet[random() % alphabet.size()];
+        }
+        ASSERT_EQ(checkDocumentScalar(doc.data(), doc.size()), check(doc)) << doc;
+    }
+
+    // bulks reject malformed documents unless validation is off
+    SameIndexBulkData bulk("my_index");
+    ASSERT_THROW(bulk.indexDocument("type", "id1", "{\"a\": \"\xff\"}"), std::runtime_error);
+    ASSERT_THROW(bulk.indexDocument("type", "id1", "{\"a\": [}"), std::runtime_error);
+    ASSERT_FALSE(bulk.indexDocument("type", "id1", "{\"a\": [}", false));
+    ASSERT_EQ(1U, bulk.size());
+}
+
+
+TEST_F(ElasticlientTest, bulkIngestionAllocations) {
+    const std::string doc = "{\"title\": \"" + std::string(200, 'x') + "\"}";
+    std::vector<std::string> ids;
+    for (int i = 0; i < 50; ++i) {
+        ids.push_back("document-identifier-" + std::to_string(i));
+    }
+    const std::string docType = "type";
+    const std::string indexName = "my_index";
+    BulkItemMetadata metadata;
+    metadata.routing = "user-routing-value";
+
+    // the first bulk grows the buffer, the same bulk after clear() allocates nothing
+    SameIndexBulkData bulk(indexName, ids.size());
+    MultiIndexBulkData multiBulk(ids.size());
+    for (int round = 0; round < 2; ++round) {
+        bulk.clear();
+        multiBulk.clear();
+        const std::size_t allocations = threadAllocations;
+        for (const std::string &id: ids) {
+            bulk.indexDocument(docType, id, doc);
+            bulk.createDocument(docType, id, DocumentView(doc.data(), doc.size()), metadata);
+            multiBulk.updateDocument(indexName, docType, id, doc, metadata);
+            multiBulk.indexDocument(indexName, docType, id,
+                                    DocumentView(doc.data(), doc.size()), false);
+        }
+        if (round) {
+            ASSERT_EQ(allocations, threadAllocations);
+        } else {
+            ASSERT_LT(allocations, threadAllocations);
+        }
+    }
+
+    // document views are serialized the same way as strings
+    SameIndexBulkData fromStrings(indexName);
+    SameIndexBulkData fromViews(indexName);
+    fromStrings.updateDocument(docType, "id1", doc, metadata);
+    fromViews.updateDocument(docType, "id1", DocumentView(doc.data(), doc.size()), metadata);
+    ASSERT_EQ(fromStrings.body(), fromViews.body());
+    ASSERT_THROW(fromViews.indexDocument(docType, "id2", DocumentView("{\n}", 3)),
+                 std::runtime_error);
 }
 
 
@@ -302,6 +1359,922 @@ TEST_F(ElasticlientTest, bulkBasics) {
 }
 
 
+TEST_F(ElasticlientTest, bulkMultiIndex) {
+    // each control line carries its index
+    MultiIndexBulkData bulk(3);
+    ASSERT_EQ("", bulk.indexName());
+    ASSERT_FALSE(bulk.indexDocument("logs-1", "type1", "id1", "{data1}"));
+    ASSERT_FALSE(bulk.createDocument("logs-2", "type1", "fail2", "{data2}"));
+    ASSERT_TRUE(bulk.indexDocument("logs-3", "type1", "", "{data3}"));
+    ASSERT_THROW(bulk.indexDocument("", "type1", "id4", "{data4}"), std::runtime_error);
+    ASSERT_THROW(bulk.indexDocument("logs-1", "type1", "id4", "{\n}"), std::runtime_error);
+    ASSERT_EQ(3U, bulk.size());
+    const std::string expected =
+        "{\"index\": {\"_index\": \"logs-1\", \"_type\": \"type1\", \"_id\": \"id1\"}}\n"
+        "{data1}\n"
+        "{\"create\": {\"_index\": \"logs-2\", \"_type\": \"type1\", \"_id\": \"fail2\"}}\n"
+        "{data2}\n"
+        "{\"index\": {\"_index\": \"logs-3\", \"_type\": \"type1\"}}\n"
+        "{data3}\n";
+    ASSERT_EQ(expected, bulk.body());
+    ASSERT_EQ(expected.size(), bulk.byteSize());
+
+    // whole bulk is sent to /_bulk in one request
+    Bulk indexer(std::make_shared<Client>(getMockedHosts()));
+    ASSERT_EQ(1U, indexer.perform(bulk));
+    HTTPMock *httpMock = dynamic_cast<HTTPMock*>(
+        mock_server_env->getMock().operator->().get());
+    const HTTPMock::CallData callData = httpMock->getLastCallData();
+    ASSERT_EQ("/_bulk", callData.url);
+    ASSERT_EQ(expected, callData.data);
+
+    bulk.clear();
+    ASSERT_TRUE(bulk.empty());
+    ASSERT_EQ(0U, bulk.byteSize());
+}
+
+
+TEST_F(ElasticlientTest, bulkCoalescing) {
+    MultiIndexBulkData bulk(4);
+    bulk.indexDocument("logs", "type1", "before", "{\"a\":1}");
+    bulk.setCoalescing(true);
+    // document indexed before coalescing was enabled is kept
+    ASSERT_FALSE(bulk.indexDocument("logs", "type1", "before", "{\"a\":2}"));
+    // only the last index of a document is kept
+    ASSERT_FALSE(bulk.indexDocument("logs", "type1", "id1", "{\"a\":1}"));
+    ASSERT_FALSE(bulk.indexDocument("logs", "type1", "id1", "{\"a\":2,\"b\":{\"c\":1}}"));
+    // partial update is merged into indexed document
+    bulk.updateDocument("logs", "type1", "id1", "{\"doc\":{\"b\":{\"d\":2}}}");
+    // successive partial updates are merged into one
+    bulk.updateDocument("logs", "type1", "id2", "{\"doc\":{\"a\":1}}");
+    bulk.updateDocument("logs", "type1", "id2", "{\"doc\":{\"a\":2,\"b\":3}}");
+    // the same ID in another index is another document
+    bulk.updateDocument("other", "type1", "id2", "{\"doc\":{\"c\":4}}");
+    ASSERT_EQ(5U, bulk.size());
+    ASSERT_EQ(1U, bulk.getDroppedCount());
+    ASSERT_EQ(2U, bulk.getMergedCount());
+    const std::string expected =
+        "{\"index\": {\"_index\": \"logs\", \"_type\": \"type1\", \"_id\": \"before\"}}\n"
+        "{\"a\":1}\n"
+        "{\"index\": {\"_index\": \"logs\", \"_type\": \"type1\", \"_id\": \"before\"}}\n"
+        "{\"a\":2}\n"
+        "{\"index\": {\"_index\": \"logs\", \"_type\": \"type1\", \"_id\": \"id1\"}}\n"
+        "{\"a\":2,\"b\":{\"c\":1,\"d\":2}}\n"
+        "{\"update\": {\"_index\": \"logs\", \"_type\": \"type1\", \"_id\": \"id2\"}}\n"
+        "{\"doc\":{\"a\":2,\"b\":3}}\n"
+        "{\"update\": {\"_index\": \"other\", \"_type\": \"type1\", \"_id\": \"id2\"}}\n"
+        "{\"doc\":{\"c\":4}}\n";
+    ASSERT_EQ(expected, bulk.body());
+    ASSERT_EQ(expected.size(), bulk.byteSize());
+
+    // delete, create, scripted updates and items with metadata are not coalesced
+    BulkItemMetadata metadata;
+    metadata.routing = "r1";
+    SameIndexBulkData same("logs");
+    same.setCoalescing(true);
+    same.indexDocument("type1", "id1", "{\"a\":1}");
+    same.deleteDocument("type1", "id1");
+    same.indexDocument("type1", "id1", "{\"a\":2}");
+    same.updateDocument("type1", "id1", "{\"script\":\"x\"}");
+    same.updateDocument("type1", "id1", "{\"doc\":{\"a\":3}}");
+    same.createDocument("type1", "id2", "{\"a\":1}");
+    same.indexDocument("type1", "id2", "{\"a\":2}");
+    same.indexDocument("type1", "id2", "{\"a\":3}", metadata);
+    same.indexDocument("type1", "id2", "{\"a\":4}", metadata);
+    ASSERT_EQ(9U, same.size());
+    ASSERT_EQ(0U, same.getDroppedCount());
+    ASSERT_EQ(0U, same.getMergedCount());
+
+    // index still replaces the last update of the document
+    same.indexDocument("type1", "id1", "{\"a\":5}");
+    ASSERT_EQ(9U, same.size());
+    ASSERT_EQ(1U, same.getDroppedCount());
+    ASSERT_EQ(std::string::npos, same.body().find("{\"a\":3}}"));
+
+    // counters survive clear(), index of documents does not
+    same.clear();
+    same.indexDocument("type1", "id1", "{\"a\":6}");
+    ASSERT_EQ(1U, same.size());
+    ASSERT_EQ(1U, same.getDroppedCount());
+
+    // bulk with dropped items can be read by more threads at once
+    same.indexDocument("type1", "id2", "{\"a\":7}");
+    same.indexDocument("type1", "id1", "{\"a\":8}");
+    const std::string coalesced = createControl("index", "type1", "id2") + "\n{\"a\":7}\n"
+                               + createControl("index", "type1", "id1") + "\n{\"a\":8}\n";
+    std::vector<std::thread> readers;
+    std::atomic<int> matching(0);
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&same, &coalesced, &matching]() {
+            if (same.bodyBuffer() == coalesced) {
+                ++matching;
+            }
+        });
+    }
+    for (std::thread &reader: readers) {
+        reader.join();
+    }
+    ASSERT_EQ(4, matching.load());
+}
+
+
+TEST_F(ElasticlientTest, bulkJsonDocument) {
+    Json::FastWriter writer;
+    writer.omitEndingLineFeed();
+    // serialization is byte-identical to FastWriter for ASCII documents
+    Json::Value doc;
+    doc["int"] = -42;
+    doc["min"] = Json::Value::Int64(-9223372036854775807LL - 1);
+    doc["max"] = Json::Value::UInt64(18446744073709551615ULL);
+    doc["zero"] = 0;
+    doc["whole"] = 1234.0;
+    doc["negativeZero"] = -0.0;
+    doc["fraction"] = 0.1;
+    doc["huge"] = 1e300;
+    doc["small"] = -2.5e-7;
+    doc["null"] = Json::Value();
+    doc["flags"].append(true);
+    doc["flags"].append(false);
+    doc["text"] = "quote \" backslash \\ newline \n tab \t control \x01 slash /";
+    doc["nested"]["array"].append(Json::Value(Json::arrayValue));
+    doc["nested"]["array"].append(Json::Value(Json::objectValue));
+    doc["nested"]["array"].append(1.5);
+    std::string serialized;
+    appendJsonValue(serialized, doc);
+    ASSERT_EQ(writer.write(doc), serialized);
+
+    // UTF-8 is kept as it is, document still parses to the same value
+    Json::Value utf;
+    utf["name"] = "P\xc5\x99\xc3\xadli\xc5\xa1 \xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd k\xc5\xaf\xc5\x88";
+    utf["ratio"] = 2.0 / 3.0;
+    serialized.clear();
+    appendJsonValue(serialized, utf);
+    ASSERT_NE(std::string::npos, serialized.find(utf["name"].asString()));
+    Json::Value parsed;
+    ASSERT_TRUE(Json::Reader().parse(serialized, parsed));
+    ASSERT_EQ(utf, parsed);
+
+    // bulk body is the same as with documents serialized by FastWriter
+    Json::Value update;
+    update["doc"]["count"] = 7;
+    BulkItemMetadata metadata;
+    metadata.routing = "r1";
+    SameIndexBulkData fromJson("logs");
+    SameIndexBulkData fromString("logs");
+    fromJson.indexDocument("type1", "id1", doc);
+    fromString.indexDocument("type1", "id1", writer.write(doc));
+    fromJson.updateDocument("type1", "id1", update);
+    fromString.updateDocument("type1", "id1", writer.write(update));
+    fromJson.createDocument("type1", "id2", utf, metadata);
+    fromString.createDocument("type1", "id2", serialized, metadata);
+    ASSERT_EQ(3U, fromJson.size());
+    ASSERT_EQ(fromString.body(), fromJson.body());
+    ASSERT_EQ(fromString.byteSize(), fromJson.byteSize());
+
+    // coalescing works with parsed documents too
+    MultiIndexBulkData multi(2);
+    multi.setCoalescing(true);
+    ASSERT_FALSE(multi.indexDocument("logs", "type1", "id1", doc));
+    ASSERT_FALSE(multi.updateDocument("logs", "type1", "id1", update));
+    ASSERT_EQ(1U, multi.size());
+    ASSERT_EQ(1U, multi.getMergedCount());
+    ASSERT_NE(std::string::npos, multi.body().find("\"count\":7"));
+    ASSERT_TRUE(multi.indexDocument("other", "type1", "id1", update));
+    ASSERT_THROW(multi.indexDocument("", "type1", "id1", doc), std::runtime_error);
+}
+
+
+TEST_F(ElasticlientTest, bulkRetry) {
+    // items are split including delete action without source line
+    const std::string body = "{\"index\": {}}\n{a}\n{\"delete\": {}}\n{\"create\": {}}\n{b}\n";
+    const std::vector<std::pair<std::size_t, std::size_t>> items = splitBulkItems(body);
+    ASSERT_EQ(3U, items.size());
+    ASSERT_EQ("{\"delete\": {}}\n", body.substr(items[1].first, items[1].second));
+    ASSERT_EQ("{\"create\": {}}\n{b}\n", body.substr(items[2].first, items[2].second));
+
+    Bulk indexer(std::make_shared<Client>(getMockedHosts()));
+    SameIndexBulkData bulk("bulk_retry");
+    const auto fillBulk = [&bulk](const std::string &suffix) {
+        bulk.clear();
+        for (const std::string id: {"ok1", "reject1", "always1", "bad1", "conflict1"}) {
+            bulk.indexDocument("type", id + suffix, "{\"id\": \"" + id + suffix + "\"}");
+        }
+    };
+    fillBulk("");
+
+    // without retries all failed items are reported
+    ASSERT_EQ(4U, indexer.perform(bulk));
+    ASSERT_EQ(4U, indexer.getFailedItems().size());
+    ASSERT_EQ(429, indexer.getFailedItems()[0].status);
+    ASSERT_EQ("es_rejected_execution_exception", indexer.getFailedItems()[0].errorType);
+    ASSERT_EQ(createControl("index", "type", "reject1") + "\n{\"id\": \"reject1\"}\n",
+              indexer.getFailedItems()[0].item);
+    ASSERT_EQ(1U, indexer.getStatistics().requests);
+    ASSERT_EQ(2U, indexer.getStatistics().rejectedItems);
+
+    // rejected items are sent again, only "always" one fails on rejection
+    Bulk::RetryPolicy policy;
+    policy.maxAttempts = 3;
+    policy.initialBackoff = std::chrono::milliseconds(1);
+    indexer.setRetryPolicy(policy);
+    fillBulk("_");
+    ASSERT_EQ(3U, indexer.perform(bulk));
+    ASSERT_EQ(3U, indexer.getStatistics().requests);
+    ASSERT_EQ(3, indexer.getStatistics().took.count());
+    ASSERT_EQ(4U, indexer.getStatistics().rejectedItems);
+    const std::vector<Bulk::FailedItem> &failed = indexer.getFailedItems();
+    ASSERT_EQ(3U, failed.size());
+    ASSERT_EQ(400, failed[0].status);
+    ASSERT_EQ(409, failed[1].status);
+    ASSERT_EQ(429, failed[2].status);
+    ASSERT_NE(std::string::npos, failed[2].item.find("always1_"));
+
+    // last retry contained only the "always" item
+    HTTPMock *httpMock = dynamic_cast<HTTPMock*>(
+        mock_server_env->getMock().operator->().get());
+    ASSERT_EQ(failed[2].item, httpMock->getLastCallData().data);
+    ASSERT_EQ(0U, indexer.getResult().size());
+}
+
+
+TEST_F(ElasticlientTest, bulkResult) {
+    Bulk indexer(std::make_shared<Client>(getMockedHosts()));
+    indexer.setResultCollection(true);
+    Bulk::RetryPolicy policy;
+    policy.maxAttempts = 2;
+    policy.initialBackoff = std::chrono::milliseconds(1);
+    indexer.setRetryPolicy(policy);
+
+    SameIndexBulkData bulk("bulk_retry");
+    for (const std::string id: {"ok2", "bad2", "reject2", "bad3", "always2"}) {
+        bulk.indexDocument("type", id, "{}");
+    }
+    ASSERT_EQ(3U, indexer.perform(bulk));
+
+    // results are at positions of the items, retried items have their final result
+    const BulkResult &result = indexer.getResult();
+    ASSERT_EQ(5U, result.size());
+    ASSERT_EQ(3U, result.errorCount());
+    ASSERT_EQ(BulkResult::Action::INDEX, result.action(0));
+    ASSERT_EQ("ok2", result.id(0));
+    ASSERT_EQ(201, result.status(0));
+    ASSERT_FALSE(result.failed(0));
+    ASSERT_EQ("", result.errorType(0));
+    ASSERT_EQ("bad2", result.id(1));
+    ASSERT_EQ(400, result.status(1));
+    ASSERT_EQ("mapper_parsing_exception", result.errorType(1));
+    ASSERT_EQ("failed bad2", result.errorReason(1));
+    ASSERT_EQ("reject2", result.id(2));
+    ASSERT_FALSE(result.failed(2));
+    ASSERT_EQ(&result.errorType(1), &result.errorType(3));
+    ASSERT_EQ("always2", result.id(4));
+    ASSERT_EQ(429, result.status(4));
+    ASSERT_TRUE(result.failed(4));
+
+    // whole failed bulk has items without response
+    SameIndexBulkData failing("bulk_basics");
+    failing.indexDocument("type", "1", "{}");
+    failing.createDocument("type", "2", "{}");
+    ASSERT_EQ(2U, indexer.perform(failing));
+    ASSERT_EQ(2U, indexer.getResult().size());
+    ASSERT_EQ(BulkResult::Action::UNKNOWN, indexer.getResult().action(1));
+    ASSERT_EQ(500, indexer.getResult().status(1));
+    const BulkResult copy = indexer.getResult();
+    ASSERT_EQ(2U, copy.errorCount());
+
+    // items without readable response are failed in both bulk and its result
+    SameIndexBulkData partial("bulk_partial");
+    for (const std::string id: {"1", "2", "3"}) {
+        partial.indexDocument("type", id, "{}");
+    }
+    ASSERT_EQ(2U, indexer.perform(partial));
+    ASSERT_EQ(2U, indexer.getResult().errorCount());
+    ASSERT_EQ(2U, indexer.getFailedItems().size());
+    ASSERT_EQ(0, indexer.getFailedItems()[0].status);
+    ASSERT_FALSE(indexer.getResult().failed(0));
+    ASSERT_EQ(0, indexer.getResult().status(1));
+    ASSERT_TRUE(indexer.getResult().failed(2));
+
+    // delete of missing document is not a failure
+    MultiIndexBulkData deletes;
+    deletes.deleteDocument("index", "type", "missing1");
+    deletes.deleteDocument("index", "type", "fail2");
+    ASSERT_EQ(1U, indexer.perform(deletes));
+    ASSERT_EQ(1U, indexer.getResult().errorCount());
+    ASSERT_EQ(BulkResult::Action::DELETE, indexer.getResult().action(0));
+    ASSERT_EQ(404, indexer.getResult().status(0));
+    ASSERT_FALSE(indexer.getResult().failed(0));
+    ASSERT_TRUE(indexer.getResult().failed(1));
+}
+
+
+TEST_F(ElasticlientTest, bulkStreamed) {
+    // Producer of count items, every tenth one fails
+    class GeneratedBulk: public IBulkDataProducer {
+        std::size_t produced;
+        const std::size_t count;
+      public:
+        std::string body;
+
+        explicit GeneratedBulk(std::size_t count): produced(0), count(count), body() {}
+
+        std::string indexName() const override {
+            return "bulk_stream";
+        }
+
+        bool next(std::string &out) override {
+            if (produced == count) {
+                return false;
+            }
+            const std::string id = (produced % 10 ? "id" : "fail") + std::to_string(produced);
+            const std::string item = createControl("index", "type", id) + "\n"
+                                   + "{\"data\": \"" + std::string(500, 'x') + "\"}\n";
+            out += item;
+            body += item;
+            ++produced;
+            return true;
+        }
+    };
+
+    Bulk indexer(std::make_shared<Client>(getMockedHosts()));
+    GeneratedBulk bulk(1000);
+    ASSERT_EQ(100U, indexer.perform(bulk));
+
+    HTTPMock *httpMock = dynamic_cast<HTTPMock*>(
+        mock_server_env->getMock().operator->().get());
+    HTTPMock::CallData lastCallData = httpMock->getLastCallData();
+    ASSERT_EQ("/bulk_stream/_bulk", lastCallData.url);
+    ASSERT_EQ("POST", lastCallData.method);
+    ASSERT_EQ(bulk.body, lastCallData.data);
+
+    // empty bulk is not sent, failed request counts all items
+    GeneratedBulk empty(0);
+    ASSERT_EQ(0U, indexer.perform(empty));
+    class FailingBulk: public GeneratedBulk {
+      public:
+        FailingBulk(): GeneratedBulk(3) {}
+        std::string indexName() const override {
+            return "bulk_basics";
+        }
+    } failing;
+    ASSERT_EQ(3U, indexer.perform(failing));
+    ASSERT_EQ(3U, indexer.getFailedItems().size());
+    ASSERT_EQ(500, indexer.getFailedItems()[2].status);
+
+    // connection dropped in the middle of the body, items not sent are counted too
+    const int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(addr);
+    ASSERT_EQ(0, ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listenFd, 1));
+    ASSERT_EQ(0, ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &length));
+    std::thread server([listenFd]() {
+        pollfd listening = {listenFd, POLLIN, 0};
+        if (::poll(&listening, 1, 5000) <= 0) {
+            return;
+        }
+        // read a part of the body and reset the connection
+        const int fd = ::accept(listenFd, nullptr, nullptr);
+        char buffer[4096];
+        std::size_t received = 0;
+        pollfd connection = {fd, POLLIN, 0};
+        while (received < 16384 && ::poll(&connection, 1, 5000) > 0) {
+            const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                break;
+            }
+            received += n;
+        }
+        linger reset = {1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        ::close(fd);
+    });
+    Bulk dropping(std::make_shared<Client>(std::vector<std::string>(
+            {"http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)) + "/"})));
+    GeneratedBulk large(20000);
+    ASSERT_EQ(20000U, dropping.perform(large));
+    ASSERT_EQ(20000U, dropping.getFailedItems().size());
+    std::string rest;
+    ASSERT_FALSE(large.next(rest));
+    server.join();
+    ::close(listenFd);
+
+    // normal requests work on the same connection after streamed one
+    Client client(getMockedHosts(), Client::MaxConnectionsOption(1));
+    GeneratedBulk small(5);
+    client.performStreamedRequest(Client::HTTPMethod::POST, "bulk_stream/_bulk",
+                                  [&small](std::string &out) { return small.next(out); },
+                                  Client::RequestPriority::NORMAL);
+    ASSERT_EQ(200, client.performRequest(Client::HTTPMethod::GET, "indexA/typeA/123", "")
+                         .status_code);
+    ASSERT_EQ(203, client.performRequest(Client::HTTPMethod::POST, "indexA/typeA/321", "{}")
+                         .status_code);
+}
+
+
+TEST_F(ElasticlientTest, bulkParallel) {
+    // the same mock server reached by two node addresses
+    const std::string port = std::to_string(mock_server_env->getMock()->getPort());
+    std::shared_ptr<Client> client = std::make_shared<Client>(
+            std::vector<std::string>({"http://localhost:" + port + "/",
+                                      "http://127.0.0.1:" + port + "/"}),
+            Client::LoadBalancingOption());
+    Bulk indexer(client);
+    indexer.setParallelism(4);
+    indexer.setResultCollection(true);
+
+    // every tenth item fails, sub-bulks do not respect the tens
+    SameIndexBulkData bulk("bulk_stream", 100);
+    for (int i = 0; i < 100; ++i) {
+        bulk.indexDocument("type", (i % 10 ? "id" : "fail") + std::to_string(i), "{}");
+    }
+    ASSERT_EQ(10U, indexer.performParallel(bulk, 7));
+    ASSERT_EQ(10U, indexer.getFailedItems().size());
+    const BulkResult &result = indexer.getResult();
+    ASSERT_EQ(100U, result.size());
+    ASSERT_EQ(10U, result.errorCount());
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        ASSERT_EQ(i % 10 == 0, result.failed(i));
+    }
+    ASSERT_THROW(indexer.performParallel(bulk, 0), std::runtime_error);
+
+    // more bulks at once, errors of all of them are counted
+    SameIndexBulkData failing("bulk_basics");
+    failing.indexDocument("type", "id1", "{}");
+    failing.indexDocument("type", "id2", "{}");
+    ASSERT_EQ(12U, indexer.performParallel({&bulk, nullptr, &failing}));
+    ASSERT_EQ(102U, indexer.getResult().size());
+    ASSERT_TRUE(indexer.getResult().failed(101));
+    ASSERT_FALSE(indexer.getResult().failed(99));
+    ASSERT_EQ(0U, indexer.performParallel(std::vector<const IBulkData *>()));
+}
+
+
+TEST_F(ElasticlientTest, bulkRouted) {
+    // known values of Murmur3HashFunction of Elasticsearch
+    ASSERT_EQ(static_cast<std::int32_t>(0x5a0cb7c3), routingHash("hell"));
+    ASSERT_EQ(static_cast<std::int32_t>(0xd7c31989), routingHash("hello"));
+    ASSERT_EQ(static_cast<std::int32_t>(0xe07db09c),
+              routingHash("The quick brown fox jumps over the lazy dog"));
+    // hashed as UTF-16 code units, including surrogate pairs
+    ASSERT_EQ(static_cast<std::int32_t>(0x41e915ff), routingHash("\xc3\xa9"));
+    ASSERT_EQ(static_cast<std::int32_t>(0xc49fe1e2), routingHash("\xf0\x9f\x98\x80x"));
+
+    IndexRouting routing;
+    routing.numberOfShards = 5;
+    routing.routingNumShards = 640;
+    for (int i = 0; i < 100; ++i) {
+        const std::string id = "id" + std::to_string(i);
+        const std::int32_t hash = routingHash(id);
+        const std::uint32_t expected = ((hash % 640 + 640) % 640) / 128;
+        ASSERT_EQ(expected, routing.shardOf(id, std::string()));
+        ASSERT_EQ(expected, routing.shardOf("other", id));
+    }
+
+    // routing fields are read from control line
+    const std::string line = "{\"index\": {\"_index\": \"a\\\"b\", \"_type\": \"t\", "
+                             "\"_id\": \"x\", \"version\": 3, \"routing\": \"r\"}}";
+    BulkControlLine control;
+    ASSERT_TRUE(BulkResponseScanner(line.data(), line.data() + line.size())
+                .readControlLine(control));
+    ASSERT_EQ("index", control.action);
+    ASSERT_EQ("a\"b", control.indexName);
+    ASSERT_EQ("x", control.id);
+    ASSERT_EQ("r", control.routing);
+    ASSERT_FALSE(BulkResponseScanner(line.data(), line.data() + 20).readControlLine(control));
+
+    std::shared_ptr<Client> client = std::make_shared<Client>(getMockedHosts());
+    BulkShardRouter::Settings settings;
+    settings.grouping = BulkShardRouter::Grouping::SHARD;
+    BulkShardRouter shardRouter(client, settings);
+    ASSERT_EQ(((routingHash("id1") % 4 + 4) % 4) / 2, shardRouter.shardOf("bulk_stream", "id1"));
+    ASSERT_THROW(shardRouter.shardOf("missing", "id1"), std::runtime_error);
+
+    // every tenth item fails, results keep order of the bulk
+    SameIndexBulkData bulk("bulk_stream", 41);
+    for (int i = 0; i < 40; ++i) {
+        bulk.indexDocument("type", (i % 10 ? "id" : "fail") + std::to_string(i), "{}");
+    }
+    bulk.indexDocument("type", "", "{}");
+    settings.grouping = BulkShardRouter::Grouping::NODE;
+    BulkShardRouter nodeRouter(client, settings);
+    for (BulkShardRouter *router: {&shardRouter, &nodeRouter}) {
+        Bulk indexer(client);
+        indexer.setParallelism(2);
+        indexer.setResultCollection(true);
+        // items of node2, which does not listen, are sent by the bulk Client
+        ASSERT_EQ(4U, indexer.performRouted(bulk, *router));
+        const BulkResult &result = indexer.getResult();
+        ASSERT_EQ(41U, result.size());
+        ASSERT_EQ(4U, result.errorCount());
+        for (std::size_t i = 0; i < 40; ++i) {
+            ASSERT_EQ(i % 10 == 0, result.failed(i));
+        }
+        ASSERT_EQ(0U, indexer.performRouted(SameIndexBulkData("bulk_stream"), *router));
+    }
+
+    // node dropping connection on retry, items it has answered are not sent again
+    FlakyBulkServer flaky(1);
+    BulkShardRouter::Settings flakySettings;
+    flakySettings.grouping = BulkShardRouter::Grouping::NODE;
+    flakySettings.nodeClientFactory = [&flaky](const std::string &) {
+        return std::make_shared<Client>(std::vector<std::string>({flaky.url()}));
+    };
+    BulkShardRouter flakyRouter(client, flakySettings);
+    Bulk flakyIndexer(client);
+    flakyIndexer.setResultCollection(true);
+    Bulk::RetryPolicy policy;
+    policy.maxAttempts = 2;
+    policy.initialBackoff = std::chrono::milliseconds(1);
+    flakyIndexer.setRetryPolicy(policy);
+    const std::size_t flakyErrors = flakyIndexer.performRouted(bulk, flakyRouter);
+    ASSERT_EQ(3U, flaky.getRequests());
+    ASSERT_EQ(flakyIndexer.getResult().errorCount(), flakyErrors);
+    ASSERT_EQ(flakyErrors, flakyIndexer.getFailedItems().size());
+    for (std::size_t i = 0; i < 40; i += 10) {
+        ASSERT_EQ(400, flakyIndexer.getResult().status(i));
+    }
+
+    // router is not locked while cluster state is being read
+    const int silentFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in silentAddr = {};
+    silentAddr.sin_family = AF_INET;
+    silentAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t silentLength = sizeof(silentAddr);
+    ASSERT_EQ(0, ::bind(silentFd, reinterpret_cast<sockaddr *>(&silentAddr),
+                        sizeof(silentAddr)));
+    ASSERT_EQ(0, ::listen(silentFd, 16));
+    ASSERT_EQ(0, ::getsockname(silentFd, reinterpret_cast<sockaddr *>(&silentAddr),
+                               &silentLength));
+    BulkShardRouter silentRouter(std::make_shared<Client>(
+            std::vector<std::string>(
+                {"http://127.0.0.1:" + std::to_string(ntohs(silentAddr.sin_port)) + "/"}),
+            Client::TimeoutOption{1000}));
+    std::thread reading([&silentRouter]() {
+        EXPECT_THROW(silentRouter.shardOf("bulk_stream", "id1"), std::runtime_error);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const std::chrono::steady_clock::time_point invalidated = std::chrono::steady_clock::now();
+    silentRouter.invalidate();
+    ASSERT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - invalidated).count(), 500);
+    reading.join();
+    ::close(silentFd);
+
+    // items of index without routing are sent as usual
+    MultiIndexBulkData multiBulk;
+    multiBulk.indexDocument("bulk_stream", "type", "id1", "{}");
+    multiBulk.indexDocument("bulk_ok", "type", "fail2", "{}");
+    Bulk indexer(client);
+    ASSERT_EQ(1U, indexer.performRouted(multiBulk, nodeRouter));
+}
+
+
+TEST_F(ElasticlientTest, bulkSpill) {
+    char directory[] = "/tmp/elasticlient-spill-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(directory));
+    ASSERT_THROW(BulkSpillQueue(std::string(directory) + "/missing"), std::runtime_error);
+
+    SameIndexBulkData bulk("bulk_ok");
+    bulk.indexDocument("type", "id1", "{}");
+    bulk.indexDocument("type", "id2", "{}");
+    std::size_t spilledBytes;
+    {
+        // items are spilled instead of failing while no host responds
+        std::shared_ptr<BulkSpillQueue> queue = std::make_shared<BulkSpillQueue>(directory);
+        Bulk indexer(std::make_shared<Client>(
+                std::vector<std::string>({"http://localhost:1/"})));
+        indexer.setSpillQueue(queue);
+        ASSERT_EQ(0U, indexer.perform(bulk));
+        ASSERT_EQ(0U, indexer.perform(bulk));
+        ASSERT_EQ(2U, indexer.getStatistics().spilledItems);
+        ASSERT_EQ(2U, queue->size());
+        ASSERT_GT(queue->byteSize(), 2 * bulk.byteSize());
+        spilledBytes = queue->byteSize();
+
+        // replay stops while the cluster is unavailable
+        ASSERT_EQ(0U, queue->replay(indexer));
+        ASSERT_EQ(2U, queue->size());
+    }
+
+    // spilled bulks survive reopening and are replayed in order
+    BulkSpillQueue queue(directory);
+    ASSERT_EQ(2U, queue.size());
+    ASSERT_EQ(spilledBytes, queue.byteSize());
+    Bulk indexer(std::make_shared<Client>(getMockedHosts()));
+    ASSERT_EQ(2U, queue.replay(indexer, 1000));
+    ASSERT_TRUE(queue.empty());
+    ASSERT_EQ(0U, queue.byteSize());
+    ASSERT_EQ(0U, indexer.getErrorCount());
+    HTTPMock *httpMock = dynamic_cast<HTTPMock*>(
+        mock_server_env->getMock().operator->().get());
+    ASSERT_EQ(bulk.body(), httpMock->getLastCallData().data);
+
+    // unknown files are ignored
+    const std::string stray = std::string(directory) + "/bulk-spill-x.seg";
+    std::ofstream(stray) << "x";
+    std::shared_ptr<BulkSpillQueue> reopened;
+    ASSERT_NO_THROW(reopened = std::make_shared<BulkSpillQueue>(directory));
+    ASSERT_TRUE(reopened->empty());
+
+    // bulk answered before the cluster became unavailable is not replayed again,
+    // only its retried items are spilled
+    SameIndexBulkData failing("bulk_stream");
+    failing.indexDocument("type", "fail1", "{}");
+    failing.indexDocument("type", "id2", "{}");
+    {
+        Bulk spilling(std::make_shared<Client>(
+                std::vector<std::string>({"http://localhost:1/"})));
+        spilling.setSpillQueue(reopened);
+        ASSERT_EQ(0U, spilling.perform(failing));
+    }
+    FlakyBulkServer flaky(1);
+    Bulk replaying(std::make_shared<Client>(std::vector<std::string>({flaky.url()})));
+    Bulk::RetryPolicy policy;
+    policy.maxAttempts = 2;
+    policy.initialBackoff = std::chrono::milliseconds(1);
+    replaying.setRetryPolicy(policy);
+    replaying.setSpillQueue(reopened);
+    ASSERT_EQ(1U, reopened->replay(replaying));
+    ASSERT_EQ(2U, flaky.getRequests());
+    ASSERT_EQ(1U, replaying.getErrorCount());
+    ASSERT_EQ(400, replaying.getFailedItems()[0].status);
+    ASSERT_EQ(1U, replaying.getStatistics().spilledItems);
+    ASSERT_EQ(1U, reopened->size());
+    ASSERT_EQ(1U, reopened->replay(indexer));
+    ASSERT_EQ(0U, indexer.getErrorCount());
+    ASSERT_NE(std::string::npos, httpMock->getLastCallData().data.find("id2"));
+    ASSERT_EQ(std::string::npos, httpMock->getLastCallData().data.find("fail1"));
+    ASSERT_TRUE(reopened->empty());
+    reopened.reset();
+
+    // bulk written partially before crash is neither counted nor replayed
+    {
+        std::shared_ptr<BulkSpillQueue> spilled = std::make_shared<BulkSpillQueue>(directory);
+        Bulk spilling(std::make_shared<Client>(
+                std::vector<std::string>({"http://localhost:1/"})));
+        spilling.setSpillQueue(spilled);
+        ASSERT_EQ(0U, spilling.perform(bulk));
+        spilledBytes = spilled->byteSize();
+    }
+    std::ofstream(std::string(directory) + "/bulk-spill-00000000000000000000.seg",
+                  std::ios::app) << "bulk_ok/_bulk 2 1000\n{\"index\": {}}\n";
+    reopened = std::make_shared<BulkSpillQueue>(directory);
+    ASSERT_EQ(1U, reopened->size());
+    ASSERT_EQ(spilledBytes, reopened->byteSize());
+    ASSERT_EQ(1U, reopened->replay(indexer));
+    ASSERT_EQ(bulk.body(), httpMock->getLastCallData().data);
+    ASSERT_TRUE(reopened->empty());
+
+    reopened.reset();
+    ASSERT_EQ(0, unlink(stray.c_str()));
+    ASSERT_EQ(0, rmdir(directory));
+}
+
+
+TEST_F(ElasticlientTest, bulkFileLoader) {
+    // items end after source line, delete action has none
+    const std::string items = "{\"delete\": {}}\n{\"index\": {}}\n{a}\n{\"index\": {}}";
+    const char *begin = items.data();
+    const char *end = begin + items.size();
+    const char *next = bulkFileItemEnd(begin, end, BulkFileLoader::Format::BULK);
+    ASSERT_EQ(15, next - begin);
+    ASSERT_EQ(next + 18, bulkFileItemEnd(next, end, BulkFileLoader::Format::BULK));
+    ASSERT_EQ(next + 14, bulkFileItemEnd(next, end, BulkFileLoader::Format::DOCUMENTS));
+    ASSERT_EQ(end, bulkFileItemEnd(next + 18, end, BulkFileLoader::Format::BULK));
+    const std::string blank = "{\"index\": {}}\n\n{a}\n{\"index\": {}}\n";
+    ASSERT_EQ(blank.data() + 19, bulkFileItemEnd(blank.data(), blank.data() + blank.size(),
+                                                 BulkFileLoader::Format::BULK));
+
+    char path[] = "/tmp/elasticlient-load-XXXXXX";
+    const int fd = mkstemp(path);
+    ASSERT_LE(0, fd);
+    const std::string documents = "{\"a\": 1}\n\n{\"a\": 2}\r\n{\"a\": 3}\n{\"a\": 4}\n{\"a\": 5}";
+    ASSERT_EQ(static_cast<ssize_t>(documents.size()),
+              write(fd, documents.data(), documents.size()));
+    close(fd);
+
+    // documents are batched by two, blank line is skipped
+    std::shared_ptr<Client> client = std::make_shared<Client>(getMockedHosts());
+    BulkFileLoader::Settings settings;
+    settings.maxDocuments = 2;
+    settings.workers = 2;
+    std::atomic<int> reports(0);
+    settings.progressCallback = [&reports](const BulkFileLoader::Progress &) { ++reports; };
+    BulkFileLoader loader(client, "bulk_stream", settings);
+    BulkFileLoader::Progress progress = loader.load(path);
+    ASSERT_EQ(5U, progress.documents);
+    ASSERT_EQ(0U, progress.errors);
+    ASSERT_EQ(3U, progress.bulks);
+    ASSERT_EQ(documents.size(), progress.bytes);
+    ASSERT_EQ(documents.size(), progress.totalBytes);
+    ASSERT_LE(1, reports.load());
+    ASSERT_EQ(5U, loader.getProgress().documents);
+
+    // bulk format is sent as it is, index may be given by control lines
+    std::ofstream(path) << "{\"index\": {\"_index\": \"i\", \"_id\": \"fail1\"}}\n{}\n"
+                        << "{\"delete\": {\"_index\": \"i\", \"_id\": \"2\"}}\n"
+                        << "{\"create\": {\"_index\": \"i\", \"_id\": \"3\"}}\n{}\n";
+    settings.format = BulkFileLoader::Format::BULK;
+    settings.maxDocuments = 10;
+    BulkFileLoader bulkLoader(client, "", settings);
+    progress = bulkLoader.load(path);
+    ASSERT_EQ(3U, progress.documents);
+    ASSERT_EQ(1U, progress.bulks);
+    ASSERT_EQ(1U, progress.errors);
+    HTTPMock *httpMock = dynamic_cast<HTTPMock*>(
+        mock_server_env->getMock().operator->().get());
+    ASSERT_EQ("/_bulk", httpMock->getLastCallData().url);
+
+    // blank lines between and inside items are not sent
+    const std::string first = "{\"index\": {\"_index\": \"i\", \"_id\": \"1\"}}\n{}\n";
+    const std::string second = "{\"index\": {\"_index\": \"i\", \"_id\": \"2\"}}\n";
+    std::ofstream(path) << first << "\n" << second << "\r\n{}\n";
+    settings.maxDocuments = 1;
+    BulkFileLoader blankLoader(client, "", settings);
+    progress = blankLoader.load(path);
+    ASSERT_EQ(2U, progress.documents);
+    ASSERT_EQ(2U, progress.bulks);
+    ASSERT_EQ(0U, progress.errors);
+    ASSERT_EQ(second + "{}\n", httpMock->getLastCallData().data);
+
+    ASSERT_EQ(0, unlink(path));
+    ASSERT_THROW(loader.load(path), std::runtime_error);
+    ASSERT_THROW(BulkFileLoader(client, "", BulkFileLoader::Settings()), std::runtime_error);
+}
+
+
+TEST_F(ElasticlientTest, bulkPipeline) {
+    std::shared_ptr<Client> client = std::make_shared<Client>(getMockedHosts());
+    BulkPipeline::Settings settings;
+    settings.maxDocuments = 10;
+    {
+        // every tenth item fails
+        BulkPipeline pipeline(client, "bulk_stream", settings);
+        std::set<const SameIndexBulkData *> buffers;
+        for (int i = 0; i < 25; ++i) {
+            buffers.insert(&pipeline.current());
+            if (pipeline.current().indexDocument("type", (i % 10 ? "id" : "fail")
+                                                 + std::to_string(i), "{}"))
+            {
+                pipeline.send();
+            }
+        }
+        // the two buffers are swapped and reused
+        ASSERT_EQ(2U, buffers.size());
+        pipeline.flush();
+        ASSERT_TRUE(pipeline.current().empty());
+        ASSERT_EQ(25U, pipeline.getSentCount());
+        ASSERT_EQ(3U, pipeline.getErrorCount());
+        ASSERT_EQ(3U, pipeline.getBulkCount());
+        // nothing to send
+        pipeline.send();
+        pipeline.flush();
+        ASSERT_EQ(3U, pipeline.getBulkCount());
+    }
+
+    // the rest is sent by destructor
+    {
+        BulkPipeline pipeline(client, "bulk_ok", settings);
+        pipeline.current().indexDocument("type", "id1", "{}");
+    }
+    HTTPMock *httpMock = dynamic_cast<HTTPMock*>(
+        mock_server_env->getMock().operator->().get());
+    ASSERT_EQ("/bulk_ok/_bulk", httpMock->getLastCallData().url);
+
+    settings.concurrentBulks = 2;
+    ASSERT_THROW(BulkPipeline(client, "bulk_ok", settings), std::runtime_error);
+}
+
+
+TEST_F(ElasticlientTest, bulkProcessor) {
+    const std::shared_ptr<Client> client = std::make_shared<Client>(getMockedHosts());
+
+    // documents from more threads are sent in bulks of maxDocuments
+    BulkProcessor::Settings settings;
+    settings.maxDocuments = 10;
+    settings.concurrentBulks = 2;
+    BulkProcessor processor(client, "bulk_ok", settings);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&processor, t]() {
+            for (int i = 0; i < 25; ++i) {
+                processor.add("type", std::to_string(t) + "_" + std::to_string(i), "{}");
+            }
+        });
+    }
+    for (std::thread &producer: producers) {
+        producer.join();
+    }
+    processor.flush();
+    ASSERT_EQ(100U, processor.getSentCount());
+    ASSERT_EQ(0U, processor.getErrorCount());
+    ASSERT_LE(10U, processor.getBulkCount());
+    ASSERT_THROW(processor.add("type", "id", "{\n}"), std::runtime_error);
+    processor.add("type", "0_0", "", BulkProcessor::Action::DELETE);
+    ASSERT_THROW(processor.add("type", "", "", BulkProcessor::Action::DELETE),
+                 std::runtime_error);
+    processor.close();
+    ASSERT_EQ(101U, processor.getSentCount());
+    ASSERT_THROW(processor.add("type", "id", "{}"), std::runtime_error);
+
+    // not full bulk is sent after linger interval, failures are counted
+    settings.linger = std::chrono::milliseconds(50);
+    BulkProcessor lingering(client, "bulk_basics", settings);
+    lingering.add("type", "id", "{}", BulkProcessor::Action::CREATE);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ASSERT_EQ(1U, lingering.getSentCount());
+    ASSERT_EQ(1U, lingering.getErrorCount());
+
+    // tryAdd refuses documents when sender and queue are busy
+    settings.maxDocuments = 1;
+    settings.concurrentBulks = 1;
+    settings.maxPendingBulks = 1;
+    BulkProcessor busy(client, "bulk_slow", settings);
+    ASSERT_TRUE(busy.tryAdd("type", "1", "{}"));
+    ASSERT_TRUE(busy.tryAdd("type", "2", "{}"));
+    const bool third = busy.tryAdd("type", "3", "{}");
+    ASSERT_FALSE(third && busy.tryAdd("type", "4", "{}"));
+    busy.close();
+    ASSERT_EQ(third ? 3U : 2U, busy.getSentCount());
+
+    // adaptive size grows by full bulks, then concurrency grows
+    AdaptiveBulkSizing sizing(100, 500, 3, std::chrono::milliseconds(50));
+    Bulk::Statistics fast;
+    fast.requests = 1;
+    fast.took = std::chrono::milliseconds(10);
+    sizing.update(60, std::chrono::milliseconds(10), fast);
+    ASSERT_EQ(100U, sizing.getBytes());
+    for (int i = 0; i < 8; ++i) {
+        sizing.update(sizing.getBytes(), std::chrono::milliseconds(10), fast);
+    }
+    ASSERT_EQ(500U, sizing.getBytes());
+    ASSERT_EQ(1U, sizing.getConcurrency());
+    for (int i = 0; i < 5; ++i) {
+        sizing.update(500, std::chrono::milliseconds(10), fast);
+    }
+    ASSERT_EQ(3U, sizing.getConcurrency());
+
+    // slow processing reduces size, rejections halve size and concurrency
+    Bulk::Statistics slow = fast;
+    slow.took = std::chrono::milliseconds(80);
+    sizing.update(500, std::chrono::milliseconds(10), slow);
+    ASSERT_EQ(375U, sizing.getBytes());
+    Bulk::Statistics rejected = fast;
+    rejected.rejectedItems = 1;
+    sizing.update(375, std::chrono::milliseconds(10), rejected);
+    ASSERT_EQ(187U, sizing.getBytes());
+    ASSERT_EQ(1U, sizing.getConcurrency());
+    sizing.update(187, std::chrono::milliseconds(10), rejected);
+    ASSERT_EQ(100U, sizing.getBytes());
+
+    // adaptive processor starts with minBytes
+    settings = BulkProcessor::Settings();
+    settings.adaptive = true;
+    settings.minBytes = 1000;
+    settings.maxBytes = 2000;
+    settings.concurrentBulks = 2;
+    BulkProcessor adaptive(client, "bulk_ok", settings);
+    ASSERT_EQ(1000U, adaptive.getTargetBytes());
+    ASSERT_EQ(1U, adaptive.getTargetConcurrency());
+    for (int i = 0; i < 300; ++i) {
+        adaptive.add("type", std::to_string(i), "{\"data\": \"" + std::string(100, 'x') + "\"}");
+    }
+    adaptive.flush();
+    ASSERT_EQ(2000U, adaptive.getTargetBytes());
+    ASSERT_EQ(2U, adaptive.getTargetConcurrency());
+    settings.minBytes = 3000;
+    ASSERT_THROW(BulkProcessor(client, "bulk_ok", settings), std::runtime_error);
+
+    // senders held back by adaptive concurrency sleep while the slow bulk is sent,
+    // although current bulk waits longer than linger
+    settings = BulkProcessor::Settings();
+    settings.adaptive = true;
+    settings.minBytes = 1000;
+    settings.maxDocuments = 2;
+    settings.linger = std::chrono::milliseconds(10);
+    settings.concurrentBulks = 4;
+    BulkProcessor held(client, "bulk_slow", settings);
+    for (int i = 0; i < 5; ++i) {
+        held.add("type", std::to_string(i), "{}");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const auto cpuTime = []() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+             + std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+    };
+    const std::chrono::microseconds cpuBefore = cpuTime();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_GT(30000, (cpuTime() - cpuBefore).count());
+    held.flush();
+    ASSERT_EQ(5U, held.getSentCount());
+}
+
+
 TEST_F(ElasticlientTest, scroll) {
     Scroll scrollInstance(std::make_shared<Client>(getMockedHosts()), 100, "1m");
     Json::Value hits;